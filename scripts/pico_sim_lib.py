@@ -0,0 +1,144 @@
+# run pico_sim simulations from python, through the libpico_sim library
+#
+# libpico_sim is built with "cmake -DPICO_SIM_BUILD_SHARED=ON". The
+# simulations run in the python process, without writing a spec file or
+# starting pico_sim, and the results are read from memory: the metrics as
+# dictionaries, and the time series of the congestion control state as
+# numpy arrays that share the memory of the library, without copy.
+#
+#     import pico_sim_lib
+#     spec = pico_sim_lib.Spec("main_cc_algo: bbr\nlatency: 10000\n")
+#     spec.set("data_rate_in_gbps", 0.01)
+#     result = spec.run("bbr_10ms")
+#     print(result.total["goodput_mbps"])
+#     cwnd = result.series["cwnd"]
+#
+# The arrays stay valid as long as they or the result are referenced.
+# The library is found with the environment variable PICO_SIM_LIB, or
+# in the current directory.
+
+import os
+import ctypes
+import itertools
+import numpy as np
+
+series_columns = [
+    'time',
+    'connection',
+    'path',
+    'cwnd',
+    'bytes_in_flight',
+    'pacing_rate',
+    'smoothed_rtt',
+    'latest_rtt' ]
+
+_lib = None
+
+# Default names of the runs, which name their temporary files, so they
+# differ between the runs of all the threads and processes
+_run_counter = itertools.count()
+
+def load_library(lib_name=None, solution_dir=None):
+    global _lib
+    if _lib is not None:
+        return _lib
+    if lib_name is None:
+        lib_name = os.environ.get("PICO_SIM_LIB", os.path.join(os.getcwd(), "libpico_sim.so"))
+    lib = ctypes.CDLL(lib_name)
+    lib.pico_sim_api_init.argtypes = [ ctypes.c_char_p ]
+    lib.pico_sim_api_init.restype = ctypes.c_int
+    lib.pico_sim_api_spec_new.argtypes = []
+    lib.pico_sim_api_spec_new.restype = ctypes.c_void_p
+    lib.pico_sim_api_spec_parse.argtypes = [ ctypes.c_void_p, ctypes.c_char_p ]
+    lib.pico_sim_api_spec_parse.restype = ctypes.c_int
+    lib.pico_sim_api_spec_set.argtypes = [ ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p ]
+    lib.pico_sim_api_spec_set.restype = ctypes.c_int
+    lib.pico_sim_api_spec_free.argtypes = [ ctypes.c_void_p ]
+    lib.pico_sim_api_spec_free.restype = None
+    lib.pico_sim_api_run.argtypes = [ ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.POINTER(ctypes.c_void_p) ]
+    lib.pico_sim_api_run.restype = ctypes.c_int
+    lib.pico_sim_api_result_free.argtypes = [ ctypes.c_void_p ]
+    lib.pico_sim_api_result_free.restype = None
+    lib.pico_sim_api_nb_metrics.argtypes = []
+    lib.pico_sim_api_nb_metrics.restype = ctypes.c_size_t
+    lib.pico_sim_api_metric_name.argtypes = [ ctypes.c_size_t ]
+    lib.pico_sim_api_metric_name.restype = ctypes.c_char_p
+    lib.pico_sim_api_nb_connections.argtypes = [ ctypes.c_void_p ]
+    lib.pico_sim_api_nb_connections.restype = ctypes.c_size_t
+    lib.pico_sim_api_metrics_get.argtypes = [ ctypes.c_void_p, ctypes.c_size_t, ctypes.POINTER(ctypes.c_double), ctypes.c_size_t ]
+    lib.pico_sim_api_metrics_get.restype = ctypes.c_int
+    lib.pico_sim_api_nb_samples.argtypes = [ ctypes.c_void_p ]
+    lib.pico_sim_api_nb_samples.restype = ctypes.c_size_t
+    lib.pico_sim_api_series.argtypes = [ ctypes.c_void_p, ctypes.c_int ]
+    lib.pico_sim_api_series.restype = ctypes.POINTER(ctypes.c_uint64)
+    if lib.pico_sim_api_init(None if solution_dir is None else solution_dir.encode()) != 0:
+        raise ValueError("Cannot find the picoquic certificates in " + solution_dir)
+    _lib = lib
+    return lib
+
+# numpy array on the memory of a result, which keeps the result alive
+class _result_array(np.ndarray):
+    pass
+
+class Result:
+    def __init__(self, lib, handle):
+        self._lib = lib
+        self._handle = handle
+        names = [ lib.pico_sim_api_metric_name(i).decode() for i in range(lib.pico_sim_api_nb_metrics()) ]
+        values = (ctypes.c_double * len(names))()
+        self.nb_connections = lib.pico_sim_api_nb_connections(handle)
+        self.connections = []
+        for i in range(self.nb_connections + 1):
+            if lib.pico_sim_api_metrics_get(handle, i, values, len(names)) != 0:
+                raise RuntimeError("Cannot read the metrics of connection " + str(i))
+            metrics = dict(zip(names, list(values)))
+            if i < self.nb_connections:
+                self.connections.append(metrics)
+            else:
+                self.total = metrics
+        self.nb_samples = lib.pico_sim_api_nb_samples(handle)
+        self.series = {}
+        for column, name in enumerate(series_columns):
+            if self.nb_samples == 0:
+                self.series[name] = np.zeros(0, dtype=np.uint64)
+            else:
+                a = np.ctypeslib.as_array(lib.pico_sim_api_series(handle, column), shape=(self.nb_samples,))
+                a = a.view(_result_array)
+                a.result = self
+                self.series[name] = a
+
+    def __del__(self):
+        if self._handle is not None:
+            self._lib.pico_sim_api_result_free(self._handle)
+            self._handle = None
+
+class Spec:
+    def __init__(self, text=None, params=None, lib=None):
+        self._lib = load_library() if lib is None else lib
+        self._handle = self._lib.pico_sim_api_spec_new()
+        if not self._handle:
+            raise MemoryError("Cannot allocate the spec")
+        if text is not None and self._lib.pico_sim_api_spec_parse(self._handle, text.encode()) != 0:
+            raise ValueError("Incorrect spec")
+        if params is not None:
+            for name, value in params.items():
+                self.set(name, value)
+
+    def set(self, name, value):
+        if self._lib.pico_sim_api_spec_set(self._handle, name.encode(), str(value).encode()) != 0:
+            raise ValueError("Incorrect value for " + name + ": " + str(value))
+
+    def run(self, name=None, log_file=None):
+        if name is None:
+            name = "pico_sim_api_" + str(os.getpid()) + "_" + str(next(_run_counter))
+        handle = ctypes.c_void_p()
+        ret = self._lib.pico_sim_api_run(self._handle, name.encode(),
+            None if log_file is None else log_file.encode(), ctypes.byref(handle))
+        if ret != 0:
+            raise RuntimeError("Simulation " + name + " failed: " + str(ret))
+        return Result(self._lib, handle.value)
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            self._lib.pico_sim_api_spec_free(self._handle)
+            self._handle = None
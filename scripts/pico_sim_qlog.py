@@ -0,0 +1,202 @@
+# load the congestion control state of qlog files, in parallel and cached
+#
+# qlogparse.py and qlogparse_multipath.py only plot the "metrics_updated"
+# events of the qlogs. Instead of loading each qlog as a single json
+# document, the events are read one at a time, in worker processes when
+# there are several files, and only the cc updates are kept.
+#
+# the updates extracted from a qlog are cached in a numpy ".npz" file, one
+# array per column, in the directory ".qlog_cache" next to the qlog, or in
+# the directory set by the environment variable PICO_SIM_QLOG_CACHE. The
+# entry records the size and modification time of the qlog, and is parsed
+# again if the qlog changed. Loading a cached qlog only reads the columns.
+#
+#     import pico_sim_qlog
+#     for paths in pico_sim_qlog.load_cc_frames(qlog_names, per_path=True):
+#         for path_id, tdf in paths:
+#             ...
+
+import os
+import gzip
+import json
+import hashlib
+import concurrent.futures
+import numpy as np
+import pandas as pd
+
+# same columns as cc_state.cc_headers() in qlogparse.py
+cc_headers = [
+    'event_time',
+    'cwnd',
+    'bytes_in_flight',
+    'pacing_rate',
+    'smoothed_rtt',
+    'min_rtt',
+    'latest_rtt',
+    'app_limited' ]
+
+cache_version = 1
+read_size = 1 << 20
+
+def _open_qlog(file_name):
+    if file_name.endswith(".gz"):
+        return gzip.open(file_name, "rt")
+    return open(file_name, "r")
+
+def _header_value(header, key, decoder):
+    i = header.find('"' + key + '"')
+    if i < 0:
+        return None
+    i = header.find(':', i) + 1
+    while header[i].isspace():
+        i += 1
+    return decoder.raw_decode(header, i)[0]
+
+# yields the event fields, the reference time, then the events of the
+# first trace, decoded one at a time
+def _read_events(F):
+    decoder = json.JSONDecoder()
+    buf = ''
+    events_start = -1
+    while events_start < 0:
+        chunk = F.read(read_size)
+        if not chunk:
+            raise ValueError("no events in qlog")
+        buf += chunk
+        i = buf.find('"events"')
+        if i >= 0:
+            events_start = buf.find('[', i)
+    ef = _header_value(buf[0:events_start], "event_fields", decoder)
+    reference_time = _header_value(buf[0:events_start], "reference_time", decoder)
+    if ef is None:
+        raise ValueError("no event_fields in qlog")
+    yield ef, int(reference_time) if reference_time is not None else 0
+    pos = events_start + 1
+    is_done = False
+    while not is_done:
+        while pos < len(buf) and (buf[pos].isspace() or buf[pos] == ','):
+            pos += 1
+        if pos < len(buf) and buf[pos] == ']':
+            is_done = True
+            continue
+        try:
+            ev, pos = decoder.raw_decode(buf, pos)
+            yield ev
+        except ValueError:
+            # the event is not complete in the buffer
+            chunk = F.read(read_size)
+            if not chunk:
+                raise
+            buf = buf[pos:] + chunk
+            pos = 0
+
+# returns the cc updates of a qlog, one row per "metrics_updated" event,
+# with NaN for the values that the event does not update. The path ids of
+# all the events, in order of appearance, are kept in attrs['paths'].
+def parse_cc_updates(file_name):
+    columns = { x: [] for x in ['path_id'] + cc_headers }
+    paths = {}
+    with _open_qlog(file_name) as F:
+        events = _read_events(F)
+        ef, reference_time = next(events)
+        i_time = ef.index('relative_time')
+        i_path = ef.index('path_id') if 'path_id' in ef else -1
+        i_category = ef.index('category')
+        i_event = ef.index('event')
+        i_data = ef.index('data')
+        for ev in events:
+            if len(ev) != len(ef):
+                continue
+            path_id = ev[i_path] if i_path >= 0 else -1
+            paths[path_id] = True
+            if ev[i_category] != "recovery" or ev[i_event] != "metrics_updated":
+                continue
+            data = ev[i_data]
+            columns['event_time'].append(ev[i_time] + reference_time)
+            columns['path_id'].append(path_id)
+            for x in cc_headers[1:]:
+                columns[x].append(int(data[x]) if x in data else np.nan)
+    updates = pd.DataFrame({ 'event_time': np.array(columns['event_time'], dtype=np.int64),
+                             'path_id': np.array(columns['path_id'], dtype=np.int64) })
+    for x in cc_headers[1:]:
+        updates[x] = np.array(columns[x], dtype=np.float64)
+    updates.attrs['paths'] = list(paths)
+    return updates
+
+def _cache_name(file_name, cache_dir):
+    path = os.path.abspath(file_name)
+    if cache_dir is None:
+        cache_dir = os.environ.get("PICO_SIM_QLOG_CACHE", os.path.join(os.path.dirname(path), ".qlog_cache"))
+    key = hashlib.sha1(path.encode()).hexdigest()[0:16]
+    return os.path.join(cache_dir, os.path.basename(path) + "." + key + ".npz")
+
+def _cache_read(file_name, cache_name):
+    try:
+        st = os.stat(file_name)
+        with np.load(cache_name) as z:
+            if int(z['version']) != cache_version or int(z['mtime_ns']) != st.st_mtime_ns or \
+                int(z['size']) != st.st_size:
+                return None
+            updates = pd.DataFrame({ x: z[x] for x in ['event_time', 'path_id'] + cc_headers[1:] })
+            updates.attrs['paths'] = [ int(x) for x in z['paths'] ]
+            return updates
+    except (OSError, KeyError, ValueError):
+        return None
+
+def _cache_write(file_name, cache_name, updates):
+    # the cache is only an accelerator, failing to write it is not an error
+    try:
+        st = os.stat(file_name)
+        os.makedirs(os.path.dirname(cache_name), exist_ok=True)
+        tmp_name = cache_name + "." + str(os.getpid()) + ".tmp.npz"
+        np.savez(tmp_name, version=cache_version, mtime_ns=st.st_mtime_ns, size=st.st_size,
+                 paths=np.array(updates.attrs['paths'], dtype=np.int64),
+                 **{ x: updates[x].values for x in updates.columns })
+        os.replace(tmp_name, cache_name)
+    except OSError:
+        pass
+
+def load_cc_updates(file_name, cache_dir=None):
+    cache_name = _cache_name(file_name, cache_dir)
+    updates = _cache_read(file_name, cache_name)
+    if updates is None:
+        updates = parse_cc_updates(file_name)
+        _cache_write(file_name, cache_name, updates)
+    return updates
+
+# the cc state after each update, as computed by cc_state in qlogparse.py:
+# one frame for the whole connection, or one frame per path, in the order
+# in which the paths appear in the qlog
+def cc_frames(updates, per_path=False):
+    if per_path:
+        groups = [ (p, updates[updates['path_id'] == p]) for p in updates.attrs['paths'] ]
+    else:
+        groups = [ (0, updates) ]
+    frames = []
+    for path_id, u in groups:
+        tdf = u[cc_headers].ffill().fillna(0).astype(np.int64).reset_index(drop=True)
+        frames.append((path_id, tdf))
+    return frames
+
+# loads several qlogs, the files that are not in the cache being parsed
+# in nb_workers processes, by default one per core. Returns the frames of
+# each file, in the order of the file names.
+def load_cc_frames(file_names, per_path=False, nb_workers=None, cache_dir=None):
+    updates = [ _cache_read(x, _cache_name(x, cache_dir)) for x in file_names ]
+    missing = [ i for i in range(0, len(file_names)) if updates[i] is None ]
+    is_missing = set(missing)
+    if nb_workers is None:
+        nb_workers = os.cpu_count() or 1
+    nb_workers = min(nb_workers, len(missing))
+    if nb_workers > 1:
+        with concurrent.futures.ProcessPoolExecutor(max_workers=nb_workers) as pool:
+            loaded = pool.map(load_cc_updates, [ file_names[i] for i in missing ], [ cache_dir ] * len(missing))
+            for i, u in zip(missing, loaded):
+                updates[i] = u
+    else:
+        for i in missing:
+            updates[i] = load_cc_updates(file_names[i], cache_dir)
+    for i in range(0, len(file_names)):
+        print("Loaded " + str(len(updates[i])) + " cc updates from " + file_names[i] +
+              (" (cached)" if i not in is_missing else ""))
+    return [ cc_frames(u, per_path) for u in updates ]
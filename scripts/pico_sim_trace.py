@@ -0,0 +1,169 @@
+# read the binary traces produced by pico_sim
+#
+# with "trace_format: binary", pico_sim converts the qlog files of a
+# simulation into a single file of fixed size records, "trace.bin",
+# with the list of connections in "trace_connections.csv". The format
+# is described in src/pico_sim_trace.c.
+#
+# the records are mapped directly with numpy.memmap. This script can
+# also convert them back to qlog files, for use with qvis:
+#
+#     python pico_sim_trace.py <qlog_dir>/trace.bin [output_dir]
+#
+# with "metrics_bin_interval", pico_sim also writes the time binned
+# metrics of the run to "<name>_bins.bin", a columnar file described in
+# src/pico_sim_bins.c, loaded as a pandas DataFrame by load_bins().
+
+import sys
+import os
+import json
+import numpy as np
+import pandas as pd
+
+trace_header_size = 16
+trace_magic = b'PSIMTRC\0'
+trace_version = 1
+
+trace_dtype = np.dtype([
+    ('event_time', '<u8'),
+    ('connection', '<u4'),
+    ('event_type', '<u2'),
+    ('path_id', 'u1'),
+    ('app_limited', 'u1'),
+    ('cwnd', '<u8'),
+    ('bytes_in_flight', '<u8'),
+    ('pacing_rate', '<u8'),
+    ('smoothed_rtt', '<u8'),
+    ('min_rtt', '<u8'),
+    ('latest_rtt', '<u8')])
+
+event_metrics_updated = 1
+event_packet_lost = 2
+
+# same columns as cc_state.cc_headers() in qlogparse.py
+cc_headers = [
+    'event_time',
+    'cwnd',
+    'bytes_in_flight',
+    'pacing_rate',
+    'smoothed_rtt',
+    'min_rtt',
+    'latest_rtt',
+    'app_limited' ]
+
+def load_trace(file_name):
+    with open(file_name, "rb") as F:
+        header = F.read(trace_header_size)
+    if len(header) != trace_header_size or header[0:8] != trace_magic:
+        raise ValueError(file_name + " is not a pico_sim binary trace")
+    version = int.from_bytes(header[8:12], 'little')
+    record_size = int.from_bytes(header[12:16], 'little')
+    if version != trace_version or record_size != trace_dtype.itemsize:
+        raise ValueError("Unexpected version " + str(version) + " or record size " + str(record_size))
+    if os.path.getsize(file_name) <= trace_header_size:
+        return np.zeros(0, dtype=trace_dtype)
+    return np.memmap(file_name, dtype=trace_dtype, mode='r', offset=trace_header_size)
+
+bins_header_size = 40
+bins_magic = b'PSIMBIN\0'
+bins_version = 1
+
+bins_fields = [
+    'cwnd',
+    'bytes_in_flight',
+    'pacing_rate',
+    'smoothed_rtt',
+    'min_rtt',
+    'latest_rtt',
+    'queue_delay' ]
+
+bins_columns = [ 'bin_time', 'connection', 'path_id', 'nb_samples', 'app_limited', 'data_bytes' ] + \
+    [ x + '_' + s for x in bins_fields for s in [ 'min', 'max', 'last', 'mean' ] ]
+
+# returns the bins as a DataFrame, and the list of the qlog names of the connections
+def load_bins(file_name):
+    with open(file_name, "rb") as F:
+        header = F.read(bins_header_size)
+        if len(header) != bins_header_size or header[0:8] != bins_magic:
+            raise ValueError(file_name + " is not a pico_sim bins file")
+        version = int.from_bytes(header[8:12], 'little')
+        nb_columns = int.from_bytes(header[12:16], 'little')
+        nb_rows = int.from_bytes(header[16:24], 'little')
+        nb_connections = int.from_bytes(header[32:36], 'little')
+        names_size = int.from_bytes(header[36:40], 'little')
+        if version != bins_version or nb_columns != len(bins_columns):
+            raise ValueError("Unexpected version " + str(version) + " or number of columns " + str(nb_columns))
+        names = F.read(names_size).rstrip(b'\0').decode().split('\n')[0:nb_connections]
+        data = np.fromfile(F, dtype='<u8', count=nb_columns * nb_rows).reshape(nb_columns, nb_rows)
+    bins = pd.DataFrame({ x: data[i].astype(np.int64) for i, x in enumerate(bins_columns) })
+    return bins, names
+
+# bins of one connection, with the columns of cc_headers taken from the
+# last state of each bin, as expected by trace_graphs() in qlogparse.py
+def bins_cc_frame(bins, connection, path_id=0):
+    b = bins[(bins['connection'] == connection) & (bins['path_id'] == path_id)]
+    df = pd.DataFrame({ 'event_time': b['bin_time'].values })
+    for x in cc_headers[1:-1]:
+        df[x] = b[x + '_last'].values
+    df['app_limited'] = (b['app_limited'].values > 0).astype(np.int64)
+    return df
+
+def load_connections(file_name):
+    connections = []
+    with open(file_name, "r") as F:
+        for line in F.readlines()[1:]:
+            fields = [x.strip() for x in line.split(',')]
+            if len(fields) >= 2:
+                connections.append(fields[1])
+    return connections
+
+def cc_frame(trace, connection, path_id=0):
+    m = trace[(trace['connection'] == connection) &
+              (trace['path_id'] == path_id) &
+              (trace['event_type'] == event_metrics_updated)]
+    return pd.DataFrame({ x: np.asarray(m[x], dtype=np.int64) for x in cc_headers })
+
+def write_qlog(trace, connection, qlog_name):
+    evts = trace[trace['connection'] == connection]
+    with open(qlog_name, "w") as F:
+        F.write('{ "qlog_version": "draft-00", "title": "pico_sim", "traces": [\n')
+        F.write('{ "title": "' + os.path.basename(qlog_name) + '", ')
+        F.write('"event_fields": ["relative_time", "path_id", "category", "event", "data"],\n')
+        F.write('"configuration": { "time_units": "us" },\n')
+        F.write('"common_fields": { "protocol_type": "QUIC_HTTP3", "reference_time": "0" },\n')
+        F.write('"events": [')
+        is_first = True
+        for ev in evts:
+            if ev['event_type'] == event_metrics_updated:
+                event = "metrics_updated"
+                data = { x: int(ev[x]) for x in cc_headers[1:] }
+            elif ev['event_type'] == event_packet_lost:
+                event = "packet_lost"
+                data = {}
+            else:
+                continue
+            if not is_first:
+                F.write(',')
+            is_first = False
+            F.write('\n' + json.dumps([int(ev['event_time']), int(ev['path_id']), "recovery", event, data]))
+        F.write(']}]}\n')
+
+def trace_to_qlog(trace_file, output_dir):
+    trace = load_trace(trace_file)
+    connections_file = os.path.join(os.path.dirname(trace_file), "trace_connections.csv")
+    connections = load_connections(connections_file) if os.path.exists(connections_file) else []
+    for c in np.unique(trace['connection']):
+        if c < len(connections):
+            name = os.path.basename(connections[c])
+        else:
+            name = "connection_" + str(c) + ".qlog"
+        qlog_name = os.path.join(output_dir, name)
+        write_qlog(trace, c, qlog_name)
+        print("Wrote " + qlog_name)
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print("Usage: python pico_sim_trace.py trace.bin [output_dir]")
+    else:
+        output_dir = sys.argv[2] if len(sys.argv) > 2 else "."
+        trace_to_qlog(sys.argv[1], output_dir)
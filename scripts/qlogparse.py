@@ -206,21 +206,48 @@ def trace_graphs(tdfs, df_names, f_name=""):
         plt.savefig(f_name)
 
 
+def qlog_bins_frames(file_name):
+    # time binned metrics written by pico_sim with "metrics_bin_interval",
+    # one frame per connection
+    import pico_sim_trace
+    bins, connections = pico_sim_trace.load_bins(file_name)
+    return [ pico_sim_trace.bins_cc_frame(bins, c) for c in range(0, len(connections)) ]
+
+def qlog_csv_frame(file_name):
+    # CSV file produced by qlog_summarize, with the cc vectors of all paths
+    tdf = pd.read_csv(file_name, skipinitialspace=True)
+    return tdf[cc_state.cc_headers()]
+
 # test part of the program
-# assume each argument is a qlog file
-
-tdfs = []
-tdf_names = []
-
-for i in range(1, len(sys.argv)):
-    trc = qlog_parse(sys.argv[i])
-    tdf = pd.DataFrame(trc[0].cc_log, columns=cc_state.cc_headers())
-    tdfs.append(tdf)
-    if i == 1:
-        tdf_names.append("main")
-    elif i == 2 and len(sys.argv) == 3:
-        tdf_names.append("background")
-    else:
-        tdf_names.append("background_" + str(i-1))
-trace_graphs(tdfs, tdf_names, f_name="..\\tmp\\image")
+# assume each argument is a qlog file, or the CSV summary of a qlog
+# produced by qlog_summarize, which is much faster for large traces, or
+# the "<name>_bins.bin" file of a run, with all its connections.
+# the qlogs are parsed in parallel, and their cc states are cached by
+# pico_sim_qlog.py, so plotting them again does not parse them again.
+
+if __name__ == "__main__":
+    import pico_sim_qlog
+
+    tdfs = []
+    tdf_names = []
+    qlog_names = [ x for x in sys.argv[1:] if not x.endswith(".bin") and not x.endswith(".csv") ]
+    qlog_frames = pico_sim_qlog.load_cc_frames(qlog_names)
+    i_qlog = 0
+
+    for i in range(1, len(sys.argv)):
+        if sys.argv[i].endswith(".bin"):
+            tdfs += qlog_bins_frames(sys.argv[i])
+        elif sys.argv[i].endswith(".csv"):
+            tdfs.append(qlog_csv_frame(sys.argv[i]))
+        else:
+            tdfs.append(qlog_frames[i_qlog][0][1])
+            i_qlog += 1
+    for i in range(0, len(tdfs)):
+        if i == 0:
+            tdf_names.append("main")
+        elif i == 1 and len(tdfs) == 2:
+            tdf_names.append("background")
+        else:
+            tdf_names.append("background_" + str(i))
+    trace_graphs(tdfs, tdf_names, f_name="..\\tmp\\image")
 
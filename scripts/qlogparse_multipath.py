@@ -215,18 +215,26 @@ def trace_graphs(tdfs, df_names, f_name=""):
     else:
         plt.savefig(f_name)
 
-tdfs = []
-tdf_names = []
-
 # assume that the first argument is the input qlog, and the second argument the name of the output file
+# the input can also be the CSV summary of the qlog produced by qlog_summarize.
+# the cc states of the qlog are cached by pico_sim_qlog.py, so plotting it
+# again does not parse it again.
+
+if __name__ == "__main__" and len(sys.argv) > 1:
+    import pico_sim_qlog
 
-if len(sys.argv) > 1:
-    trc = qlog_parse(sys.argv[1])
+    tdfs = []
+    tdf_names = []
     f_name = sys.argv[2] if len(sys.argv) > 2 else ""
 
-    for path_id in trc.paths:
-        tdf = pd.DataFrame(trc.paths[path_id].cc_log, columns=cc_state.cc_headers())
-        tdfs.append(tdf)
-        tdf_names.append('path_' + str(path_id))
+    if sys.argv[1].endswith(".csv"):
+        sdf = pd.read_csv(sys.argv[1], skipinitialspace=True)
+        for path_id, tdf in sdf.groupby('path_id'):
+            tdfs.append(tdf[cc_state.cc_headers()])
+            tdf_names.append('path_' + str(path_id))
+    else:
+        for path_id, tdf in pico_sim_qlog.load_cc_frames([ sys.argv[1] ], per_path=True)[0]:
+            tdfs.append(tdf)
+            tdf_names.append('path_' + str(path_id))
 
     trace_graphs(tdfs, tdf_names, f_name=f_name)
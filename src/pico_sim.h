@@ -0,0 +1,480 @@
+/* Declarations shared between the modules of pico_sim.
+ */
+
+#ifndef PICO_SIM_H
+#define PICO_SIM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "picoquic_ns.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Separator of the file paths built by pico_sim */
+#ifdef _WINDOWS
+#define PICO_SIM_PATH_SEP '\\'
+#define PICO_SIM_PATH_SEP_STR "\\"
+#else
+#define PICO_SIM_PATH_SEP '/'
+#define PICO_SIM_PATH_SEP_STR "/"
+#endif
+
+/* Format of the traces produced by the simulation. The qlog traces
+ * can be converted to the compact binary format of pico_sim_trace.c,
+ * either replacing them or in addition to them.
+ */
+typedef enum {
+    pico_sim_trace_qlog = 0,
+    pico_sim_trace_binary,
+    pico_sim_trace_both
+} pico_sim_trace_format_enum;
+
+/* Summary of the simulation results, computed from the qlog traces
+ * by pico_sim_summary.c. If the spec has no qlog_dir, the traces are
+ * written to a temporary directory and removed after the summary.
+ */
+typedef enum {
+    pico_sim_summary_none = 0,
+    pico_sim_summary_csv,
+    pico_sim_summary_json
+} pico_sim_summary_format_enum;
+
+/* Metrics of a connection, or of the whole run */
+typedef struct st_pico_sim_summary_metrics_t {
+    uint64_t bytes_sent;
+    uint64_t bytes_received;
+    uint64_t completion_time;
+    double goodput_mbps;
+    double rtt_mean;
+    uint64_t rtt_p50;
+    uint64_t rtt_p95;
+    uint64_t rtt_p99;
+    double queue_delay_mean;
+    uint64_t queue_delay_p99;
+    uint64_t queue_delay_max;
+    uint64_t nb_losses;
+    uint64_t nb_ce_marks;
+} pico_sim_summary_metrics_t;
+
+/* Columns of the time series of the congestion control state, one
+ * sample per "metrics_updated" event of the qlogs. Each column is a
+ * separate array, so that it can be used without copy by the callers
+ * of the embedding API.
+ */
+typedef enum {
+    pico_sim_series_time = 0,
+    pico_sim_series_connection,
+    pico_sim_series_path,
+    pico_sim_series_cwnd,
+    pico_sim_series_bytes_in_flight,
+    pico_sim_series_pacing_rate,
+    pico_sim_series_smoothed_rtt,
+    pico_sim_series_latest_rtt,
+    pico_sim_series_nb
+} pico_sim_series_enum;
+
+/* Results of a simulation, kept in memory instead of written to a summary */
+typedef struct st_pico_sim_result_t {
+    size_t nb_cnx;
+    char** qlog_names;
+    pico_sim_summary_metrics_t* cnx;
+    pico_sim_summary_metrics_t total;
+    double jain_index;
+    size_t nb_samples;
+    size_t nb_samples_max;
+    uint64_t* series[pico_sim_series_nb];
+} pico_sim_result_t;
+
+/* Expectations on the metrics of the whole run, set by the "expect_*"
+ * keys of the spec, zero if not set. Checked in pico_sim_expect.c.
+ */
+typedef struct st_pico_sim_expect_t {
+    double goodput_min;
+    uint64_t completion_time_max;
+    double fairness_min;
+    uint64_t rtt_p95_max;
+    uint64_t queue_delay_p99_max;
+} pico_sim_expect_t;
+
+/* Qlog filtering, in pico_sim_filter.c. The qlog level is a list of
+ * categories, e.g., "recovery", or of events, e.g., "recovery:packet_lost",
+ * separated by commas; "all" keeps all events. With a sample interval,
+ * at most one "metrics_updated" event is kept per path and per interval
+ * of virtual time, carrying the complete congestion control state.
+ */
+#define PICO_SIM_QLOG_LEVEL_ALL "all"
+
+/* Queue presets of the bottleneck, named values of the drop tail limit
+ * and of the L4S marking threshold of the link, in pico_sim_queue.c.
+ */
+typedef enum {
+    pico_sim_queue_preset_none = 0,
+    pico_sim_queue_preset_short,
+    pico_sim_queue_preset_medium,
+    pico_sim_queue_preset_l4s
+} pico_sim_queue_preset_enum;
+
+/* Simulation spec: the spec of the picoquic network simulation,
+ * plus the options handled by pico_sim itself.
+ */
+typedef struct st_pico_sim_spec_t {
+    picoquic_ns_spec_t ns;
+    pico_sim_trace_format_enum trace_format;
+    pico_sim_summary_format_enum summary_format;
+    char const* qlog_level;
+    uint64_t qlog_sample_interval;
+    uint64_t qlog_segment_time;
+    uint64_t qlog_segment_size;
+    int qlog_compress;
+    uint64_t nb_replicas;
+    char const* link_trace_file;
+    uint64_t link_trace_interval;
+    uint64_t media_latency_p99;
+    uint64_t media_latency_p999;
+    uint64_t metrics_bin_interval;
+    pico_sim_queue_preset_enum queue_preset;
+    char const* cross_traffic;
+    char const* cross_traffic_trace;
+    pico_sim_expect_t expect;
+    int do_profile; /* set by the "-P" option, not by the spec file */
+    int nb_threads; /* set by the "-T" option */
+    char const* cache_dir; /* set by the "-C" option */
+    int cache_refresh; /* set by the "-F" option */
+    pico_sim_result_t* result; /* set by the embedding API, in pico_sim_api.c */
+} pico_sim_spec_t;
+
+/* Parameter sweep. A parameter in a spec file can be given as a list of
+ * values, e.g., "main_cc_algo: {cubic,bbr,c4}", or as a range,
+ * e.g., "latency: 10000..80000 step 10000". The spec then describes
+ * the cartesian product of all the listed values, each "point" of the
+ * product being a separate simulation.
+ */
+#define PICO_SIM_SWEEP_DIM_MAX 16
+#define PICO_SIM_SWEEP_VALUES_MAX 10000
+#define PICO_SIM_SWEEP_POINTS_MAX 100000
+
+typedef struct st_pico_sim_sweep_dim_t {
+    int param_id;
+    char const* param_name;
+    size_t nb_values;
+    size_t nb_values_max;
+    char** values;
+} pico_sim_sweep_dim_t;
+
+/* Spec variants. A line "variant: <name>" in a spec file starts a variant,
+ * and the parameters that follow it override those of the base spec
+ * for that variant only. Each variant runs as a separate and complete
+ * simulation, for each point of the sweep if any: nothing of the
+ * simulation is shared between variants.
+ */
+#define PICO_SIM_VARIANT_PARAMS_MAX 16
+#define PICO_SIM_VARIANTS_MAX 1000
+
+typedef struct st_pico_sim_variant_t {
+    char* name;
+    size_t nb_params;
+    int param_id[PICO_SIM_VARIANT_PARAMS_MAX];
+    char const* param_name[PICO_SIM_VARIANT_PARAMS_MAX];
+    char* values[PICO_SIM_VARIANT_PARAMS_MAX];
+} pico_sim_variant_t;
+
+typedef struct st_pico_sim_sweep_t {
+    size_t nb_dims;
+    pico_sim_sweep_dim_t dims[PICO_SIM_SWEEP_DIM_MAX];
+    size_t nb_variants;
+    size_t nb_variants_max;
+    pico_sim_variant_t* variants;
+} pico_sim_sweep_t;
+
+/* Spec parsing, in pico_sim_spec.c */
+int parse_spec_file(pico_sim_spec_t* spec, FILE* F);
+int parse_spec_file_sweep(pico_sim_spec_t* spec, pico_sim_sweep_t* sweep, FILE* F);
+int parse_spec_text(pico_sim_spec_t* spec, char const* text);
+int parse_param_by_id(pico_sim_spec_t* spec, int param_id, char const* value);
+int parse_param_by_name(pico_sim_spec_t* spec, char const* name, char const* value);
+int copy_spec_data(pico_sim_spec_t* spec, pico_sim_spec_t const* model);
+void release_spec_data(pico_sim_spec_t* spec);
+int parse_u64(uint64_t* x, char const* val);
+int parse_double(double* x, char const* val);
+
+/* Sweep expansion, in pico_sim_sweep.c */
+int pico_sim_is_sweep_value(char const* value);
+int pico_sim_sweep_add(pico_sim_sweep_t* sweep, int param_id, char const* param_name, char const* value);
+size_t pico_sim_sweep_nb_points(pico_sim_sweep_t const* sweep);
+char const* pico_sim_sweep_value(pico_sim_sweep_t const* sweep, size_t dim, size_t point);
+int pico_sim_sweep_apply(pico_sim_spec_t* spec, pico_sim_sweep_t const* sweep, size_t point);
+int pico_sim_sweep_is_set(pico_sim_sweep_t const* sweep);
+void pico_sim_sweep_point_name(char* name, size_t name_size, char const* base_name,
+    pico_sim_sweep_t const* sweep, size_t point);
+int pico_sim_variant_add(pico_sim_sweep_t* sweep, char const* name);
+int pico_sim_variant_add_param(pico_sim_sweep_t* sweep, int param_id, char const* param_name, char const* value);
+pico_sim_variant_t const* pico_sim_sweep_variant(pico_sim_sweep_t const* sweep, size_t point);
+void pico_sim_sweep_release(pico_sim_sweep_t* sweep);
+
+/* Batch execution of several specifications, in pico_sim_batch.c.
+ * Each spec name can be a file or a directory. Directories are
+ * expanded to the list of ".txt" files that they contain.
+ * If nb_workers is zero, the pool is sized to the number of cores.
+ * pico_sim_batch_parsed runs the batch of a spec file that is already
+ * parsed, and takes its spec and sweep.
+ */
+int pico_sim_is_directory(char const* path);
+int pico_sim_mkdir(char const* path);
+void pico_sim_base_name(char* name, size_t name_size, char const* spec_file_name);
+int pico_sim_nb_cores(void);
+int pico_sim_list_files(char const* dir, char const* suffix, char*** names, size_t* nb_names);
+void pico_sim_free_file_list(char** names, size_t nb_names);
+
+/* Files produced by one run, in pico_sim_batch.c. The simulation writes
+ * in the run_dir created by pico_sim_run_files_open, then
+ * pico_sim_run_files_close moves the files to the qlog_dir and lists
+ * them. The later steps of the run add or remove the files that they
+ * create or delete, and process the qlogs listed by
+ * pico_sim_list_run_qlogs rather than all those of the qlog_dir.
+ */
+typedef struct st_pico_sim_run_files_t {
+    char run_dir[512];
+    char** names;
+    size_t nb_names;
+    size_t nb_names_max;
+} pico_sim_run_files_t;
+
+int pico_sim_run_files_open(pico_sim_run_files_t* run_files, char const* qlog_dir, char const* name);
+int pico_sim_run_files_close(pico_sim_run_files_t* run_files, char const* qlog_dir);
+int pico_sim_run_files_add(pico_sim_run_files_t* run_files, char const* file_name);
+void pico_sim_run_files_remove(pico_sim_run_files_t* run_files, char const* file_name);
+void pico_sim_run_files_release(pico_sim_run_files_t* run_files);
+int pico_sim_list_run_qlogs(pico_sim_run_files_t const* run_files, char const* suffix, char*** names, size_t* nb_names);
+int pico_sim_batch(char const** spec_names, int nb_spec_names, int nb_workers, char const* report_file_name, int do_profile,
+    int nb_threads, char const* cache_dir, int cache_refresh);
+int pico_sim_batch_parsed(char const* spec_file_name, pico_sim_spec_t* spec, pico_sim_sweep_t* sweep,
+    int nb_workers, char const* report_file_name, int do_profile, int nb_threads, char const* cache_dir, int cache_refresh);
+
+/* Run one simulation, then process its outputs as required by
+ * the spec, in pico_sim_run.c. Used both for single runs and
+ * for the jobs of a batch.
+ */
+int pico_sim_run(pico_sim_spec_t* spec, char const* name, FILE* err_fd);
+/* Prepare the link of the spec before the simulation: the queue preset,
+ * then the link trace, then the cross traffic. Called by pico_sim_run,
+ * and by the benchmark so that it times the same simulation. */
+int pico_sim_run_prepare(pico_sim_spec_t* spec, FILE* err_fd);
+
+/* Certificate and key loaded by the simulations, relative to the
+ * picoquic source directory. */
+#ifdef _WINDOWS
+#define PICO_SIM_CERT_FILE "certs\\cert.pem"
+#define PICO_SIM_KEY_FILE "certs\\key.pem"
+#else
+#define PICO_SIM_CERT_FILE "certs/cert.pem"
+#define PICO_SIM_KEY_FILE "certs/key.pem"
+#endif
+int pico_sim_check_solution_dir(char const* solution_dir, FILE* err_fd);
+
+/* Embedding API, in pico_sim_api.c, exported by the libpico_sim shared
+ * library. The spec is parsed from a string or set parameter by parameter,
+ * and the results of the run are returned in memory.
+ */
+int pico_sim_api_init(char const* solution_dir);
+pico_sim_spec_t* pico_sim_api_spec_new(void);
+int pico_sim_api_spec_parse(pico_sim_spec_t* spec, char const* text);
+int pico_sim_api_spec_set(pico_sim_spec_t* spec, char const* name, char const* value);
+void pico_sim_api_spec_free(pico_sim_spec_t* spec);
+int pico_sim_api_run(pico_sim_spec_t const* spec, char const* name, char const* log_file_name,
+    pico_sim_result_t** result);
+void pico_sim_api_result_free(pico_sim_result_t* result);
+size_t pico_sim_api_nb_metrics(void);
+char const* pico_sim_api_metric_name(size_t metric);
+size_t pico_sim_api_nb_connections(pico_sim_result_t const* result);
+int pico_sim_api_metrics_get(pico_sim_result_t const* result, size_t cnx_index, double* values, size_t nb_values);
+size_t pico_sim_api_nb_samples(pico_sim_result_t const* result);
+uint64_t const* pico_sim_api_series(pico_sim_result_t const* result, int column);
+
+/* Queue presets, in pico_sim_queue.c. The preset sets the drop tail
+ * limit and the L4S threshold that are not set explicitly.
+ */
+int pico_sim_queue_preset_parse(pico_sim_queue_preset_enum* preset, char const* val);
+void pico_sim_queue_preset_apply(pico_sim_queue_preset_enum preset, uint64_t* queue_delay_max, uint64_t* l4s_max);
+void pico_sim_queue_preset_apply_spec(pico_sim_spec_t* spec);
+
+/* Parallel processing of the qlogs, in pico_sim_parallel.c. The function
+ * is called once for each item, from nb_threads threads. The message that
+ * it writes for the item, without end of line, is printed on err_fd after
+ * all the items are processed, in the order of the items. The utilization
+ * of the threads is reported on err_fd, under the label.
+ */
+#define PICO_SIM_PARALLEL_MESSAGE_SIZE 1536
+typedef int (*pico_sim_parallel_fn)(void* ctx, size_t item, char* message, size_t message_size);
+int pico_sim_parallel_for(char const* label, size_t nb_items, int nb_threads, pico_sim_parallel_fn fn, void* ctx,
+    FILE* err_fd);
+
+/* Binary traces, in pico_sim_trace.c. The qlog files of the run are
+ * converted into a single file of fixed size records in qlog_dir,
+ * "trace.bin", with a list of the converted connections in
+ * "trace_connections.csv". The files of the run are updated with the
+ * trace files and the removed qlogs.
+ */
+#define PICO_SIM_TRACE_FILE "trace.bin"
+#define PICO_SIM_TRACE_CONNECTIONS "trace_connections.csv"
+int pico_sim_trace_convert(char const* qlog_dir, pico_sim_run_files_t* run_files, int remove_qlog, FILE* err_fd);
+
+/* Split the qlog files of the run in segments of segment_time
+ * microseconds of virtual time or segment_size bytes, and compress them
+ * with gzip if do_compress is set, in pico_sim_segment.c. The segments
+ * replace the qlogs in the files of the run.
+ * Compression requires a build with zlib, which defines PICO_SIM_ZLIB. */
+int pico_sim_segment(pico_sim_run_files_t* run_files, uint64_t segment_time,
+    uint64_t segment_size, int do_compress, int nb_threads, FILE* err_fd);
+
+/* Filter the qlog files of the run, as specified by qlog_level and
+ * qlog_sample_interval. */
+int pico_sim_filter(pico_sim_run_files_t const* run_files, char const* qlog_level,
+    uint64_t sample_interval, int nb_threads, FILE* err_fd);
+
+/* Link capacity traces, in pico_sim_link_trace.c. The trace file named
+ * in the spec is converted to the list of link segments of the spec.
+ */
+#define PICO_SIM_LINK_TRACE_INTERVAL 10000
+#define PICO_SIM_LINK_TRACE_SEGMENTS_MAX 10000000
+
+int pico_sim_link_trace_load(pico_sim_spec_t* spec, FILE* err_fd);
+
+/* Synthetic cross traffic, in pico_sim_cross.c. The packets of the
+ * sources are generated when the simulation starts, and the link
+ * segments of the spec are replaced by the capacity that they leave,
+ * with a floor. Only the capacity is modelled, not the queue delay.
+ */
+int pico_sim_cross_check(char const* val);
+int pico_sim_cross_apply(pico_sim_spec_t* spec, FILE* err_fd);
+
+/* Result cache, in pico_sim_cache.c. The key of a run is computed from
+ * the normalized parsed spec and the build of the executable. If the cache
+ * has an entry for the key, the outputs of the run are restored from the
+ * cache, unless the spec asks for a refresh.
+ */
+typedef struct st_pico_sim_cache_entry_t {
+    char const* cache_dir;
+    char key[17];
+    char* spec_text;
+    size_t spec_text_len;
+    size_t spec_text_max;
+} pico_sim_cache_entry_t;
+
+int pico_sim_cache_lookup(pico_sim_spec_t const* spec, char const* name, pico_sim_cache_entry_t* entry,
+    int* is_hit, FILE* err_fd);
+int pico_sim_cache_store(pico_sim_cache_entry_t const* entry, pico_sim_spec_t const* spec,
+    pico_sim_run_files_t const* run_files, char const* name, FILE* err_fd);
+void pico_sim_cache_release(pico_sim_cache_entry_t* entry);
+int pico_sim_cache_prune(char const* cache_dir, uint64_t max_age_days, FILE* err_fd);
+
+/* Replicas, in pico_sim_replicas.c. Each replica of a simulation runs
+ * with its own icid, and writes its own summary. The summaries of the
+ * replicas are aggregated in "<name>_replicas.csv".
+ */
+#define PICO_SIM_REPLICAS_MAX 1000
+
+void pico_sim_replica_apply(pico_sim_spec_t* spec, size_t replica);
+int pico_sim_replicas_report(char const* name, char const** replica_names, size_t nb_replicas,
+    pico_sim_summary_format_enum summary_format, FILE* err_fd);
+
+/* Summary metrics, in pico_sim_summary.c. The qlog files of the run are
+ * scanned, and the metrics of each connection and of the whole run are
+ * written to "<name>_summary.csv" or "<name>_summary.json".
+ */
+int pico_sim_summary(pico_sim_run_files_t const* run_files, char const* name,
+    pico_sim_summary_format_enum summary_format, int nb_threads, FILE* err_fd);
+
+/* The same metrics, computed in memory, plus the time series of the
+ * congestion control state if with_series is set. The result is released
+ * with pico_sim_result_release. The series of each qlog are built on its
+ * own, possibly in parallel, and concatenated in the order of the qlogs. */
+int pico_sim_summary_compute(pico_sim_run_files_t const* run_files, pico_sim_result_t* result,
+    int with_series, int nb_threads, FILE* err_fd);
+int pico_sim_summary_write(char const* name, pico_sim_summary_format_enum summary_format,
+    pico_sim_result_t const* result, FILE* err_fd);
+void pico_sim_result_release(pico_sim_result_t* result);
+
+/* The metrics as an array of values, in the order of the CSV columns,
+ * either from a result or read from the "all" row of a summary file. */
+#define PICO_SIM_SUMMARY_METRICS_NB 14
+extern char const* const pico_sim_summary_metric_names[PICO_SIM_SUMMARY_METRICS_NB];
+int pico_sim_summary_metric_id(char const* name, size_t name_len);
+void pico_sim_summary_values(pico_sim_result_t const* result, size_t cnx_index, double* values);
+int pico_sim_summary_read(char const* name, pico_sim_summary_format_enum summary_format, double* values);
+
+/* Expectations, in pico_sim_expect.c, checked against the metrics of
+ * the whole run after the summary. The run fails if any of them is not
+ * met, and the verdict of each is written to "<name>_expect.csv".
+ */
+int pico_sim_expect_is_set(pico_sim_expect_t const* expect);
+int pico_sim_expect_check(pico_sim_expect_t const* expect, double const* values, char const* name, FILE* err_fd);
+
+/* Time binned metrics, in pico_sim_bins.c. The congestion control state
+ * in the qlog files of the run is reduced to its min, max, last and mean
+ * per connection, path and bin_interval of virtual time, written as a
+ * columnar file, "<name>_bins.bin".
+ */
+int pico_sim_bins(pico_sim_run_files_t const* run_files, uint64_t bin_interval, char const* name, FILE* err_fd);
+
+/* Media latency histograms, in pico_sim_media.c. The frame latencies of
+ * the qperf log are counted per media stream in log-linear histograms of
+ * fixed size, written to "<name>_media_latency.csv" (percentiles) and
+ * "<name>_media_histogram.csv" (buckets). The run fails if the p99 or
+ * p99.9 latency of a stream that is not excluded is above the spec limit.
+ */
+#define PICO_SIM_MEDIA_STREAMS_MAX 64
+int pico_sim_media_report(pico_sim_spec_t const* spec, char const* name, FILE* err_fd);
+
+/* Memory accounting, in pico_sim_memory.c. The memory of the simulation
+ * is measured from the resident memory of the process, in bytes.
+ */
+uint64_t pico_sim_memory_current(void);
+uint64_t pico_sim_memory_peak(void);
+void pico_sim_memory_reset_peak(void);
+void pico_sim_memory_release(void);
+size_t pico_sim_memory_spec(pico_sim_spec_t const* spec);
+
+/* Self profiling, in pico_sim_profile.c. The picoquic simulation runs
+ * as a single call, so its setup, event loop, qlog writing and teardown
+ * are timed together as the "simulation" phase. The virtual time and the
+ * number of events and packets are obtained from the qlogs, if any, as
+ * well as the max number of bytes in flight of all the connections, i.e.,
+ * held in the link by the simulation. The memory of the simulation is the
+ * peak resident memory during the call, above the resident memory before.
+ * The report is written to "<name>_profile.csv".
+ */
+typedef enum {
+    pico_sim_phase_simulation = 0,
+    pico_sim_phase_summary,
+    pico_sim_phase_filter,
+    pico_sim_phase_trace,
+    pico_sim_phase_max
+} pico_sim_phase_enum;
+
+typedef struct st_pico_sim_profile_t {
+    uint64_t wall_time;
+    uint64_t cpu_time;
+    uint64_t virtual_time;
+    uint64_t nb_qlogs;
+    uint64_t nb_events;
+    uint64_t nb_packets;
+    uint64_t packet_bytes;
+    uint64_t max_bytes_in_flight;
+    uint64_t phase_time[pico_sim_phase_max];
+    uint64_t spec_bytes;
+    uint64_t memory_start;
+    uint64_t memory_peak;
+    int nb_connections;
+} pico_sim_profile_t;
+
+#define PICO_SIM_PROFILE_HEADER "wall_time_us, cpu_time_us, virtual_time_us, speed_ratio, nb_qlogs, nb_events, nb_packets, events_per_second, packets_per_second, simulation_us, summary_us, filter_us, trace_us, spec_bytes, peak_memory_bytes, simulation_bytes, bytes_per_connection, max_bytes_in_flight, max_packets_in_flight"
+int pico_sim_profile_scan(pico_sim_run_files_t const* run_files, pico_sim_profile_t* profile);
+int pico_sim_profile_report(pico_sim_profile_t const* profile, char const* name, FILE* err_fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PICO_SIM_H */
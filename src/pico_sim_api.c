@@ -0,0 +1,146 @@
+/* Embedding API of pico_sim.
+* These functions are exported by the shared library libpico_sim, so
+* that other programs, e.g., the Python module scripts/pico_sim_lib.py,
+* can parse a spec from a string or from parameter values, run the
+* simulation in their own process, and read the results from memory:
+* the metrics of each connection and of the whole run, and the time
+* series of the congestion control state, as arrays of integers.
+*
+* The picoquic simulation only produces its outputs as qlog files, so
+* the qlogs are still written to a temporary directory, named after
+* the run, and removed once they are parsed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "picoquic.h"
+#include "picoquic_ns.h"
+#include "picoquic_utils.h"
+#include "pico_sim.h"
+
+int pico_sim_api_init(char const* solution_dir)
+{
+    int ret = 0;
+
+    picoquic_register_all_congestion_control_algorithms();
+    if (solution_dir != NULL) {
+        picoquic_set_solution_dir(solution_dir);
+        ret = pico_sim_check_solution_dir(solution_dir, stderr);
+    }
+    return ret;
+}
+
+pico_sim_spec_t* pico_sim_api_spec_new(void)
+{
+    return (pico_sim_spec_t*)calloc(1, sizeof(pico_sim_spec_t));
+}
+
+int pico_sim_api_spec_parse(pico_sim_spec_t* spec, char const* text)
+{
+    return parse_spec_text(spec, text);
+}
+
+int pico_sim_api_spec_set(pico_sim_spec_t* spec, char const* name, char const* value)
+{
+    return parse_param_by_name(spec, name, value);
+}
+
+void pico_sim_api_spec_free(pico_sim_spec_t* spec)
+{
+    if (spec != NULL) {
+        release_spec_data(spec);
+        free(spec);
+    }
+}
+
+/* Run a copy of the spec, so that the same spec can be run several times.
+ * The log of the simulation goes to log_file_name, or to stderr if NULL.
+ * The name is required: the temporary qlog directory and the output files
+ * are named after it, so runs made at the same time need different names. */
+int pico_sim_api_run(pico_sim_spec_t const* spec, char const* name, char const* log_file_name,
+    pico_sim_result_t** result)
+{
+    int ret = 0;
+    pico_sim_spec_t run_spec;
+    FILE* err_fd = stderr;
+
+    *result = NULL;
+    if (name == NULL || name[0] == 0) {
+        fprintf(stderr, "The simulation needs a name\n");
+        ret = -1;
+    }
+    else if (log_file_name != NULL && (err_fd = picoquic_file_open(log_file_name, "w")) == NULL) {
+        fprintf(stderr, "Cannot open log file <%s>\n", log_file_name);
+        ret = -1;
+    }
+    else if ((*result = (pico_sim_result_t*)calloc(1, sizeof(pico_sim_result_t))) == NULL ||
+        copy_spec_data(&run_spec, spec) != 0) {
+        ret = -1;
+    }
+    else {
+        run_spec.result = *result;
+        run_spec.cache_dir = NULL;
+        ret = pico_sim_run(&run_spec, name, err_fd);
+        release_spec_data(&run_spec);
+    }
+
+    if (ret != 0 && *result != NULL) {
+        pico_sim_api_result_free(*result);
+        *result = NULL;
+    }
+    if (err_fd != stderr && err_fd != NULL) {
+        (void)picoquic_file_close(err_fd);
+    }
+    return ret;
+}
+
+void pico_sim_api_result_free(pico_sim_result_t* result)
+{
+    if (result != NULL) {
+        pico_sim_result_release(result);
+        free(result);
+    }
+}
+
+size_t pico_sim_api_nb_metrics(void)
+{
+    return PICO_SIM_SUMMARY_METRICS_NB;
+}
+
+char const* pico_sim_api_metric_name(size_t metric)
+{
+    return (metric < PICO_SIM_SUMMARY_METRICS_NB) ? pico_sim_summary_metric_names[metric] : NULL;
+}
+
+size_t pico_sim_api_nb_connections(pico_sim_result_t const* result)
+{
+    return result->nb_cnx;
+}
+
+/* Metrics of connection cnx_index, or of the whole run if cnx_index is
+ * the number of connections, in the order of pico_sim_api_metric_name */
+int pico_sim_api_metrics_get(pico_sim_result_t const* result, size_t cnx_index, double* values, size_t nb_values)
+{
+    int ret = 0;
+
+    if (cnx_index > result->nb_cnx || nb_values < PICO_SIM_SUMMARY_METRICS_NB) {
+        ret = -1;
+    }
+    else {
+        pico_sim_summary_values(result, cnx_index, values);
+    }
+    return ret;
+}
+
+size_t pico_sim_api_nb_samples(pico_sim_result_t const* result)
+{
+    return result->nb_samples;
+}
+
+/* The column is owned by the result, and valid until the result is freed */
+uint64_t const* pico_sim_api_series(pico_sim_result_t const* result, int column)
+{
+    return (column >= 0 && column < pico_sim_series_nb) ? result->series[column] : NULL;
+}
@@ -0,0 +1,1035 @@
+/* Batch mode for pico_sim.
+* Runs a list of simulation specifications on a pool of workers,
+* one process per simulation, so that each simulation has its own
+* spec, qlog directory and error log "<name>.log". The exit status
+* and the wall time of each simulation are collected in a single
+* report.
+*
+* Each spec file is parsed once, before starting the simulations.
+* If the spec describes a parameter sweep, each point of the sweep
+* is a separate simulation, named "<name>_p<point>", which runs
+* with a copy of the parsed spec. The results of the sweep are
+* also summarized in "<name>_sweep.csv". Variants of the spec run
+* in the same way, as "<name>_<variant>". With "replicas: N", each
+* simulation runs N times, as "<name>_r<replica>", and the summaries of
+* the replicas are aggregated in "<name>_replicas.csv".
+ */
+
+#if !defined(_WINDOWS) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WINDOWS
+#include <windows.h>
+#include <direct.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/wait.h>
+#endif
+#include "picoquic.h"
+#include "picoquic_ns.h"
+#include "picoquic_utils.h"
+#include "pico_sim.h"
+
+typedef struct st_pico_sim_base_t {
+    char* spec_file_name;
+    char name[256];
+    int is_parsed;
+    pico_sim_spec_t spec;
+    pico_sim_sweep_t sweep;
+} pico_sim_base_t;
+
+typedef struct st_pico_sim_job_t {
+    size_t base_id;
+    size_t point;
+    size_t replica;
+    char name[288];
+    int ret;
+    int is_running;
+    int is_done;
+#ifndef _WINDOWS
+    pid_t pid;
+#endif
+    uint64_t start_time;
+    uint64_t wall_time;
+} pico_sim_job_t;
+
+typedef struct st_pico_sim_batch_t {
+    pico_sim_base_t* bases;
+    size_t nb_bases;
+    size_t nb_bases_max;
+    pico_sim_job_t* jobs;
+    size_t nb_jobs;
+    size_t nb_jobs_max;
+    int do_profile;
+    int nb_threads;
+    char const* cache_dir;
+    int cache_refresh;
+} pico_sim_batch_t;
+
+int pico_sim_is_directory(char const* path)
+{
+#ifdef _WINDOWS
+    struct _stat st;
+    return (_stat(path, &st) == 0 && (st.st_mode & _S_IFDIR) != 0);
+#else
+    struct stat st;
+    return (stat(path, &st) == 0 && S_ISDIR(st.st_mode));
+#endif
+}
+
+int pico_sim_nb_cores(void)
+{
+    int nb_cores = 1;
+#ifdef _WINDOWS
+    SYSTEM_INFO sys_info;
+    GetSystemInfo(&sys_info);
+    nb_cores = (int)sys_info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0) {
+        nb_cores = (int)n;
+    }
+#endif
+    return (nb_cores > 0) ? nb_cores : 1;
+}
+
+int pico_sim_mkdir(char const* path)
+{
+    int ret;
+#ifdef _WINDOWS
+    ret = _mkdir(path);
+#else
+    ret = mkdir(path, 0755);
+#endif
+    if (ret != 0 && pico_sim_is_directory(path)) {
+        ret = 0;
+    }
+    return ret;
+}
+
+/* Make room for one more element in a growing array */
+static int pico_sim_grow(void** elements, size_t nb_elements, size_t* nb_max, size_t element_size)
+{
+    int ret = 0;
+
+    if (nb_elements >= *nb_max) {
+        size_t new_max = (*nb_max == 0) ? 32 : 2 * *nb_max;
+        void* new_elements = realloc(*elements, new_max * element_size);
+        if (new_elements == NULL) {
+            ret = -1;
+        }
+        else {
+            *elements = new_elements;
+            *nb_max = new_max;
+        }
+    }
+    return ret;
+}
+
+/* The name of a simulation is the base name of the spec file, without extension */
+void pico_sim_base_name(char* name, size_t name_size, char const* spec_file_name)
+{
+    char const* base_name = spec_file_name;
+    size_t name_len;
+
+    for (char const* x = spec_file_name; *x != 0; x++) {
+        if (*x == '/' || *x == '\\') {
+            base_name = x + 1;
+        }
+    }
+    name_len = strlen(base_name);
+    if (name_len > 4 && strcmp(base_name + name_len - 4, ".txt") == 0) {
+        name_len -= 4;
+    }
+    if (name_len >= name_size) {
+        name_len = name_size - 1;
+    }
+    memcpy(name, base_name, name_len);
+    name[name_len] = 0;
+}
+
+static int pico_sim_batch_add(pico_sim_batch_t* batch, char const* spec_file_name)
+{
+    int ret = pico_sim_grow((void**)&batch->bases, batch->nb_bases, &batch->nb_bases_max, sizeof(pico_sim_base_t));
+
+    if (ret == 0) {
+        pico_sim_base_t* base = &batch->bases[batch->nb_bases];
+        size_t l = strlen(spec_file_name);
+
+        memset(base, 0, sizeof(pico_sim_base_t));
+        if ((base->spec_file_name = (char*)malloc(l + 1)) == NULL) {
+            ret = -1;
+        }
+        else {
+            memcpy(base->spec_file_name, spec_file_name, l + 1);
+            pico_sim_base_name(base->name, sizeof(base->name), spec_file_name);
+            batch->nb_bases++;
+        }
+    }
+    return ret;
+}
+
+static int pico_sim_compare_names(const void* a, const void* b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+void pico_sim_free_file_list(char** names, size_t nb_names)
+{
+    if (names != NULL) {
+        for (size_t i = 0; i < nb_names; i++) {
+            free(names[i]);
+        }
+        free(names);
+    }
+}
+
+/* List the files in a directory whose name ends with the suffix,
+ * in alphabetic order. The names include the directory path. */
+int pico_sim_list_files(char const* dir, char const* suffix, char*** names, size_t* nb_names)
+{
+    int ret = 0;
+    size_t nb_max = 0;
+    size_t suffix_len = strlen(suffix);
+    size_t dir_len = strlen(dir);
+    int add_sep = (dir_len > 0 && dir[dir_len - 1] != '/' && dir[dir_len - 1] != '\\');
+    char file_path[1024];
+#ifdef _WINDOWS
+    struct _finddata_t fd;
+    intptr_t h;
+#else
+    DIR* d = opendir(dir);
+    struct dirent* de;
+#endif
+
+    *names = NULL;
+    *nb_names = 0;
+#ifdef _WINDOWS
+    (void)snprintf(file_path, sizeof(file_path), "%s%s*%s", dir, (add_sep) ? "\\" : "", suffix);
+    if ((h = _findfirst(file_path, &fd)) != -1) {
+        do {
+            if ((fd.attrib & _A_SUBDIR) == 0) {
+                char const* file_name = fd.name;
+#else
+    if (d == NULL) {
+        fprintf(stderr, "Cannot open directory <%s>\n", dir);
+        ret = -1;
+    }
+    else {
+        while (ret == 0 && (de = readdir(d)) != NULL) {
+            char const* file_name = de->d_name;
+            size_t l = strlen(file_name);
+            if (l > suffix_len && strcmp(file_name + l - suffix_len, suffix) == 0) {
+#endif
+                int n = snprintf(file_path, sizeof(file_path), "%s%s%s", dir, (add_sep) ? PICO_SIM_PATH_SEP_STR : "", file_name);
+                if (n > 0 && (size_t)n < sizeof(file_path) && !pico_sim_is_directory(file_path)) {
+                    if ((ret = pico_sim_grow((void**)names, *nb_names, &nb_max, sizeof(char*))) == 0) {
+                        if (((*names)[*nb_names] = (char*)malloc((size_t)n + 1)) == NULL) {
+                            ret = -1;
+                        }
+                        else {
+                            memcpy((*names)[*nb_names], file_path, (size_t)n + 1);
+                            *nb_names += 1;
+                        }
+                    }
+                }
+            }
+#ifdef _WINDOWS
+        } while (ret == 0 && _findnext(h, &fd) == 0);
+        _findclose(h);
+    }
+#else
+        }
+        closedir(d);
+    }
+#endif
+    if (ret == 0 && *nb_names > 1) {
+        qsort(*names, *nb_names, sizeof(char*), pico_sim_compare_names);
+    }
+    else if (ret != 0) {
+        pico_sim_free_file_list(*names, *nb_names);
+        *names = NULL;
+        *nb_names = 0;
+    }
+    return ret;
+}
+
+/* Files of a run. The simulation writes its qlogs in a directory of its
+ * own, "<qlog_dir>/<name>.run<n>", created for the run, so that the files
+ * of other runs writing in the same qlog_dir at the same time are not
+ * mistaken for those of the run. After the simulation, the files are
+ * moved to the qlog_dir, and their names kept in the list of the run.
+ */
+static int pico_sim_mkdir_new(char const* path)
+{
+#ifdef _WINDOWS
+    return _mkdir(path);
+#else
+    return mkdir(path, 0755);
+#endif
+}
+
+int pico_sim_run_files_open(pico_sim_run_files_t* run_files, char const* qlog_dir, char const* name)
+{
+    int ret = -1;
+
+    memset(run_files, 0, sizeof(pico_sim_run_files_t));
+    if (pico_sim_mkdir(qlog_dir) == 0) {
+        for (int n = 0; ret != 0 && n < 1000; n++) {
+            int l = snprintf(run_files->run_dir, sizeof(run_files->run_dir), "%s%s%s.run%d", qlog_dir,
+                PICO_SIM_PATH_SEP_STR, name, n);
+            if (l <= 0 || (size_t)l >= sizeof(run_files->run_dir)) {
+                break;
+            }
+            ret = pico_sim_mkdir_new(run_files->run_dir);
+        }
+    }
+    if (ret != 0) {
+        run_files->run_dir[0] = 0;
+    }
+    return ret;
+}
+
+int pico_sim_run_files_add(pico_sim_run_files_t* run_files, char const* file_name)
+{
+    int ret = 0;
+    size_t l = strlen(file_name);
+
+    for (size_t i = 0; i < run_files->nb_names; i++) {
+        if (strcmp(run_files->names[i], file_name) == 0) {
+            /* Already listed */
+            return 0;
+        }
+    }
+    if ((ret = pico_sim_grow((void**)&run_files->names, run_files->nb_names, &run_files->nb_names_max, sizeof(char*))) == 0) {
+        if ((run_files->names[run_files->nb_names] = (char*)malloc(l + 1)) == NULL) {
+            ret = -1;
+        }
+        else {
+            memcpy(run_files->names[run_files->nb_names], file_name, l + 1);
+            run_files->nb_names++;
+        }
+    }
+    return ret;
+}
+
+void pico_sim_run_files_remove(pico_sim_run_files_t* run_files, char const* file_name)
+{
+    for (size_t i = 0; i < run_files->nb_names; i++) {
+        if (strcmp(run_files->names[i], file_name) == 0) {
+            free(run_files->names[i]);
+            run_files->nb_names--;
+            memmove(&run_files->names[i], &run_files->names[i + 1], (run_files->nb_names - i) * sizeof(char*));
+            break;
+        }
+    }
+}
+
+/* Move the files of the run directory to the qlog_dir, and remove the run directory */
+int pico_sim_run_files_close(pico_sim_run_files_t* run_files, char const* qlog_dir)
+{
+    int ret = 0;
+    char** names = NULL;
+    size_t nb_names = 0;
+    char file_name[1024];
+
+    if (run_files->run_dir[0] == 0) {
+        ret = -1;
+    }
+    else if ((ret = pico_sim_list_files(run_files->run_dir, "", &names, &nb_names)) == 0) {
+        size_t prefix_len = strlen(run_files->run_dir) + 1;
+
+        for (size_t i = 0; ret == 0 && i < nb_names; i++) {
+            (void)snprintf(file_name, sizeof(file_name), "%s%s%s", qlog_dir, PICO_SIM_PATH_SEP_STR, names[i] + prefix_len);
+#ifdef _WINDOWS
+            (void)remove(file_name);
+#endif
+            if (rename(names[i], file_name) != 0) {
+                fprintf(stderr, "Cannot move <%s> to <%s>\n", names[i], file_name);
+                ret = -1;
+            }
+            else {
+                ret = pico_sim_run_files_add(run_files, file_name);
+            }
+        }
+        pico_sim_free_file_list(names, nb_names);
+    }
+    if (ret == 0) {
+#ifdef _WINDOWS
+        ret = _rmdir(run_files->run_dir);
+#else
+        ret = rmdir(run_files->run_dir);
+#endif
+        run_files->run_dir[0] = 0;
+    }
+    return ret;
+}
+
+void pico_sim_run_files_release(pico_sim_run_files_t* run_files)
+{
+    pico_sim_free_file_list(run_files->names, run_files->nb_names);
+    memset(run_files, 0, sizeof(pico_sim_run_files_t));
+}
+
+/* List the files of the run whose name ends with the suffix, in
+ * alphabetic order. The list is a copy, freed with pico_sim_free_file_list. */
+int pico_sim_list_run_qlogs(pico_sim_run_files_t const* run_files, char const* suffix, char*** names, size_t* nb_names)
+{
+    int ret = 0;
+    size_t nb_max = 0;
+    size_t suffix_len = strlen(suffix);
+
+    *names = NULL;
+    *nb_names = 0;
+    for (size_t i = 0; ret == 0 && i < run_files->nb_names; i++) {
+        size_t l = strlen(run_files->names[i]);
+
+        if (l > suffix_len && strcmp(run_files->names[i] + l - suffix_len, suffix) == 0) {
+            if ((ret = pico_sim_grow((void**)names, *nb_names, &nb_max, sizeof(char*))) == 0) {
+                if (((*names)[*nb_names] = (char*)malloc(l + 1)) == NULL) {
+                    ret = -1;
+                }
+                else {
+                    memcpy((*names)[*nb_names], run_files->names[i], l + 1);
+                    *nb_names += 1;
+                }
+            }
+        }
+    }
+    if (ret == 0 && *nb_names > 1) {
+        qsort(*names, *nb_names, sizeof(char*), pico_sim_compare_names);
+    }
+    else if (ret != 0) {
+        pico_sim_free_file_list(*names, *nb_names);
+        *names = NULL;
+        *nb_names = 0;
+    }
+    return ret;
+}
+
+static int pico_sim_batch_add_file_or_dir(pico_sim_batch_t* batch, char const* path)
+{
+    int ret = 0;
+
+    if (!pico_sim_is_directory(path)) {
+        ret = pico_sim_batch_add(batch, path);
+    }
+    else {
+        /* Add all the ".txt" files in the directory, in alphabetic order */
+        char** names = NULL;
+        size_t nb_names = 0;
+
+        if ((ret = pico_sim_list_files(path, ".txt", &names, &nb_names)) == 0) {
+            for (size_t i = 0; ret == 0 && i < nb_names; i++) {
+                ret = pico_sim_batch_add(batch, names[i]);
+            }
+            pico_sim_free_file_list(names, nb_names);
+        }
+    }
+    return ret;
+}
+
+/* Parse a spec file. If the file cannot be parsed, the base is
+ * left unparsed, and its single job fails.
+ */
+static void pico_sim_batch_parse(pico_sim_base_t* base)
+{
+    FILE* F = NULL;
+
+    if ((F = picoquic_file_open(base->spec_file_name, "r")) == NULL) {
+        fprintf(stderr, "Cannot open file <%s>\n", base->spec_file_name);
+    }
+    else {
+        if (parse_spec_file_sweep(&base->spec, &base->sweep, F) != 0) {
+            fprintf(stderr, "Error when processing file <%s>\n", base->spec_file_name);
+            release_spec_data(&base->spec);
+        }
+        else {
+            base->is_parsed = 1;
+        }
+        F = picoquic_file_close(F);
+    }
+}
+
+/* Create one job per point of the sweep and per replica of a parsed spec.
+ * If the spec was not parsed, create a single failed job, so
+ * that the error appears in the report.
+ */
+static int pico_sim_batch_add_jobs(pico_sim_batch_t* batch, size_t base_id)
+{
+    int ret = 0;
+    pico_sim_base_t* base = &batch->bases[base_id];
+    size_t nb_points = 1;
+    size_t nb_replicas = 1;
+
+    if (base->is_parsed && base->spec.nb_replicas > 1 &&
+        pico_sim_sweep_nb_points(&base->sweep) * base->spec.nb_replicas > PICO_SIM_SWEEP_POINTS_MAX) {
+        fprintf(stderr, "Too many replicas in <%s>, max %d simulations\n", base->spec_file_name, PICO_SIM_SWEEP_POINTS_MAX);
+        release_spec_data(&base->spec);
+        pico_sim_sweep_release(&base->sweep);
+        base->is_parsed = 0;
+    }
+    if (base->is_parsed) {
+        nb_points = pico_sim_sweep_nb_points(&base->sweep);
+        if (base->spec.nb_replicas > 1) {
+            nb_replicas = (size_t)base->spec.nb_replicas;
+        }
+    }
+
+    for (size_t i = 0; ret == 0 && i < nb_points * nb_replicas; i++) {
+        if ((ret = pico_sim_grow((void**)&batch->jobs, batch->nb_jobs, &batch->nb_jobs_max, sizeof(pico_sim_job_t))) == 0) {
+            pico_sim_job_t* job = &batch->jobs[batch->nb_jobs];
+
+            memset(job, 0, sizeof(pico_sim_job_t));
+            job->base_id = base_id;
+            job->point = i / nb_replicas;
+            job->replica = i % nb_replicas;
+            pico_sim_sweep_point_name(job->name, sizeof(job->name), base->name, &base->sweep, job->point);
+            if (nb_replicas > 1) {
+                size_t l = strlen(job->name);
+                (void)snprintf(job->name + l, sizeof(job->name) - l, "_r%zu", job->replica);
+            }
+            if (!base->is_parsed) {
+                job->is_done = 1;
+                job->ret = -1;
+            }
+            batch->nb_jobs++;
+        }
+    }
+    return ret;
+}
+
+static void pico_sim_batch_release(pico_sim_batch_t* batch)
+{
+    for (size_t i = 0; i < batch->nb_bases; i++) {
+        if (batch->bases[i].spec_file_name != NULL) {
+            free(batch->bases[i].spec_file_name);
+        }
+        if (batch->bases[i].is_parsed) {
+            release_spec_data(&batch->bases[i].spec);
+            pico_sim_sweep_release(&batch->bases[i].sweep);
+        }
+    }
+    if (batch->bases != NULL) {
+        free(batch->bases);
+    }
+    if (batch->jobs != NULL) {
+        free(batch->jobs);
+    }
+    memset(batch, 0, sizeof(pico_sim_batch_t));
+}
+
+/* Give each job its own qlog directory, as a subdirectory
+ * of the directory named in the spec.
+ */
+static int pico_sim_job_qlog_dir(pico_sim_job_t* job, picoquic_ns_spec_t* spec)
+{
+    int ret = 0;
+
+    if (spec->qlog_dir != NULL) {
+        size_t l = strlen(spec->qlog_dir) + strlen(job->name) + 2;
+        char* job_dir = (char*)malloc(l);
+
+        if (job_dir == NULL) {
+            ret = -1;
+        }
+        else {
+            (void)snprintf(job_dir, l, "%s%c%s", spec->qlog_dir, PICO_SIM_PATH_SEP, job->name);
+            if (pico_sim_mkdir(spec->qlog_dir) != 0 || pico_sim_mkdir(job_dir) != 0) {
+                fprintf(stderr, "Cannot create qlog directory <%s>\n", job_dir);
+                free(job_dir);
+                ret = -1;
+            }
+            else {
+                free((void*)spec->qlog_dir);
+                spec->qlog_dir = job_dir;
+            }
+        }
+    }
+    return ret;
+}
+
+/* Give each job its own qperf log, "<name>_<file>" in the directory
+ * of the log named in the spec, since the jobs of a spec, replicas,
+ * sweep points or variants, run at the same time.
+ */
+static int pico_sim_job_qperf_log(pico_sim_job_t* job, picoquic_ns_spec_t* spec)
+{
+    int ret = 0;
+
+    if (spec->qperf_log != NULL) {
+        char const* file_name = spec->qperf_log;
+        size_t l = strlen(spec->qperf_log) + strlen(job->name) + 2;
+        char* job_log = (char*)malloc(l);
+
+        for (char const* x = spec->qperf_log; *x != 0; x++) {
+            if (*x == '/' || *x == '\\') {
+                file_name = x + 1;
+            }
+        }
+        if (job_log == NULL) {
+            ret = -1;
+        }
+        else {
+            (void)snprintf(job_log, l, "%.*s%s_%s", (int)(file_name - spec->qperf_log), spec->qperf_log,
+                job->name, file_name);
+            free((void*)spec->qperf_log);
+            spec->qperf_log = job_log;
+        }
+    }
+    return ret;
+}
+
+/* Run a single job on its own copy of the parsed spec, writing
+ * the error messages of the simulation to the log file err_F.
+ */
+static int pico_sim_job_run(pico_sim_batch_t* batch, pico_sim_job_t* job, FILE* err_F)
+{
+    int ret = 0;
+    pico_sim_base_t* base = &batch->bases[job->base_id];
+    pico_sim_spec_t spec = { 0 };
+
+    if (copy_spec_data(&spec, &base->spec) != 0) {
+        fprintf(err_F, "Cannot copy the spec of <%s>\n", base->spec_file_name);
+        ret = -1;
+    }
+    else {
+        if (pico_sim_sweep_apply(&spec, &base->sweep, job->point) != 0) {
+            fprintf(err_F, "Cannot apply point %zu of <%s>\n", job->point, base->spec_file_name);
+            ret = -1;
+        }
+        else if ((ret = pico_sim_job_qlog_dir(job, &spec.ns)) == 0 &&
+            (ret = pico_sim_job_qperf_log(job, &spec.ns)) == 0) {
+            pico_sim_variant_t const* variant = pico_sim_sweep_variant(&base->sweep, job->point);
+            if (base->spec.nb_replicas > 1) {
+                pico_sim_replica_apply(&spec, job->replica);
+                fprintf(err_F, "replica: %zu\n", job->replica);
+            }
+            if (variant != NULL) {
+                fprintf(err_F, "variant: %s\n", variant->name);
+                for (size_t i = 0; i < variant->nb_params; i++) {
+                    fprintf(err_F, "%s: %s\n", variant->param_name[i], variant->values[i]);
+                }
+            }
+            for (size_t i = 0; i < base->sweep.nb_dims; i++) {
+                fprintf(err_F, "%s: %s\n", base->sweep.dims[i].param_name,
+                    pico_sim_sweep_value(&base->sweep, i, job->point));
+            }
+            spec.do_profile = batch->do_profile;
+            spec.nb_threads = batch->nb_threads;
+            spec.cache_dir = batch->cache_dir;
+            spec.cache_refresh = batch->cache_refresh;
+            ret = pico_sim_run(&spec, job->name, err_F);
+        }
+        release_spec_data(&spec);
+    }
+    return ret;
+}
+
+#ifndef _WINDOWS
+/* Start a job in a child process. The child inherits the parsed
+ * spec from the parent, and redirects its stderr to the job log,
+ * so that debug messages printed by the picoquic library do not
+ * get mixed with those of other jobs.
+ */
+static int pico_sim_job_start(pico_sim_batch_t* batch, pico_sim_job_t* job)
+{
+    int ret = 0;
+    pid_t pid;
+
+    fflush(stdout);
+    fflush(stderr);
+    job->start_time = picoquic_current_time();
+    pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "Cannot fork a process for <%s>\n", job->name);
+        job->is_done = 1;
+        job->ret = -1;
+        ret = -1;
+    }
+    else if (pid == 0) {
+        char log_name[512];
+        int job_ret;
+
+        (void)snprintf(log_name, sizeof(log_name), "%s.log", job->name);
+        if (freopen(log_name, "w", stderr) == NULL) {
+            _exit(126);
+        }
+        job_ret = pico_sim_job_run(batch, job, stderr);
+        fflush(stderr);
+        _exit((job_ret == 0) ? 0 : 1);
+    }
+    else {
+        job->pid = pid;
+        job->is_running = 1;
+    }
+    return ret;
+}
+
+static pico_sim_job_t* pico_sim_job_wait(pico_sim_batch_t* batch)
+{
+    pico_sim_job_t* job = NULL;
+    int status = 0;
+    pid_t pid;
+
+    while (job == NULL && (pid = waitpid(-1, &status, 0)) > 0) {
+        for (size_t i = 0; i < batch->nb_jobs; i++) {
+            if (batch->jobs[i].is_running && batch->jobs[i].pid == pid) {
+                job = &batch->jobs[i];
+                job->is_running = 0;
+                job->is_done = 1;
+                job->wall_time = picoquic_current_time() - job->start_time;
+                if (WIFEXITED(status)) {
+                    job->ret = WEXITSTATUS(status);
+                }
+                else {
+                    /* Killed by a signal, e.g., a crash of the simulation */
+                    job->ret = (WIFSIGNALED(status)) ? 128 + WTERMSIG(status) : -1;
+                }
+                break;
+            }
+        }
+    }
+    return job;
+}
+#endif
+
+/* One CSV per sweep, with one row per point listing the values
+ * of the swept parameters and the result of the simulation.
+ */
+static int pico_sim_sweep_report(pico_sim_batch_t* batch, size_t base_id)
+{
+    int ret = 0;
+    pico_sim_base_t* base = &batch->bases[base_id];
+    char csv_name[512];
+    FILE* F;
+
+    (void)snprintf(csv_name, sizeof(csv_name), "%s_sweep.csv", base->name);
+    if ((F = picoquic_file_open(csv_name, "w")) == NULL) {
+        fprintf(stderr, "Cannot open sweep report <%s>\n", csv_name);
+        ret = -1;
+    }
+    else {
+        fprintf(F, "point, name");
+        if (base->sweep.nb_variants > 0) {
+            fprintf(F, ", variant");
+        }
+        for (size_t i = 0; i < base->sweep.nb_dims; i++) {
+            fprintf(F, ", %s", base->sweep.dims[i].param_name);
+        }
+        if (base->spec.nb_replicas > 1) {
+            fprintf(F, ", replica");
+        }
+        fprintf(F, ", status, wall_time_ms\n");
+        for (size_t j = 0; j < batch->nb_jobs; j++) {
+            pico_sim_job_t* job = &batch->jobs[j];
+            if (job->base_id == base_id) {
+                fprintf(F, "%zu, %s", job->point, job->name);
+                if (base->sweep.nb_variants > 0) {
+                    fprintf(F, ", %s", pico_sim_sweep_variant(&base->sweep, job->point)->name);
+                }
+                for (size_t i = 0; i < base->sweep.nb_dims; i++) {
+                    fprintf(F, ", %s", pico_sim_sweep_value(&base->sweep, i, job->point));
+                }
+                if (base->spec.nb_replicas > 1) {
+                    fprintf(F, ", %zu", job->replica);
+                }
+                fprintf(F, ", %d, %.3f\n", (job->is_done) ? job->ret : -1, ((double)job->wall_time) / 1000.0);
+            }
+        }
+        (void)picoquic_file_close(F);
+    }
+    return ret;
+}
+
+/* Aggregate the summaries of the replicas of each point of a spec. The
+ * jobs of the replicas of a point are consecutive in the list of jobs.
+ */
+static int pico_sim_replicas_batch_report(pico_sim_batch_t* batch, size_t base_id)
+{
+    int ret = 0;
+    pico_sim_base_t* base = &batch->bases[base_id];
+    char const** names = NULL;
+    size_t nb_names = 0;
+    char point_name[288];
+
+    if ((names = (char const**)malloc(sizeof(char const*) * (size_t)base->spec.nb_replicas)) == NULL) {
+        ret = -1;
+    }
+    for (size_t j = 0; ret == 0 && j < batch->nb_jobs; j++) {
+        pico_sim_job_t* job = &batch->jobs[j];
+        if (job->base_id == base_id) {
+            if (job->is_done && job->ret == 0) {
+                names[nb_names++] = job->name;
+            }
+            if (job->replica + 1 == base->spec.nb_replicas) {
+                pico_sim_sweep_point_name(point_name, sizeof(point_name), base->name, &base->sweep, job->point);
+                if (nb_names == 0 ||
+                    pico_sim_replicas_report(point_name, names, nb_names, base->spec.summary_format, stderr) != 0) {
+                    fprintf(stderr, "Cannot aggregate the replicas of <%s>\n", point_name);
+                    ret = -1;
+                }
+                nb_names = 0;
+            }
+        }
+    }
+    if (names != NULL) {
+        free((void*)names);
+    }
+    return ret;
+}
+
+/* Copy the profile of a job, written by the job in "<name>_profile.csv",
+ * to its row of the batch report. */
+static void pico_sim_batch_report_profile(FILE* F, pico_sim_job_t* job)
+{
+    char profile_name[512];
+    char line[512];
+    FILE* P;
+
+    (void)snprintf(profile_name, sizeof(profile_name), "%s_profile.csv", job->name);
+    if ((P = picoquic_file_open(profile_name, "r")) != NULL) {
+        if (fgets(line, sizeof(line), P) != NULL && fgets(line, sizeof(line), P) != NULL) {
+            line[strcspn(line, "\r\n")] = 0;
+            fprintf(F, ", %s", line);
+        }
+        (void)picoquic_file_close(P);
+    }
+}
+
+static int pico_sim_batch_report(pico_sim_batch_t* batch, char const* report_file_name, uint64_t batch_time)
+{
+    int ret = 0;
+    FILE* F = NULL;
+    int nb_failed = 0;
+
+    if (report_file_name != NULL && (F = picoquic_file_open(report_file_name, "w")) == NULL) {
+        fprintf(stderr, "Cannot open report file <%s>\n", report_file_name);
+        ret = -1;
+    }
+    if (F != NULL) {
+        fprintf(F, "spec, name, status, wall_time_ms%s%s\n", (batch->do_profile) ? ", " : "",
+            (batch->do_profile) ? PICO_SIM_PROFILE_HEADER : "");
+    }
+    for (size_t i = 0; i < batch->nb_jobs; i++) {
+        pico_sim_job_t* job = &batch->jobs[i];
+        char const* spec_file_name = batch->bases[job->base_id].spec_file_name;
+
+        if (!job->is_done || job->ret != 0) {
+            nb_failed++;
+            fprintf(stderr, "Simulation <%s> failed, status %d, see %s.log\n",
+                job->name, job->ret, job->name);
+        }
+        if (F != NULL) {
+            fprintf(F, "%s, %s, %d, %.3f", spec_file_name, job->name,
+                (job->is_done) ? job->ret : -1, ((double)job->wall_time) / 1000.0);
+            if (batch->do_profile) {
+                pico_sim_batch_report_profile(F, job);
+            }
+            fprintf(F, "\n");
+        }
+    }
+    if (F != NULL) {
+        (void)picoquic_file_close(F);
+    }
+    for (size_t i = 0; i < batch->nb_bases; i++) {
+        if (pico_sim_sweep_is_set(&batch->bases[i].sweep) && pico_sim_sweep_report(batch, i) != 0) {
+            ret = -1;
+        }
+        if (batch->bases[i].is_parsed && batch->bases[i].spec.nb_replicas > 1 &&
+            pico_sim_replicas_batch_report(batch, i) != 0) {
+            ret = -1;
+        }
+    }
+    fprintf(stderr, "Batch: %zu simulations, %d failed, %.3f seconds.\n",
+        batch->nb_jobs, nb_failed, ((double)batch_time) / 1000000.0);
+    if (nb_failed > 0) {
+        ret = -1;
+    }
+    return ret;
+}
+
+static int pico_sim_compare_jobs(const void* a, const void* b)
+{
+    return strcmp((*(pico_sim_job_t* const*)a)->name, (*(pico_sim_job_t* const*)b)->name);
+}
+
+/* The name of a job names its log, its qlog directory and its outputs, so two
+ * jobs of the same name, e.g., "a/x.txt" and "b/x.txt", would overwrite each
+ * other's files, or write them at the same time.
+ */
+static int pico_sim_batch_check_names(pico_sim_batch_t* batch)
+{
+    int ret = 0;
+    pico_sim_job_t** sorted = NULL;
+
+    if (batch->nb_jobs > 1) {
+        if ((sorted = (pico_sim_job_t**)malloc(batch->nb_jobs * sizeof(pico_sim_job_t*))) == NULL) {
+            ret = -1;
+        }
+        else {
+            for (size_t i = 0; i < batch->nb_jobs; i++) {
+                sorted[i] = &batch->jobs[i];
+            }
+            qsort(sorted, batch->nb_jobs, sizeof(pico_sim_job_t*), pico_sim_compare_jobs);
+            for (size_t i = 1; i < batch->nb_jobs; i++) {
+                if (strcmp(sorted[i - 1]->name, sorted[i]->name) == 0) {
+                    fprintf(stderr, "Simulation name <%s> used by <%s> and <%s>, rename one of the specs.\n",
+                        sorted[i]->name, batch->bases[sorted[i - 1]->base_id].spec_file_name,
+                        batch->bases[sorted[i]->base_id].spec_file_name);
+                    ret = -1;
+                }
+            }
+            free(sorted);
+        }
+    }
+    return ret;
+}
+
+/* Create the jobs of the bases, run them, write the report, and release the batch */
+static int pico_sim_batch_execute(pico_sim_batch_t* batch, int nb_workers, char const* report_file_name,
+    uint64_t batch_start)
+{
+    int ret = 0;
+
+    for (size_t i = 0; ret == 0 && i < batch->nb_bases; i++) {
+        ret = pico_sim_batch_add_jobs(batch, i);
+    }
+    if (ret == 0 && batch->nb_jobs == 0) {
+        fprintf(stderr, "No simulation specification found.\n");
+        ret = -1;
+    }
+    if (ret == 0) {
+        ret = pico_sim_batch_check_names(batch);
+    }
+    if (ret == 0) {
+        if (nb_workers <= 0) {
+            nb_workers = pico_sim_nb_cores();
+        }
+        fprintf(stderr, "Running %zu simulations on %d workers.\n", batch->nb_jobs, nb_workers);
+#ifdef _WINDOWS
+        /* No fork on Windows: run the jobs one after the other. */
+        for (size_t i = 0; i < batch->nb_jobs; i++) {
+            pico_sim_job_t* job = &batch->jobs[i];
+            char log_name[512];
+            FILE* err_F;
+
+            if (job->is_done) {
+                continue;
+            }
+            (void)snprintf(log_name, sizeof(log_name), "%s.log", job->name);
+            job->start_time = picoquic_current_time();
+            if ((err_F = picoquic_file_open(log_name, "w")) == NULL) {
+                fprintf(stderr, "Cannot open log file <%s>\n", log_name);
+                job->ret = -1;
+            }
+            else {
+                job->ret = pico_sim_job_run(batch, job, err_F);
+                (void)picoquic_file_close(err_F);
+            }
+            job->wall_time = picoquic_current_time() - job->start_time;
+            job->is_done = 1;
+        }
+#else
+        {
+            size_t next_job = 0;
+            int nb_running = 0;
+
+            while (next_job < batch->nb_jobs || nb_running > 0) {
+                if (next_job < batch->nb_jobs && batch->jobs[next_job].is_done) {
+                    /* Spec could not be parsed, nothing to run */
+                    next_job++;
+                }
+                else if (next_job < batch->nb_jobs && nb_running < nb_workers) {
+                    if (pico_sim_job_start(batch, &batch->jobs[next_job]) == 0) {
+                        nb_running++;
+                    }
+                    next_job++;
+                }
+                else {
+                    pico_sim_job_t* job = pico_sim_job_wait(batch);
+                    if (job == NULL) {
+                        break;
+                    }
+                    nb_running--;
+                    fprintf(stderr, "%s: status %d, %.3f s\n", job->name, job->ret,
+                        ((double)job->wall_time) / 1000000.0);
+                }
+            }
+        }
+#endif
+        ret = pico_sim_batch_report(batch, report_file_name, picoquic_current_time() - batch_start);
+    }
+    pico_sim_batch_release(batch);
+
+    return ret;
+}
+
+int pico_sim_batch(char const** spec_names, int nb_spec_names, int nb_workers, char const* report_file_name, int do_profile,
+    int nb_threads, char const* cache_dir, int cache_refresh)
+{
+    int ret = 0;
+    pico_sim_batch_t batch = { 0 };
+    uint64_t batch_start = picoquic_current_time();
+
+    batch.do_profile = do_profile;
+    batch.nb_threads = nb_threads;
+    batch.cache_dir = cache_dir;
+    batch.cache_refresh = cache_refresh;
+
+    for (int i = 0; ret == 0 && i < nb_spec_names; i++) {
+        ret = pico_sim_batch_add_file_or_dir(&batch, spec_names[i]);
+    }
+    for (size_t i = 0; ret == 0 && i < batch.nb_bases; i++) {
+        pico_sim_batch_parse(&batch.bases[i]);
+    }
+    if (ret == 0) {
+        ret = pico_sim_batch_execute(&batch, nb_workers, report_file_name, batch_start);
+    }
+    else {
+        pico_sim_batch_release(&batch);
+    }
+
+    return ret;
+}
+
+/* Batch of a single spec file, already parsed, e.g., a sweep. The batch
+ * takes the parsed spec and sweep, which are reset to empty values.
+ */
+int pico_sim_batch_parsed(char const* spec_file_name, pico_sim_spec_t* spec, pico_sim_sweep_t* sweep,
+    int nb_workers, char const* report_file_name, int do_profile, int nb_threads, char const* cache_dir, int cache_refresh)
+{
+    int ret = 0;
+    pico_sim_batch_t batch = { 0 };
+    uint64_t batch_start = picoquic_current_time();
+
+    batch.do_profile = do_profile;
+    batch.nb_threads = nb_threads;
+    batch.cache_dir = cache_dir;
+    batch.cache_refresh = cache_refresh;
+
+    if ((ret = pico_sim_batch_add(&batch, spec_file_name)) != 0) {
+        pico_sim_batch_release(&batch);
+    }
+    else {
+        pico_sim_base_t* base = &batch.bases[0];
+
+        base->spec = *spec;
+        base->sweep = *sweep;
+        base->is_parsed = 1;
+        memset(spec, 0, sizeof(pico_sim_spec_t));
+        memset(sweep, 0, sizeof(pico_sim_sweep_t));
+        ret = pico_sim_batch_execute(&batch, nb_workers, report_file_name, batch_start);
+    }
+
+    return ret;
+}
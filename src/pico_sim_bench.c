@@ -0,0 +1,599 @@
+/* Benchmark of the simulator.
+* Runs each simulation spec several times, after warm-up runs, and
+* reports the median and standard deviation of the wall time of the
+* simulation, the number of simulated events per second, and the wall
+* time per simulated second, with the peak memory of the runs and the
+* memory kept by the process from one run to the next. Specs with parameter sweeps or variants are
+* benchmarked for each point, e.g., to measure how the simulation time
+* grows with the number of connections. The results are written in JSON, and can be compared to a baseline written by
+* a previous run: the benchmark fails if the median time of a scenario
+* is more than a given percentage above the baseline.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include "picoquic.h"
+#include "picoquic_ns.h"
+#include "picoquic_utils.h"
+#include "pico_sim.h"
+#include "pico_sim_qlog.h"
+
+#ifdef _WINDOWS
+#include "../pico_sim_vs/pico_sim_vs/getopt.h"
+#ifdef _WINDOWS64
+#define PICOQUIC_DIR "../../../../picoquic"
+#else
+#define PICOQUIC_DIR "../../../picoquic"
+#endif
+#else
+#define PICOQUIC_DIR "../picoquic"
+#endif
+
+#define PICO_SIM_BENCH_SPECS "../sim_specs"
+#define PICO_SIM_BENCH_OUTPUT "pico_sim_bench.json"
+#define PICO_SIM_BENCH_LOG "pico_sim_bench.log"
+#define PICO_SIM_BENCH_RUNS_MAX 1000
+
+typedef struct st_pico_sim_bench_result_t {
+    char name[288];
+    int ret;
+    int nb_connections;
+    size_t nb_runs;
+    double median_ms;
+    double stddev_ms;
+    uint64_t nb_events;
+    double events_per_second;
+    uint64_t virtual_time;
+    double ms_per_sim_second;
+    uint64_t peak_memory;
+    int64_t memory_growth;
+    int has_baseline;
+    double baseline_ms;
+    int is_regression;
+} pico_sim_bench_result_t;
+
+typedef struct st_pico_sim_bench_baseline_t {
+    pico_sim_bench_result_t* results;
+    size_t nb_results;
+    char name[288];
+    double median_ms;
+    int has_median;
+} pico_sim_bench_baseline_t;
+
+void usage()
+{
+    fprintf(stderr, "Pico_sim_bench, benchmark of the picoquic network simulator\n\n");
+    fprintf(stderr, "Usage: pico_sim_bench [options] [spec_or_directory...]\n\n");
+    fprintf(stderr, "Runs each simulation spec several times, by default all the\n");
+    fprintf(stderr, "specs in \"%s\", and reports the median and standard\n", PICO_SIM_BENCH_SPECS);
+    fprintf(stderr, "deviation of the wall time, the simulated events per second,\n");
+    fprintf(stderr, "and the wall time per simulated second. Each point of a\n");
+    fprintf(stderr, "parameter sweep is benchmarked separately, as \"<name>_p<n>\".\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -S path  Path to the picoquic source directory, where the\n");
+    fprintf(stderr, "           code will find the key and certificates used for\n");
+    fprintf(stderr, "           setting test connections.\n");
+    fprintf(stderr, "  -n nb    Number of measured runs per spec. Default: 5.\n");
+    fprintf(stderr, "  -w nb    Number of warm-up runs per spec. Default: 1.\n");
+    fprintf(stderr, "  -o file  Results, in JSON. Default: %s\n", PICO_SIM_BENCH_OUTPUT);
+    fprintf(stderr, "  -B file  Baseline, i.e., the results of a previous benchmark.\n");
+    fprintf(stderr, "  -t pct   Fail if a median time is more than pct percent above\n");
+    fprintf(stderr, "           the baseline. Default: 10.\n");
+    fprintf(stderr, "  -h       Print this message.\n");
+}
+
+static int pico_sim_bench_compare_double(const void* a, const void* b)
+{
+    double x = *(double const*)a;
+    double y = *(double const*)b;
+    return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+static double pico_sim_bench_double(char const* value, size_t value_len)
+{
+    char buffer[64];
+
+    if (value_len >= sizeof(buffer)) {
+        value_len = sizeof(buffer) - 1;
+    }
+    memcpy(buffer, value, value_len);
+    buffer[value_len] = 0;
+    return strtod(buffer, NULL);
+}
+
+static int pico_sim_bench_baseline_member(void* ctx, char const* name, size_t name_len, char const* value, size_t value_len)
+{
+    pico_sim_bench_baseline_t* baseline = (pico_sim_bench_baseline_t*)ctx;
+
+    if (pico_sim_qlog_is(name, name_len, "name") && value_len >= 2 && value_len - 2 < sizeof(baseline->name)) {
+        memcpy(baseline->name, value + 1, value_len - 2);
+        baseline->name[value_len - 2] = 0;
+    }
+    else if (pico_sim_qlog_is(name, name_len, "median_ms")) {
+        baseline->median_ms = pico_sim_bench_double(value, value_len);
+        baseline->has_median = 1;
+    }
+    return 0;
+}
+
+static int pico_sim_bench_baseline_scenario(void* ctx, char const* value, size_t value_len)
+{
+    int ret;
+    pico_sim_bench_baseline_t* baseline = (pico_sim_bench_baseline_t*)ctx;
+
+    baseline->name[0] = 0;
+    baseline->has_median = 0;
+    if ((ret = pico_sim_qlog_members(value, value_len, pico_sim_bench_baseline_member, baseline)) == 0 &&
+        baseline->has_median) {
+        for (size_t i = 0; i < baseline->nb_results; i++) {
+            if (strcmp(baseline->results[i].name, baseline->name) == 0) {
+                baseline->results[i].has_baseline = 1;
+                baseline->results[i].baseline_ms = baseline->median_ms;
+            }
+        }
+    }
+    return ret;
+}
+
+static int pico_sim_bench_baseline_top(void* ctx, char const* name, size_t name_len, char const* value, size_t value_len)
+{
+    int ret = 0;
+
+    if (pico_sim_qlog_is(name, name_len, "scenarios")) {
+        ret = pico_sim_qlog_elements(value, value_len, pico_sim_bench_baseline_scenario, ctx);
+    }
+    return ret;
+}
+
+static int pico_sim_bench_load_baseline(char const* baseline_name, pico_sim_bench_result_t* results, size_t nb_results)
+{
+    int ret = 0;
+    FILE* F = NULL;
+    char* text = NULL;
+    long text_len = 0;
+    pico_sim_bench_baseline_t baseline = { 0 };
+
+    baseline.results = results;
+    baseline.nb_results = nb_results;
+    if ((F = picoquic_file_open(baseline_name, "rb")) == NULL) {
+        fprintf(stderr, "Cannot open baseline <%s>\n", baseline_name);
+        ret = -1;
+    }
+    else {
+        if (fseek(F, 0, SEEK_END) != 0 || (text_len = ftell(F)) <= 0 || fseek(F, 0, SEEK_SET) != 0 ||
+            (text = (char*)malloc((size_t)text_len)) == NULL ||
+            fread(text, 1, (size_t)text_len, F) != (size_t)text_len ||
+            pico_sim_qlog_members(text, (size_t)text_len, pico_sim_bench_baseline_top, &baseline) != 0) {
+            fprintf(stderr, "Cannot parse baseline <%s>\n", baseline_name);
+            ret = -1;
+        }
+        if (text != NULL) {
+            free(text);
+        }
+        (void)picoquic_file_close(F);
+    }
+    return ret;
+}
+
+/* Run a point of the spec nb_warmup + nb_runs times, timing the simulation itself.
+ * The simulated time is that of the last qlog event if the spec has a qlog_dir,
+ * or the target time of the main connection otherwise. The peak memory is the
+ * largest of the measured runs, and the growth is the change of the resident
+ * memory of the process between the first and the last measured runs.
+ */
+static int pico_sim_bench_point(pico_sim_spec_t const* base, pico_sim_sweep_t const* sweep, size_t point,
+    int nb_warmup, int nb_runs, pico_sim_bench_result_t* result, FILE* log_F)
+{
+    int ret = 0;
+    pico_sim_spec_t model = { 0 };
+    double* times = NULL;
+    uint64_t memory_first = 0;
+
+    if (copy_spec_data(&model, base) != 0) {
+        ret = -1;
+    }
+    else if (pico_sim_sweep_apply(&model, sweep, point) != 0) {
+        fprintf(stderr, "Cannot apply point %zu of <%s>\n", point, result->name);
+        ret = -1;
+    }
+    else if ((times = (double*)malloc(sizeof(double) * nb_runs)) == NULL) {
+        ret = -1;
+    }
+    else if (model.ns.qlog_dir != NULL && pico_sim_mkdir(model.ns.qlog_dir) != 0) {
+        fprintf(stderr, "Cannot create qlog directory <%s>\n", model.ns.qlog_dir);
+        ret = -1;
+    }
+    else if (pico_sim_run_prepare(&model, log_F) != 0) {
+        /* Same queue, link trace and cross traffic as in pico_sim_run */
+        fprintf(stderr, "Cannot prepare the link of <%s>\n", result->name);
+        ret = -1;
+    }
+    result->nb_connections = model.ns.nb_connections;
+    result->virtual_time = model.ns.main_target_time;
+
+    for (int i = 0; ret == 0 && i < nb_warmup + nb_runs; i++) {
+        pico_sim_spec_t spec = { 0 };
+        pico_sim_run_files_t run_files = { 0 };
+        char const* qlog_dir = model.ns.qlog_dir;
+        uint64_t run_time;
+
+        if (copy_spec_data(&spec, &model) != 0) {
+            ret = -1;
+            break;
+        }
+        if (qlog_dir != NULL && pico_sim_run_files_open(&run_files, qlog_dir, result->name) != 0) {
+            /* As in pico_sim_run, so that the qlogs of the run can be listed */
+            fprintf(stderr, "Cannot create the run directory of <%s>\n", result->name);
+            release_spec_data(&spec);
+            ret = -1;
+            break;
+        }
+        pico_sim_memory_reset_peak();
+        if (qlog_dir == NULL) {
+            run_time = picoquic_current_time();
+            ret = picoquic_ns(&spec.ns, log_F);
+            run_time = picoquic_current_time() - run_time;
+        }
+        else {
+            char const* spec_qlog_dir = spec.ns.qlog_dir;
+
+            spec.ns.qlog_dir = run_files.run_dir;
+            run_time = picoquic_current_time();
+            ret = picoquic_ns(&spec.ns, log_F);
+            run_time = picoquic_current_time() - run_time;
+            spec.ns.qlog_dir = spec_qlog_dir;
+            if (pico_sim_run_files_close(&run_files, qlog_dir) != 0 && ret == 0) {
+                fprintf(stderr, "Cannot move the qlogs of <%s> to <%s>\n", result->name, qlog_dir);
+                ret = -1;
+            }
+        }
+        if (i >= nb_warmup) {
+            uint64_t peak_memory = pico_sim_memory_peak();
+            times[result->nb_runs++] = ((double)run_time) / 1000.0;
+            result->peak_memory = (peak_memory > result->peak_memory) ? peak_memory : result->peak_memory;
+            if (i == nb_warmup && ret == 0 && qlog_dir != NULL) {
+                pico_sim_profile_t profile = { 0 };
+                if (pico_sim_profile_scan(&run_files, &profile) == 0) {
+                    result->nb_events = profile.nb_events;
+                    result->virtual_time = profile.virtual_time;
+                }
+            }
+        }
+        pico_sim_run_files_release(&run_files);
+        fprintf(log_F, "picoquic_ns (%s, run %d) returns %d\n", result->name, i, ret);
+        release_spec_data(&spec);
+        pico_sim_memory_release();
+        if (i >= nb_warmup) {
+            /* Memory kept by the process from the first measured run to the last */
+            uint64_t memory = pico_sim_memory_current();
+            if (i == nb_warmup) {
+                memory_first = memory;
+            }
+            result->memory_growth = (int64_t)memory - (int64_t)memory_first;
+        }
+    }
+
+    if (ret == 0 && result->nb_runs > 0) {
+        double sum = 0;
+        double sum_squares = 0;
+        double mean;
+
+        qsort(times, result->nb_runs, sizeof(double), pico_sim_bench_compare_double);
+        result->median_ms = (result->nb_runs % 2 == 1) ? times[result->nb_runs / 2] :
+            (times[result->nb_runs / 2 - 1] + times[result->nb_runs / 2]) / 2.0;
+        for (size_t i = 0; i < result->nb_runs; i++) {
+            sum += times[i];
+        }
+        mean = sum / (double)result->nb_runs;
+        for (size_t i = 0; i < result->nb_runs; i++) {
+            sum_squares += (times[i] - mean) * (times[i] - mean);
+        }
+        if (result->nb_runs > 1) {
+            result->stddev_ms = sqrt(sum_squares / (double)(result->nb_runs - 1));
+        }
+        if (result->median_ms > 0) {
+            result->events_per_second = ((double)result->nb_events) * 1000.0 / result->median_ms;
+        }
+        if (result->virtual_time > 0) {
+            result->ms_per_sim_second = result->median_ms * 1000000.0 / ((double)result->virtual_time);
+        }
+    }
+    if (times != NULL) {
+        free(times);
+    }
+    release_spec_data(&model);
+    result->ret = ret;
+
+    return ret;
+}
+
+/* Parse a spec file, and benchmark each point of the sweep if any.
+ * A spec that cannot be parsed is reported as a single failed result.
+ */
+static int pico_sim_bench_spec(char const* spec_file_name, int nb_warmup, int nb_runs,
+    pico_sim_bench_result_t** results, size_t* nb_results, size_t* nb_results_max, FILE* log_F)
+{
+    int ret = 0;
+    pico_sim_spec_t base = { 0 };
+    pico_sim_sweep_t sweep = { 0 };
+    char base_name[256];
+    int is_parsed = 0;
+    size_t nb_points = 1;
+    FILE* F = NULL;
+
+    pico_sim_base_name(base_name, sizeof(base_name), spec_file_name);
+    if ((F = picoquic_file_open(spec_file_name, "r")) == NULL) {
+        fprintf(stderr, "Cannot open file <%s>\n", spec_file_name);
+    }
+    else {
+        if (parse_spec_file_sweep(&base, &sweep, F) != 0) {
+            fprintf(stderr, "Error when processing file <%s>\n", spec_file_name);
+            release_spec_data(&base);
+        }
+        else {
+            is_parsed = 1;
+            nb_points = pico_sim_sweep_nb_points(&sweep);
+        }
+        F = picoquic_file_close(F);
+    }
+
+    for (size_t point = 0; ret == 0 && point < nb_points; point++) {
+        pico_sim_bench_result_t* result;
+
+        if (*nb_results >= *nb_results_max) {
+            size_t new_max = (*nb_results_max == 0) ? 16 : 2 * *nb_results_max;
+            pico_sim_bench_result_t* new_results = (pico_sim_bench_result_t*)realloc(*results,
+                new_max * sizeof(pico_sim_bench_result_t));
+            if (new_results == NULL) {
+                ret = -1;
+                break;
+            }
+            *results = new_results;
+            *nb_results_max = new_max;
+        }
+        result = &(*results)[(*nb_results)++];
+        memset(result, 0, sizeof(pico_sim_bench_result_t));
+        pico_sim_sweep_point_name(result->name, sizeof(result->name), base_name, &sweep, point);
+        if (!is_parsed) {
+            result->ret = -1;
+        }
+        else {
+            (void)pico_sim_bench_point(&base, &sweep, point, nb_warmup, nb_runs, result, log_F);
+        }
+        if (result->ret != 0) {
+            printf("%-24s failed, see %s\n", result->name, PICO_SIM_BENCH_LOG);
+        }
+        else {
+            printf("%-24s %6d %6zu %12.3f %12.3f %14.0f %12.3f\n", result->name, result->nb_connections,
+                result->nb_runs, result->median_ms, result->stddev_ms, result->events_per_second,
+                result->ms_per_sim_second);
+        }
+        fflush(stdout);
+    }
+
+    if (is_parsed) {
+        release_spec_data(&base);
+        pico_sim_sweep_release(&sweep);
+    }
+    return ret;
+}
+
+static int pico_sim_bench_write(char const* output_name, pico_sim_bench_result_t const* results, size_t nb_results,
+    int nb_runs, int nb_warmup)
+{
+    int ret = 0;
+    FILE* F;
+
+    if ((F = picoquic_file_open(output_name, "w")) == NULL) {
+        fprintf(stderr, "Cannot create <%s>\n", output_name);
+        ret = -1;
+    }
+    else {
+        int is_first = 1;
+
+        fprintf(F, "{ \"nb_runs\": %d, \"nb_warmup\": %d,\n  \"scenarios\": [", nb_runs, nb_warmup);
+        for (size_t i = 0; i < nb_results; i++) {
+            pico_sim_bench_result_t const* r = &results[i];
+            if (r->ret == 0) {
+                fprintf(F, "%s\n    { \"name\": \"%s\", \"median_ms\": %.3f, \"stddev_ms\": %.3f, ",
+                    (is_first) ? "" : ",", r->name, r->median_ms, r->stddev_ms);
+                fprintf(F, "\"nb_events\": %llu, \"events_per_second\": %.1f, ",
+                    (unsigned long long)r->nb_events, r->events_per_second);
+                fprintf(F, "\"nb_connections\": %d, \"virtual_time_ms\": %.3f, \"ms_per_sim_second\": %.3f, ",
+                    r->nb_connections, ((double)r->virtual_time) / 1000.0, r->ms_per_sim_second);
+                fprintf(F, "\"peak_memory_bytes\": %llu, \"memory_growth_bytes\": %lld }",
+                    (unsigned long long)r->peak_memory, (long long)r->memory_growth);
+                is_first = 0;
+            }
+        }
+        fprintf(F, "]\n}\n");
+        (void)picoquic_file_close(F);
+    }
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    int ret = 0;
+    char const* source_dir = PICOQUIC_DIR;
+    char const* output_name = PICO_SIM_BENCH_OUTPUT;
+    char const* baseline_name = NULL;
+    char const* default_specs = PICO_SIM_BENCH_SPECS;
+    char const** spec_names;
+    int nb_spec_names;
+    char const* option_string = "S:n:w:o:B:t:h";
+    int nb_runs = 5;
+    int nb_warmup = 1;
+    double threshold = 10.0;
+    char** files = NULL;
+    size_t nb_files = 0;
+    size_t nb_files_max = 0;
+    pico_sim_bench_result_t* results = NULL;
+    size_t nb_results = 0;
+    size_t nb_results_max = 0;
+    int nb_failed = 0;
+    int nb_regressions = 0;
+    FILE* log_F = NULL;
+    int opt;
+
+    picoquic_register_all_congestion_control_algorithms();
+
+    while ((opt = getopt(argc, argv, option_string)) != -1) {
+        switch (opt) {
+        case 'S':
+            source_dir = optarg;
+            break;
+        case 'n':
+            if ((nb_runs = atoi(optarg)) <= 0 || nb_runs > PICO_SIM_BENCH_RUNS_MAX) {
+                fprintf(stderr, "Invalid number of runs: %s\n", optarg);
+                usage();
+                exit(-1);
+            }
+            break;
+        case 'w':
+            if ((nb_warmup = atoi(optarg)) < 0) {
+                fprintf(stderr, "Invalid number of warm-up runs: %s\n", optarg);
+                usage();
+                exit(-1);
+            }
+            break;
+        case 'o':
+            output_name = optarg;
+            break;
+        case 'B':
+            baseline_name = optarg;
+            break;
+        case 't':
+            if (parse_double(&threshold, optarg) != 0 || threshold < 0) {
+                fprintf(stderr, "Invalid threshold: %s\n", optarg);
+                usage();
+                exit(-1);
+            }
+            break;
+        case 'h':
+            usage();
+            exit(0);
+        default:
+            usage();
+            exit(-1);
+        }
+    }
+    picoquic_set_solution_dir(source_dir);
+    if (pico_sim_check_solution_dir(source_dir, stderr) != 0) {
+        exit(-1);
+    }
+
+    if (optind < argc) {
+        spec_names = (char const**)&argv[optind];
+        nb_spec_names = argc - optind;
+    }
+    else {
+        spec_names = &default_specs;
+        nb_spec_names = 1;
+    }
+
+    /* List the spec files */
+    for (int i = 0; ret == 0 && i < nb_spec_names; i++) {
+        char** names = NULL;
+        size_t nb_names = 0;
+
+        if (pico_sim_is_directory(spec_names[i])) {
+            ret = pico_sim_list_files(spec_names[i], ".txt", &names, &nb_names);
+        }
+        else if ((names = (char**)malloc(sizeof(char*))) == NULL ||
+            (names[0] = (char*)malloc(strlen(spec_names[i]) + 1)) == NULL) {
+            ret = -1;
+        }
+        else {
+            memcpy(names[0], spec_names[i], strlen(spec_names[i]) + 1);
+            nb_names = 1;
+        }
+        if (ret == 0 && nb_files + nb_names > nb_files_max) {
+            char** new_files = (char**)realloc(files, sizeof(char*) * (nb_files + nb_names));
+            if (new_files == NULL) {
+                ret = -1;
+            }
+            else {
+                files = new_files;
+                nb_files_max = nb_files + nb_names;
+            }
+        }
+        if (ret == 0) {
+            memcpy(files + nb_files, names, sizeof(char*) * nb_names);
+            nb_files += nb_names;
+            free(names);
+        }
+        else {
+            pico_sim_free_file_list(names, nb_names);
+        }
+    }
+
+    if (ret == 0 && nb_files == 0) {
+        fprintf(stderr, "No simulation specification found.\n");
+        ret = -1;
+    }
+    else if (ret == 0 && (log_F = picoquic_file_open(PICO_SIM_BENCH_LOG, "w")) == NULL) {
+        fprintf(stderr, "Cannot create <%s>\n", PICO_SIM_BENCH_LOG);
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        printf("%-24s %6s %6s %12s %12s %14s %12s\n", "scenario", "cnx", "runs", "median_ms", "stddev_ms",
+            "events/s", "ms/sim_s");
+        for (size_t i = 0; ret == 0 && i < nb_files; i++) {
+            ret = pico_sim_bench_spec(files[i], nb_warmup, nb_runs, &results, &nb_results, &nb_results_max, log_F);
+        }
+        for (size_t i = 0; i < nb_results; i++) {
+            if (results[i].ret != 0) {
+                nb_failed++;
+            }
+        }
+    }
+
+    if (ret == 0 && baseline_name != NULL) {
+        ret = pico_sim_bench_load_baseline(baseline_name, results, nb_results);
+        for (size_t i = 0; ret == 0 && i < nb_results; i++) {
+            pico_sim_bench_result_t* r = &results[i];
+            if (r->ret != 0) {
+                continue;
+            }
+            if (!r->has_baseline) {
+                printf("%s: no baseline\n", r->name);
+            }
+            else {
+                double change = (r->baseline_ms > 0) ? 100.0 * (r->median_ms - r->baseline_ms) / r->baseline_ms : 0;
+                r->is_regression = (change > threshold);
+                printf("%s: %.3f ms, baseline %.3f ms, %+.1f%%%s\n", r->name, r->median_ms, r->baseline_ms,
+                    change, (r->is_regression) ? ", REGRESSION" : "");
+                if (r->is_regression) {
+                    nb_regressions++;
+                }
+            }
+        }
+    }
+
+    /* Written after loading the baseline, which can be the previous output */
+    if (ret == 0) {
+        ret = pico_sim_bench_write(output_name, results, nb_results, nb_runs, nb_warmup);
+    }
+
+    fflush(stdout);
+    if (ret == 0 && (nb_failed > 0 || nb_regressions > 0)) {
+        fprintf(stderr, "Benchmark: %d failed, %d regressions above %.1f%%.\n", nb_failed, nb_regressions, threshold);
+        ret = -1;
+    }
+
+    if (log_F != NULL) {
+        (void)picoquic_file_close(log_F);
+    }
+    if (results != NULL) {
+        free(results);
+    }
+    pico_sim_free_file_list(files, nb_files);
+
+    return ret;
+}
@@ -0,0 +1,385 @@
+/* Time binned metrics.
+* The plotting scripts rebuild the congestion control state from every
+* "metrics_updated" event of the qlogs, only to draw it at a resolution
+* of a few hundred pixels. With "metrics_bin_interval: <us>" in the spec,
+* the qlogs are reduced after the run to fixed intervals of virtual time:
+* for each connection, path and interval, the min, max, last and mean of
+* cwnd, bytes_in_flight, pacing_rate, smoothed_rtt, min_rtt, latest_rtt
+* and queue delay (latest RTT minus min RTT), the number of samples and of
+* app limited samples, and the stream data bytes sent or received.
+* The link queue itself is not visible in the qlogs, so the queue depth
+* is given as the queue delay seen by the connection.
+*
+* The bins of all the connections are written in one columnar file,
+* "<name>_bins.bin", read by load_bins() in scripts/pico_sim_trace.py.
+* All integers are little endian. The file starts with a 40 bytes header:
+*   0  magic, "PSIMBIN" and a null byte
+*   8  u32 version, 1
+*   12 u32 number of columns
+*   16 u64 number of rows
+*   24 u64 bin interval, in microseconds
+*   32 u32 number of connections
+*   36 u32 size of the connection names
+* followed by the names of the qlogs of the connections, separated by
+* new lines and padded with zeros to a multiple of 8 bytes, then by each
+* column, as an array of u64. Only the bins with events are written; the
+* state of a connection does not change between two rows.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "picoquic.h"
+#include "picoquic_utils.h"
+#include "pico_sim.h"
+#include "pico_sim_qlog.h"
+
+#define PICO_SIM_BINS_MAGIC "PSIMBIN"
+#define PICO_SIM_BINS_VERSION 1
+#define PICO_SIM_BINS_HEADER_SIZE 40
+#define PICO_SIM_BINS_PATH_MAX 256
+
+/* Columns of the file, in order. Each state field has four columns */
+typedef enum {
+    pico_sim_bins_time = 0,
+    pico_sim_bins_connection,
+    pico_sim_bins_path,
+    pico_sim_bins_nb_samples,
+    pico_sim_bins_app_limited,
+    pico_sim_bins_data_bytes,
+    pico_sim_bins_fields
+} pico_sim_bins_column_enum;
+
+typedef enum {
+    pico_sim_bins_cwnd = 0,
+    pico_sim_bins_bytes_in_flight,
+    pico_sim_bins_pacing_rate,
+    pico_sim_bins_smoothed_rtt,
+    pico_sim_bins_min_rtt,
+    pico_sim_bins_latest_rtt,
+    pico_sim_bins_queue_delay,
+    pico_sim_bins_nb_fields
+} pico_sim_bins_field_enum;
+
+#define PICO_SIM_BINS_COLUMNS (pico_sim_bins_fields + 4 * pico_sim_bins_nb_fields)
+
+typedef struct st_pico_sim_bins_field_t {
+    uint64_t min;
+    uint64_t max;
+    uint64_t last;
+    uint64_t sum;
+} pico_sim_bins_field_t;
+
+typedef struct st_pico_sim_bins_bin_t {
+    int is_open;
+    uint64_t bin_index;
+    uint64_t nb_samples;
+    uint64_t app_limited;
+    uint64_t data_bytes;
+    pico_sim_bins_field_t fields[pico_sim_bins_nb_fields];
+} pico_sim_bins_bin_t;
+
+typedef struct st_pico_sim_bins_ctx_t {
+    uint64_t bin_interval;
+    uint64_t connection;
+    pico_sim_cc_state_t cc_state[PICO_SIM_BINS_PATH_MAX];
+    int has_state[PICO_SIM_BINS_PATH_MAX];
+    pico_sim_bins_bin_t bins[PICO_SIM_BINS_PATH_MAX];
+    uint64_t* rows;
+    size_t nb_rows;
+    size_t nb_rows_max;
+} pico_sim_bins_ctx_t;
+
+static void pico_sim_bins_values(pico_sim_cc_state_t const* cc_state, uint64_t* values)
+{
+    values[pico_sim_bins_cwnd] = cc_state->cwnd;
+    values[pico_sim_bins_bytes_in_flight] = cc_state->bytes_in_flight;
+    values[pico_sim_bins_pacing_rate] = cc_state->pacing_rate;
+    values[pico_sim_bins_smoothed_rtt] = cc_state->smoothed_rtt;
+    values[pico_sim_bins_min_rtt] = cc_state->min_rtt;
+    values[pico_sim_bins_latest_rtt] = cc_state->latest_rtt;
+    values[pico_sim_bins_queue_delay] = (cc_state->latest_rtt > cc_state->min_rtt) ?
+        cc_state->latest_rtt - cc_state->min_rtt : 0;
+}
+
+/* Write the row of a bin, and close it */
+static int pico_sim_bins_flush(pico_sim_bins_ctx_t* ctx, pico_sim_bins_bin_t* bin, uint64_t path_id)
+{
+    int ret = 0;
+
+    if (ctx->nb_rows >= ctx->nb_rows_max) {
+        size_t new_max = (ctx->nb_rows_max == 0) ? 1024 : 2 * ctx->nb_rows_max;
+        uint64_t* new_rows = (uint64_t*)realloc(ctx->rows, new_max * PICO_SIM_BINS_COLUMNS * sizeof(uint64_t));
+
+        if (new_rows == NULL) {
+            ret = -1;
+        }
+        else {
+            ctx->rows = new_rows;
+            ctx->nb_rows_max = new_max;
+        }
+    }
+    if (ret == 0) {
+        uint64_t* row = ctx->rows + ctx->nb_rows * PICO_SIM_BINS_COLUMNS;
+
+        row[pico_sim_bins_time] = bin->bin_index * ctx->bin_interval;
+        row[pico_sim_bins_connection] = ctx->connection;
+        row[pico_sim_bins_path] = path_id;
+        row[pico_sim_bins_nb_samples] = bin->nb_samples;
+        row[pico_sim_bins_app_limited] = bin->app_limited;
+        row[pico_sim_bins_data_bytes] = bin->data_bytes;
+        for (int i = 0; i < pico_sim_bins_nb_fields; i++) {
+            pico_sim_bins_field_t const* f = &bin->fields[i];
+            uint64_t* x = row + pico_sim_bins_fields + 4 * i;
+
+            x[0] = (f->min == UINT64_MAX) ? 0 : f->min;
+            x[1] = f->max;
+            x[2] = f->last;
+            x[3] = (bin->nb_samples > 0) ? (f->sum + bin->nb_samples / 2) / bin->nb_samples : f->last;
+        }
+        ctx->nb_rows++;
+    }
+    bin->is_open = 0;
+    return ret;
+}
+
+/* Bin of the path at the time of the event, opened with the current state
+ * if there was already a metrics update on the path */
+static int pico_sim_bins_get(pico_sim_bins_ctx_t* ctx, uint64_t path_id, uint64_t event_time, pico_sim_bins_bin_t** bin)
+{
+    int ret = 0;
+    pico_sim_bins_bin_t* b = &ctx->bins[path_id];
+    uint64_t bin_index = event_time / ctx->bin_interval;
+
+    if (b->is_open && b->bin_index != bin_index) {
+        ret = pico_sim_bins_flush(ctx, b, path_id);
+    }
+    if (ret == 0 && !b->is_open) {
+        uint64_t values[pico_sim_bins_nb_fields];
+
+        pico_sim_bins_values(&ctx->cc_state[path_id], values);
+        memset(b, 0, sizeof(pico_sim_bins_bin_t));
+        b->is_open = 1;
+        b->bin_index = bin_index;
+        for (int i = 0; i < pico_sim_bins_nb_fields; i++) {
+            b->fields[i].min = (ctx->has_state[path_id]) ? values[i] : UINT64_MAX;
+            b->fields[i].max = (ctx->has_state[path_id]) ? values[i] : 0;
+            b->fields[i].last = (ctx->has_state[path_id]) ? values[i] : 0;
+        }
+    }
+    *bin = b;
+    return ret;
+}
+
+static int pico_sim_bins_frame_member(void* ctx, char const* name, size_t name_len, char const* value, size_t value_len)
+{
+    uint64_t* length = (uint64_t*)ctx;
+
+    if (pico_sim_qlog_is(name, name_len, "frame_type") && !pico_sim_qlog_is(value, value_len, "\"stream\"")) {
+        *length = UINT64_MAX;
+    }
+    else if (pico_sim_qlog_is(name, name_len, "length") && *length != UINT64_MAX) {
+        *length = pico_sim_qlog_u64(value, value_len);
+    }
+    return 0;
+}
+
+static int pico_sim_bins_frame(void* ctx, char const* value, size_t value_len)
+{
+    int ret = 0;
+    uint64_t length = 0;
+
+    if (value_len > 0 && value[0] == '{') {
+        ret = pico_sim_qlog_members(value, value_len, pico_sim_bins_frame_member, &length);
+    }
+    if (ret == 0 && length != UINT64_MAX) {
+        *(uint64_t*)ctx += length;
+    }
+    return ret;
+}
+
+static int pico_sim_bins_packet_member(void* ctx, char const* name, size_t name_len, char const* value, size_t value_len)
+{
+    int ret = 0;
+
+    if (pico_sim_qlog_is(name, name_len, "frames")) {
+        ret = pico_sim_qlog_elements(value, value_len, pico_sim_bins_frame, ctx);
+    }
+    return ret;
+}
+
+static int pico_sim_bins_event(void* ctx, pico_sim_qlog_event_t const* ev)
+{
+    int ret = 0;
+    pico_sim_bins_ctx_t* bins_ctx = (pico_sim_bins_ctx_t*)ctx;
+    uint64_t path_id = (ev->path_id < PICO_SIM_BINS_PATH_MAX) ? ev->path_id : PICO_SIM_BINS_PATH_MAX - 1;
+    pico_sim_cc_state_t* cc_state = &bins_ctx->cc_state[path_id];
+    pico_sim_bins_bin_t* bin = NULL;
+
+    if (pico_sim_qlog_is(ev->category, ev->category_len, "recovery") &&
+        pico_sim_qlog_is(ev->event, ev->event_len, "metrics_updated")) {
+        /* The bin is opened with the state before the update */
+        if ((ret = pico_sim_bins_get(bins_ctx, path_id, ev->event_time, &bin)) == 0 &&
+            pico_sim_cc_update(cc_state, ev)) {
+            uint64_t values[pico_sim_bins_nb_fields];
+
+            bins_ctx->has_state[path_id] = 1;
+            pico_sim_bins_values(cc_state, values);
+            for (int i = 0; i < pico_sim_bins_nb_fields; i++) {
+                pico_sim_bins_field_t* f = &bin->fields[i];
+
+                f->min = (values[i] < f->min) ? values[i] : f->min;
+                f->max = (values[i] > f->max) ? values[i] : f->max;
+                f->last = values[i];
+                f->sum += values[i];
+            }
+            bin->nb_samples++;
+            bin->app_limited += (cc_state->app_limited) ? 1 : 0;
+        }
+    }
+    else if (pico_sim_qlog_is(ev->category, ev->category_len, "transport") && ev->data != NULL &&
+        (pico_sim_qlog_is(ev->event, ev->event_len, "packet_sent") ||
+            pico_sim_qlog_is(ev->event, ev->event_len, "packet_received"))) {
+        uint64_t data_bytes = 0;
+
+        if ((ret = pico_sim_qlog_members(ev->data, ev->data_len, pico_sim_bins_packet_member, &data_bytes)) == 0 &&
+            data_bytes > 0 && (ret = pico_sim_bins_get(bins_ctx, path_id, ev->event_time, &bin)) == 0) {
+            bin->data_bytes += data_bytes;
+        }
+    }
+    return ret;
+}
+
+static char const* pico_sim_bins_base_name(char const* file_name)
+{
+    char const* base = file_name;
+
+    for (char const* x = file_name; *x != 0; x++) {
+        if (*x == '/' || *x == '\\') {
+            base = x + 1;
+        }
+    }
+    return base;
+}
+
+static int pico_sim_bins_write_u64(FILE* F, uint64_t v, size_t len)
+{
+    uint8_t bytes[8];
+
+    for (size_t i = 0; i < len; i++) {
+        bytes[i] = (uint8_t)(v & 0xff);
+        v >>= 8;
+    }
+    return (fwrite(bytes, 1, len, F) == len) ? 0 : -1;
+}
+
+static int pico_sim_bins_write(pico_sim_bins_ctx_t const* ctx, char** qlog_names, size_t nb_connections,
+    char const* bins_name)
+{
+    int ret = 0;
+    size_t names_size = 0;
+    FILE* F;
+
+    for (size_t i = 0; i < nb_connections; i++) {
+        names_size += strlen(pico_sim_bins_base_name(qlog_names[i])) + 1;
+    }
+    names_size = (names_size + 7) & ~((size_t)7);
+
+    if ((F = picoquic_file_open(bins_name, "wb")) == NULL) {
+        ret = -1;
+    }
+    else {
+        size_t written = 0;
+
+        ret |= (fwrite(PICO_SIM_BINS_MAGIC, 1, 8, F) == 8) ? 0 : -1;
+        ret |= pico_sim_bins_write_u64(F, PICO_SIM_BINS_VERSION, 4);
+        ret |= pico_sim_bins_write_u64(F, PICO_SIM_BINS_COLUMNS, 4);
+        ret |= pico_sim_bins_write_u64(F, ctx->nb_rows, 8);
+        ret |= pico_sim_bins_write_u64(F, ctx->bin_interval, 8);
+        ret |= pico_sim_bins_write_u64(F, nb_connections, 4);
+        ret |= pico_sim_bins_write_u64(F, names_size, 4);
+        for (size_t i = 0; ret == 0 && i < nb_connections; i++) {
+            char const* base = pico_sim_bins_base_name(qlog_names[i]);
+
+            ret |= (fputs(base, F) >= 0 && fputc('\n', F) != EOF) ? 0 : -1;
+            written += strlen(base) + 1;
+        }
+        while (ret == 0 && written < names_size) {
+            ret = (fputc(0, F) != EOF) ? 0 : -1;
+            written++;
+        }
+        for (size_t c = 0; ret == 0 && c < PICO_SIM_BINS_COLUMNS; c++) {
+            for (size_t r = 0; ret == 0 && r < ctx->nb_rows; r++) {
+                ret = pico_sim_bins_write_u64(F, ctx->rows[r * PICO_SIM_BINS_COLUMNS + c], 8);
+            }
+        }
+        (void)picoquic_file_close(F);
+    }
+    return ret;
+}
+
+int pico_sim_bins(pico_sim_run_files_t const* run_files, uint64_t bin_interval, char const* name, FILE* err_fd)
+{
+    int ret = 0;
+    char** names = NULL;
+    size_t nb_names = 0;
+    size_t nb_connections = 0;
+    char bins_name[512];
+    pico_sim_bins_ctx_t* ctx = NULL;
+
+    (void)snprintf(bins_name, sizeof(bins_name), "%s_bins.bin", name);
+
+    /* As for the summary, only the server traces if there are any */
+    if ((ret = pico_sim_list_run_qlogs(run_files, ".server.qlog", &names, &nb_names)) == 0 && nb_names == 0) {
+        pico_sim_free_file_list(names, nb_names);
+        names = NULL;
+        ret = pico_sim_list_run_qlogs(run_files, ".qlog", &names, &nb_names);
+    }
+    if (ret != 0) {
+        fprintf(err_fd, "Cannot list the qlogs of the run\n");
+    }
+    else if ((ctx = (pico_sim_bins_ctx_t*)calloc(1, sizeof(pico_sim_bins_ctx_t))) == NULL) {
+        ret = -1;
+    }
+
+    for (size_t i = 0; ret == 0 && i < nb_names; i++) {
+        memset(ctx->cc_state, 0, sizeof(ctx->cc_state));
+        memset(ctx->has_state, 0, sizeof(ctx->has_state));
+        memset(ctx->bins, 0, sizeof(ctx->bins));
+        ctx->bin_interval = bin_interval;
+        ctx->connection = nb_connections;
+        if (pico_sim_qlog_scan(names[i], pico_sim_bins_event, ctx) != 0) {
+            fprintf(err_fd, "Cannot parse qlog <%s>\n", names[i]);
+            ret = -1;
+        }
+        for (uint64_t p = 0; ret == 0 && p < PICO_SIM_BINS_PATH_MAX; p++) {
+            if (ctx->bins[p].is_open) {
+                ret = pico_sim_bins_flush(ctx, &ctx->bins[p], p);
+            }
+        }
+        if (ret == 0) {
+            nb_connections++;
+        }
+    }
+
+    if (ret == 0) {
+        if (pico_sim_bins_write(ctx, names, nb_connections, bins_name) != 0) {
+            fprintf(err_fd, "Cannot write <%s>\n", bins_name);
+            ret = -1;
+        }
+        else {
+            fprintf(err_fd, "%zu bins of %zu connections written to <%s>\n", ctx->nb_rows, nb_connections, bins_name);
+        }
+    }
+
+    if (ctx != NULL) {
+        if (ctx->rows != NULL) {
+            free(ctx->rows);
+        }
+        free(ctx);
+    }
+    pico_sim_free_file_list(names, nb_names);
+
+    return ret;
+}
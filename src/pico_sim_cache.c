@@ -0,0 +1,508 @@
+/* Cache of simulation results.
+* The simulations are deterministic: the same spec, simulated by the same
+* build of picoquic, always produces the same outputs. The result of a
+* run is cached under a key computed from a normalized text of the parsed
+* spec, including the expanded link segments and the pico_sim options
+* that change the outputs, and from a hash of the pico_sim executable,
+* in which picoquic is statically linked. When the cache has an entry for
+* the key, the outputs of the run are copied from the cache instead of
+* running the simulation.
+*
+* The entries are flat files in the cache directory, all starting with
+* the key: "<key>.qlog.<file>" for the files produced by the run in the
+* qlog directory, "<key>.qperf" for the qperf log, "<key>.summary" for the
+* summary, "<key>.bins" for the time binned metrics, and "<key>.spec" for
+* the normalized spec, which is written last and is compared with the
+* spec of the run before using the entry. The file
+* "<key>.used" is rewritten each time the entry is used, so that the
+* entries that are not used can be pruned.
+ */
+
+#if !defined(_WINDOWS) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WINDOWS
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "picoquic.h"
+#include "picoquic_ns.h"
+#include "picoquic_utils.h"
+#include "pico_sim.h"
+
+#define PICO_SIM_CACHE_FNV_OFFSET 0xcbf29ce484222325ull
+#define PICO_SIM_CACHE_FNV_PRIME 0x100000001b3ull
+#define PICO_SIM_CACHE_QLOG_PREFIX ".qlog."
+
+static uint64_t pico_sim_cache_fnv(uint64_t h, uint8_t const* bytes, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        h ^= bytes[i];
+        h *= PICO_SIM_CACHE_FNV_PRIME;
+    }
+    return h;
+}
+
+/* Identify the build by hashing the executable, or by the picoquic version
+ * and the build time if the executable cannot be read. */
+static uint64_t pico_sim_cache_build_id(void)
+{
+    uint64_t h = pico_sim_cache_fnv(PICO_SIM_CACHE_FNV_OFFSET, (uint8_t const*)PICOQUIC_VERSION, strlen(PICOQUIC_VERSION));
+    FILE* F = NULL;
+#ifdef _WINDOWS
+    char path[1024];
+    DWORD l = GetModuleFileNameA(NULL, path, (DWORD)sizeof(path));
+
+    if (l > 0 && l < sizeof(path)) {
+        F = picoquic_file_open(path, "rb");
+    }
+#elif defined(__linux__)
+    F = picoquic_file_open("/proc/self/exe", "rb");
+#endif
+
+    if (F != NULL) {
+        uint8_t buffer[4096];
+        size_t nb_read;
+
+        while ((nb_read = fread(buffer, 1, sizeof(buffer), F)) > 0) {
+            h = pico_sim_cache_fnv(h, buffer, nb_read);
+        }
+        (void)picoquic_file_close(F);
+    }
+    else {
+        char const* build_time = __DATE__ " " __TIME__;
+        h = pico_sim_cache_fnv(h, (uint8_t const*)build_time, strlen(build_time));
+    }
+    return h;
+}
+
+static int pico_sim_cache_printf(pico_sim_cache_entry_t* entry, char const* fmt, ...)
+{
+    int ret = 0;
+    va_list args;
+    int l;
+
+    va_start(args, fmt);
+    l = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+    if (l < 0) {
+        ret = -1;
+    }
+    else if (entry->spec_text_len + (size_t)l + 1 > entry->spec_text_max) {
+        size_t new_max = 2 * (entry->spec_text_max + (size_t)l + 1);
+        char* new_text = (char*)realloc(entry->spec_text, new_max);
+        if (new_text == NULL) {
+            ret = -1;
+        }
+        else {
+            entry->spec_text = new_text;
+            entry->spec_text_max = new_max;
+        }
+    }
+    if (ret == 0) {
+        va_start(args, fmt);
+        (void)vsnprintf(entry->spec_text + entry->spec_text_len, (size_t)l + 1, fmt, args);
+        va_end(args);
+        entry->spec_text_len += (size_t)l;
+    }
+    return ret;
+}
+
+static char const* pico_sim_cache_text(char const* text)
+{
+    return (text == NULL) ? "" : text;
+}
+
+static char const* pico_sim_cache_cc(picoquic_congestion_algorithm_t const* cc_algo)
+{
+    return (cc_algo == NULL) ? "" : cc_algo->congestion_algorithm_id;
+}
+
+/* One line per field of the spec. File names are replaced by their
+ * presence, since the outputs are copied to the names of the spec. */
+static int pico_sim_cache_spec_text(pico_sim_cache_entry_t* entry, pico_sim_spec_t const* sim_spec)
+{
+    int ret = 0;
+    picoquic_ns_spec_t const* spec = &sim_spec->ns;
+
+    ret |= pico_sim_cache_printf(entry, "build: %016llx\n", (unsigned long long)pico_sim_cache_build_id());
+    ret |= pico_sim_cache_printf(entry, "main_start_time: %llu\n", (unsigned long long)spec->main_start_time);
+    ret |= pico_sim_cache_printf(entry, "main_target_time: %llu\n", (unsigned long long)spec->main_target_time);
+    ret |= pico_sim_cache_printf(entry, "background_start_time: %llu\n", (unsigned long long)spec->background_start_time);
+    ret |= pico_sim_cache_printf(entry, "main_scenario_text: %s\n", pico_sim_cache_text(spec->main_scenario_text));
+    ret |= pico_sim_cache_printf(entry, "background_scenario_text: %s\n", pico_sim_cache_text(spec->background_scenario_text));
+    ret |= pico_sim_cache_printf(entry, "main_cc_algo: %s\n", pico_sim_cache_cc(spec->main_cc_algo));
+    ret |= pico_sim_cache_printf(entry, "main_cc_options: %s\n", pico_sim_cache_text(spec->main_cc_options));
+    ret |= pico_sim_cache_printf(entry, "background_cc_algo: %s\n", pico_sim_cache_cc(spec->background_cc_algo));
+    ret |= pico_sim_cache_printf(entry, "background_cc_options: %s\n", pico_sim_cache_text(spec->background_cc_options));
+    ret |= pico_sim_cache_printf(entry, "nb_connections: %d\n", spec->nb_connections);
+    ret |= pico_sim_cache_printf(entry, "data_rate_in_gbps: %.17g\n", spec->data_rate_in_gbps);
+    ret |= pico_sim_cache_printf(entry, "latency: %llu\n", (unsigned long long)spec->latency);
+    ret |= pico_sim_cache_printf(entry, "jitter: %llu\n", (unsigned long long)spec->jitter);
+    ret |= pico_sim_cache_printf(entry, "queue_delay_max: %llu\n", (unsigned long long)spec->queue_delay_max);
+    ret |= pico_sim_cache_printf(entry, "l4s_max: %llu\n", (unsigned long long)spec->l4s_max);
+    ret |= pico_sim_cache_printf(entry, "icid: ");
+    for (uint8_t i = 0; i < spec->icid.id_len; i++) {
+        ret |= pico_sim_cache_printf(entry, "%02x", spec->icid.id[i]);
+    }
+    ret |= pico_sim_cache_printf(entry, "\nqlog_dir: %s\n", (spec->qlog_dir == NULL) ? "no" : "yes");
+    ret |= pico_sim_cache_printf(entry, "link_scenario: %d\n", (int)spec->link_scenario);
+    for (size_t i = 0; spec->link_scenario == link_scenario_none && i < spec->vary_link_nb; i++) {
+        picoquic_ns_link_spec_t const* l = &spec->vary_link_spec[i];
+        ret |= pico_sim_cache_printf(entry, "link: %llu:U%.17g:D%.17g:L%llu:J%llu:Q%llu:S%llu:B%llu:P%llu\n",
+            (unsigned long long)l->duration, l->data_rate_in_gbps_up, l->data_rate_in_gbps_down,
+            (unsigned long long)l->latency, (unsigned long long)l->jitter, (unsigned long long)l->queue_delay_max,
+            (unsigned long long)l->l4s_max, (unsigned long long)l->nb_loss_in_burst,
+            (unsigned long long)l->packets_between_losses);
+    }
+    ret |= pico_sim_cache_printf(entry, "qperf_log: %s\n", (spec->qperf_log == NULL) ? "no" : "yes");
+    ret |= pico_sim_cache_printf(entry, "media_stats_start: %llu\n", (unsigned long long)spec->media_stats_start);
+    ret |= pico_sim_cache_printf(entry, "media_excluded: %s\n", pico_sim_cache_text(spec->media_excluded));
+    ret |= pico_sim_cache_printf(entry, "media_latency_average: %llu\n", (unsigned long long)spec->media_latency_average);
+    ret |= pico_sim_cache_printf(entry, "media_latency_max: %llu\n", (unsigned long long)spec->media_latency_max);
+    ret |= pico_sim_cache_printf(entry, "seed_cwin: %llu\n", (unsigned long long)spec->seed_cwin);
+    ret |= pico_sim_cache_printf(entry, "seed_rtt: %llu\n", (unsigned long long)spec->seed_rtt);
+    ret |= pico_sim_cache_printf(entry, "trace_format: %d\n", (int)sim_spec->trace_format);
+    ret |= pico_sim_cache_printf(entry, "summary: %d\n", (int)sim_spec->summary_format);
+    ret |= pico_sim_cache_printf(entry, "qlog_level: %s\n", pico_sim_cache_text(sim_spec->qlog_level));
+    ret |= pico_sim_cache_printf(entry, "qlog_sample_interval: %llu\n", (unsigned long long)sim_spec->qlog_sample_interval);
+    ret |= pico_sim_cache_printf(entry, "qlog_segment_time: %llu\n", (unsigned long long)sim_spec->qlog_segment_time);
+    ret |= pico_sim_cache_printf(entry, "qlog_segment_size: %llu\n", (unsigned long long)sim_spec->qlog_segment_size);
+    ret |= pico_sim_cache_printf(entry, "qlog_compress: %d\n", sim_spec->qlog_compress);
+    ret |= pico_sim_cache_printf(entry, "metrics_bin_interval: %llu\n", (unsigned long long)sim_spec->metrics_bin_interval);
+
+    return (ret == 0) ? 0 : -1;
+}
+
+static int pico_sim_cache_copy(char const* from_name, char const* to_name)
+{
+    int ret = 0;
+    FILE* from_F = NULL;
+    FILE* to_F = NULL;
+    char buffer[4096];
+    size_t nb_read;
+
+    if ((from_F = picoquic_file_open(from_name, "rb")) == NULL ||
+        (to_F = picoquic_file_open(to_name, "wb")) == NULL) {
+        ret = -1;
+    }
+    else {
+        while (ret == 0 && (nb_read = fread(buffer, 1, sizeof(buffer), from_F)) > 0) {
+            if (fwrite(buffer, 1, nb_read, to_F) != nb_read) {
+                ret = -1;
+            }
+        }
+    }
+    if (from_F != NULL) {
+        (void)picoquic_file_close(from_F);
+    }
+    if (to_F != NULL) {
+        (void)picoquic_file_close(to_F);
+    }
+    return ret;
+}
+
+/* Copy a file, or the text of the spec if from_name is NULL, to the cache
+ * through a temporary file, so that a concurrent run with the same key
+ * never reads a partial file. */
+static int pico_sim_cache_put(pico_sim_cache_entry_t const* entry, char const* from_name, char const* suffix)
+{
+    int ret = 0;
+    char cache_name[1024];
+    char tmp_name[1100];
+
+    (void)snprintf(cache_name, sizeof(cache_name), "%s%s%s%s", entry->cache_dir, PICO_SIM_PATH_SEP_STR, entry->key, suffix);
+#ifdef _WINDOWS
+    (void)snprintf(tmp_name, sizeof(tmp_name), "%s.tmp%lu", cache_name, (unsigned long)GetCurrentProcessId());
+#else
+    (void)snprintf(tmp_name, sizeof(tmp_name), "%s.tmp%lu", cache_name, (unsigned long)getpid());
+#endif
+    if (from_name != NULL) {
+        ret = pico_sim_cache_copy(from_name, tmp_name);
+    }
+    else {
+        FILE* F;
+
+        if ((F = picoquic_file_open(tmp_name, "wb")) == NULL) {
+            ret = -1;
+        }
+        else {
+            if (fwrite(entry->spec_text, 1, entry->spec_text_len, F) != entry->spec_text_len) {
+                ret = -1;
+            }
+            (void)picoquic_file_close(F);
+        }
+    }
+    if (ret != 0) {
+        (void)remove(tmp_name);
+    }
+    else {
+#ifdef _WINDOWS
+        (void)remove(cache_name);
+#endif
+        if (rename(tmp_name, cache_name) != 0) {
+            (void)remove(tmp_name);
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+static char const* pico_sim_cache_base_name(char const* path)
+{
+    char const* base = path;
+
+    for (char const* x = path; *x != 0; x++) {
+        if (*x == '/' || *x == '\\') {
+            base = x + 1;
+        }
+    }
+    return base;
+}
+
+static void pico_sim_cache_summary_name(char* summary_name, size_t summary_size, char const* name,
+    pico_sim_summary_format_enum summary_format)
+{
+    (void)snprintf(summary_name, summary_size, "%s_summary.%s", name,
+        (summary_format == pico_sim_summary_json) ? "json" : "csv");
+}
+
+static int pico_sim_cache_is_used_since(char const* file_name, int64_t since_time)
+{
+#ifdef _WINDOWS
+    struct _stat st;
+    return (_stat(file_name, &st) == 0 && (int64_t)st.st_mtime >= since_time);
+#else
+    struct stat st;
+    return (stat(file_name, &st) == 0 && (int64_t)st.st_mtime >= since_time);
+#endif
+}
+
+static void pico_sim_cache_touch(pico_sim_cache_entry_t const* entry)
+{
+    char used_name[1024];
+    FILE* F;
+
+    (void)snprintf(used_name, sizeof(used_name), "%s%s%s.used", entry->cache_dir, PICO_SIM_PATH_SEP_STR, entry->key);
+    if ((F = picoquic_file_open(used_name, "w")) != NULL) {
+        fprintf(F, "%lld\n", (long long)time(NULL));
+        (void)picoquic_file_close(F);
+    }
+}
+
+/* The entry is used only if its spec text is identical to that of the run */
+static int pico_sim_cache_is_hit(pico_sim_cache_entry_t const* entry)
+{
+    int is_hit = 0;
+    char spec_name[1024];
+    FILE* F;
+
+    (void)snprintf(spec_name, sizeof(spec_name), "%s%s%s.spec", entry->cache_dir, PICO_SIM_PATH_SEP_STR, entry->key);
+    if ((F = picoquic_file_open(spec_name, "rb")) != NULL) {
+        char* text = (char*)malloc(entry->spec_text_len + 1);
+
+        if (text != NULL) {
+            is_hit = (fread(text, 1, entry->spec_text_len + 1, F) == entry->spec_text_len &&
+                memcmp(text, entry->spec_text, entry->spec_text_len) == 0);
+            free(text);
+        }
+        (void)picoquic_file_close(F);
+    }
+    return is_hit;
+}
+
+static int pico_sim_cache_restore(pico_sim_cache_entry_t const* entry, pico_sim_spec_t const* spec,
+    char const* name, FILE* err_fd)
+{
+    int ret = 0;
+    char cache_name[1024];
+    char file_name[1024];
+
+    if (spec->ns.qlog_dir != NULL) {
+        char** names = NULL;
+        size_t nb_names = 0;
+        size_t prefix_len = strlen(entry->key) + strlen(PICO_SIM_CACHE_QLOG_PREFIX);
+
+        (void)snprintf(cache_name, sizeof(cache_name), "%s%s", entry->key, PICO_SIM_CACHE_QLOG_PREFIX);
+        if (pico_sim_mkdir(spec->ns.qlog_dir) != 0 || pico_sim_list_files(entry->cache_dir, "", &names, &nb_names) != 0) {
+            ret = -1;
+        }
+        for (size_t i = 0; ret == 0 && i < nb_names; i++) {
+            char const* base = pico_sim_cache_base_name(names[i]);
+
+            if (strncmp(base, cache_name, prefix_len) == 0 && strstr(base + prefix_len, ".tmp") == NULL) {
+                (void)snprintf(file_name, sizeof(file_name), "%s%s%s", spec->ns.qlog_dir, PICO_SIM_PATH_SEP_STR, base + prefix_len);
+                if ((ret = pico_sim_cache_copy(names[i], file_name)) != 0) {
+                    fprintf(err_fd, "Cannot restore <%s> from the cache\n", file_name);
+                }
+            }
+        }
+        pico_sim_free_file_list(names, nb_names);
+    }
+    if (ret == 0 && spec->ns.qperf_log != NULL) {
+        (void)snprintf(cache_name, sizeof(cache_name), "%s%s%s.qperf", entry->cache_dir, PICO_SIM_PATH_SEP_STR, entry->key);
+        if ((ret = pico_sim_cache_copy(cache_name, spec->ns.qperf_log)) != 0) {
+            fprintf(err_fd, "Cannot restore <%s> from the cache\n", spec->ns.qperf_log);
+        }
+    }
+    if (ret == 0 && spec->summary_format != pico_sim_summary_none) {
+        (void)snprintf(cache_name, sizeof(cache_name), "%s%s%s.summary", entry->cache_dir, PICO_SIM_PATH_SEP_STR, entry->key);
+        pico_sim_cache_summary_name(file_name, sizeof(file_name), name, spec->summary_format);
+        if ((ret = pico_sim_cache_copy(cache_name, file_name)) != 0) {
+            fprintf(err_fd, "Cannot restore <%s> from the cache\n", file_name);
+        }
+    }
+    if (ret == 0 && spec->metrics_bin_interval > 0) {
+        (void)snprintf(cache_name, sizeof(cache_name), "%s%s%s.bins", entry->cache_dir, PICO_SIM_PATH_SEP_STR, entry->key);
+        (void)snprintf(file_name, sizeof(file_name), "%s_bins.bin", name);
+        if ((ret = pico_sim_cache_copy(cache_name, file_name)) != 0) {
+            fprintf(err_fd, "Cannot restore <%s> from the cache\n", file_name);
+        }
+    }
+    return ret;
+}
+
+int pico_sim_cache_lookup(pico_sim_spec_t const* spec, char const* name, pico_sim_cache_entry_t* entry,
+    int* is_hit, FILE* err_fd)
+{
+    int ret = 0;
+
+    memset(entry, 0, sizeof(pico_sim_cache_entry_t));
+    entry->cache_dir = spec->cache_dir;
+    *is_hit = 0;
+
+    if (pico_sim_mkdir(spec->cache_dir) != 0) {
+        fprintf(err_fd, "Cannot create the cache directory <%s>\n", spec->cache_dir);
+        ret = -1;
+    }
+    else if (pico_sim_cache_spec_text(entry, spec) != 0) {
+        ret = -1;
+    }
+    else {
+        uint64_t h = pico_sim_cache_fnv(PICO_SIM_CACHE_FNV_OFFSET, (uint8_t const*)entry->spec_text, entry->spec_text_len);
+
+        (void)snprintf(entry->key, sizeof(entry->key), "%016llx", (unsigned long long)h);
+        if (!spec->cache_refresh && pico_sim_cache_is_hit(entry)) {
+            if ((ret = pico_sim_cache_restore(entry, spec, name, err_fd)) == 0) {
+                *is_hit = 1;
+                pico_sim_cache_touch(entry);
+            }
+        }
+    }
+    return ret;
+}
+
+/* Only the files produced by the run are stored, not the other files of the
+ * qlog_dir, which may be written at the same time by other runs. */
+int pico_sim_cache_store(pico_sim_cache_entry_t const* entry, pico_sim_spec_t const* spec,
+    pico_sim_run_files_t const* run_files, char const* name, FILE* err_fd)
+{
+    int ret = 0;
+    char file_name[1024];
+
+    if (run_files != NULL) {
+        for (size_t i = 0; ret == 0 && i < run_files->nb_names; i++) {
+            (void)snprintf(file_name, sizeof(file_name), "%s%s", PICO_SIM_CACHE_QLOG_PREFIX,
+                pico_sim_cache_base_name(run_files->names[i]));
+            ret = pico_sim_cache_put(entry, run_files->names[i], file_name);
+        }
+    }
+    if (ret == 0 && spec->ns.qperf_log != NULL) {
+        ret = pico_sim_cache_put(entry, spec->ns.qperf_log, ".qperf");
+    }
+    if (ret == 0 && spec->summary_format != pico_sim_summary_none) {
+        pico_sim_cache_summary_name(file_name, sizeof(file_name), name, spec->summary_format);
+        ret = pico_sim_cache_put(entry, file_name, ".summary");
+    }
+    if (ret == 0 && spec->metrics_bin_interval > 0) {
+        (void)snprintf(file_name, sizeof(file_name), "%s_bins.bin", name);
+        ret = pico_sim_cache_put(entry, file_name, ".bins");
+    }
+    if (ret == 0) {
+        /* The spec is written last, and marks the entry as complete */
+        ret = pico_sim_cache_put(entry, NULL, ".spec");
+    }
+    if (ret == 0) {
+        pico_sim_cache_touch(entry);
+        fprintf(err_fd, "Result of %s stored in cache entry %s\n", name, entry->key);
+    }
+    else {
+        fprintf(err_fd, "Cannot store the result of %s in the cache <%s>\n", name, entry->cache_dir);
+    }
+    return ret;
+}
+
+void pico_sim_cache_release(pico_sim_cache_entry_t* entry)
+{
+    if (entry->spec_text != NULL) {
+        free(entry->spec_text);
+    }
+    memset(entry, 0, sizeof(pico_sim_cache_entry_t));
+}
+
+/* Remove the entries that were not used in the last max_age_days days,
+ * and the temporary files left by interrupted runs. */
+int pico_sim_cache_prune(char const* cache_dir, uint64_t max_age_days, FILE* err_fd)
+{
+    int ret = 0;
+    char** names = NULL;
+    size_t nb_names = 0;
+    int64_t limit = (int64_t)time(NULL) - (int64_t)(max_age_days * 86400);
+    size_t nb_removed = 0;
+    size_t nb_kept = 0;
+
+    if (pico_sim_list_files(cache_dir, "", &names, &nb_names) != 0) {
+        fprintf(err_fd, "Cannot list the cache <%s>\n", cache_dir);
+        ret = -1;
+    }
+    /* The names are sorted, so the files of an entry are consecutive */
+    for (size_t i = 0; ret == 0 && i < nb_names;) {
+        char const* base = pico_sim_cache_base_name(names[i]);
+        char const* dot = strchr(base, '.');
+        size_t key_len = (dot == NULL) ? strlen(base) : (size_t)(dot - base);
+        size_t j = i;
+        int is_recent = 0;
+
+        while (j < nb_names && strncmp(pico_sim_cache_base_name(names[j]), base, key_len) == 0 &&
+            pico_sim_cache_base_name(names[j])[key_len] == '.') {
+            char const* suffix = pico_sim_cache_base_name(names[j]) + key_len;
+            if ((strcmp(suffix, ".used") == 0 || strcmp(suffix, ".spec") == 0) && pico_sim_cache_is_used_since(names[j], limit)) {
+                is_recent = 1;
+            }
+            j++;
+        }
+        if (j == i) {
+            /* Not a cache file */
+            j = i + 1;
+        }
+        else {
+            for (size_t k = i; k < j; k++) {
+                if (!is_recent || strstr(pico_sim_cache_base_name(names[k]), ".tmp") != NULL) {
+                    (void)remove(names[k]);
+                }
+            }
+            if (is_recent) {
+                nb_kept++;
+            }
+            else {
+                nb_removed++;
+            }
+        }
+        i = j;
+    }
+    pico_sim_free_file_list(names, nb_names);
+    if (ret == 0) {
+        fprintf(err_fd, "Cache <%s>: removed %zu entries, kept %zu.\n", cache_dir, nb_removed, nb_kept);
+    }
+    return ret;
+}
@@ -0,0 +1,513 @@
+/* Synthetic cross traffic.
+* The only competing load that picoquic_ns simulates is a QUIC connection,
+* with its TLS and QUIC stack. A load of many short flows is cheaper to
+* describe by its packets: with "cross_traffic" in the spec, the packets
+* of a list of sources separated by ';' are generated when the simulation
+* starts, e.g., "cbr:R0.002; poisson:R0.005; pareto:R0.01:N50000:F200000":
+*
+* - "cbr": constant bit rate,
+* - "poisson": packets sent at exponential intervals,
+* - "pareto": on/off source, sending at constant rate during on periods
+*   and silent during off periods, both of Pareto distributed durations,
+*
+* with the letters R for the rate in Gbps (during the on periods for
+* pareto), S for the packet size in bytes (default 1500), N and F for
+* the mean on and off durations in microseconds (default 100000), and A
+* for the Pareto shape (default 1.5). With "cross_traffic_trace: <file>",
+* a recorded trace is also replayed, in a loop: each line gives the time
+* since the previous packet in microseconds and the size of the packet.
+*
+* The link of picoquic_ns only carries the packets of the simulation, so
+* the cross traffic is reduced to the capacity that it leaves: its bytes
+* are counted in bins of "link_trace_interval" microseconds, served first
+* at the link rate, with the excess kept for the next bins up to the queue
+* limit of the link and dropped beyond, and each bin of the link becomes a
+* segment with the remaining rate, in both directions. The cost does not
+* depend on the number of QUIC connections, and is a few operations per
+* packet of cross traffic.
+*
+* This is a capacity model only: the queue delay and the jitter caused by
+* the cross traffic are not seen by the QUIC packets, which never wait
+* behind cross traffic packets, so the latency effects of a shared link
+* are not modelled. A bin saturated by the cross traffic would leave no
+* capacity at all, a segment of rate 0 in which the simulation stalls
+* instead of queueing; the rate left is kept above 1% of the link rate,
+* and the number of bins clamped in this way is reported.
+*
+* The cross traffic applies to the link segments of the spec, from the
+* link scenario or the link trace, for their total duration, or to the
+* link of the spec for "main_target_time". The random sources are seeded
+* with the icid, so each replica sees different cross traffic.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <math.h>
+#include "picoquic.h"
+#include "picoquic_ns.h"
+#include "picoquic_utils.h"
+#include "pico_sim.h"
+
+#define PICO_SIM_CROSS_SOURCES_MAX 64
+#define PICO_SIM_CROSS_PACKET_SIZE 1500
+#define PICO_SIM_CROSS_PERIOD 100000
+#define PICO_SIM_CROSS_SHAPE 1.5
+#define PICO_SIM_CROSS_RATE_FLOOR 0.01
+
+typedef enum {
+    pico_sim_cross_cbr = 0,
+    pico_sim_cross_poisson,
+    pico_sim_cross_pareto
+} pico_sim_cross_type_enum;
+
+typedef struct st_pico_sim_cross_source_t {
+    pico_sim_cross_type_enum type;
+    double rate_in_gbps;
+    uint64_t packet_size;
+    double mean_on;
+    double mean_off;
+    double shape;
+} pico_sim_cross_source_t;
+
+typedef struct st_pico_sim_cross_t {
+    double* bin_bytes;
+    size_t nb_bins;
+    uint64_t interval;
+    uint64_t horizon;
+    uint64_t random_state;
+    uint64_t nb_packets;
+    uint64_t nb_clamped;
+} pico_sim_cross_t;
+
+/* Splitmix64, so that the cross traffic only depends on the spec */
+static uint64_t pico_sim_cross_random(pico_sim_cross_t* cross)
+{
+    uint64_t z = (cross->random_state += 0x9E3779B97F4A7C15ull);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/* Uniform in ]0, 1] */
+static double pico_sim_cross_uniform(pico_sim_cross_t* cross)
+{
+    return ((double)((pico_sim_cross_random(cross) >> 11) + 1)) / 9007199254740992.0;
+}
+
+static double pico_sim_cross_exponential(pico_sim_cross_t* cross, double mean)
+{
+    return -mean * log(pico_sim_cross_uniform(cross));
+}
+
+static double pico_sim_cross_pareto_sample(pico_sim_cross_t* cross, double mean, double shape)
+{
+    double scale = mean * (shape - 1.0) / shape;
+
+    return scale / pow(pico_sim_cross_uniform(cross), 1.0 / shape);
+}
+
+static void pico_sim_cross_add(pico_sim_cross_t* cross, double t, uint64_t bytes)
+{
+    size_t bin = (size_t)(t / (double)cross->interval);
+
+    if (bin < cross->nb_bins) {
+        cross->bin_bytes[bin] += (double)bytes;
+        cross->nb_packets++;
+    }
+}
+
+static int pico_sim_cross_parse_source(pico_sim_cross_source_t* source, char const* val)
+{
+    int ret = 0;
+    char const* x = val;
+    char item[64];
+    int is_first = 1;
+
+    memset(source, 0, sizeof(pico_sim_cross_source_t));
+    source->packet_size = PICO_SIM_CROSS_PACKET_SIZE;
+    source->mean_on = PICO_SIM_CROSS_PERIOD;
+    source->mean_off = PICO_SIM_CROSS_PERIOD;
+    source->shape = PICO_SIM_CROSS_SHAPE;
+
+    while (ret == 0 && *x != 0) {
+        size_t copied = 0;
+        uint64_t v = 0;
+
+        while (*x != 0 && *x != ':' && copied < sizeof(item) - 1) {
+            item[copied++] = *x++;
+        }
+        item[copied] = 0;
+        if (*x == ':') {
+            x++;
+        }
+        else if (*x != 0) {
+            ret = -1;
+            break;
+        }
+        if (is_first) {
+            if (strcmp(item, "cbr") == 0) {
+                source->type = pico_sim_cross_cbr;
+            }
+            else if (strcmp(item, "poisson") == 0) {
+                source->type = pico_sim_cross_poisson;
+            }
+            else if (strcmp(item, "pareto") == 0) {
+                source->type = pico_sim_cross_pareto;
+            }
+            else {
+                ret = -1;
+            }
+            is_first = 0;
+        }
+        else {
+            switch (item[0]) {
+            case 'R':
+                ret = parse_double(&source->rate_in_gbps, &item[1]);
+                break;
+            case 'S':
+                ret = parse_u64(&source->packet_size, &item[1]);
+                break;
+            case 'N':
+                if ((ret = parse_u64(&v, &item[1])) == 0) {
+                    source->mean_on = (double)v;
+                }
+                break;
+            case 'F':
+                if ((ret = parse_u64(&v, &item[1])) == 0) {
+                    source->mean_off = (double)v;
+                }
+                break;
+            case 'A':
+                ret = parse_double(&source->shape, &item[1]);
+                break;
+            default:
+                ret = -1;
+                break;
+            }
+        }
+    }
+    if (ret == 0 && (is_first || source->rate_in_gbps <= 0 || source->packet_size == 0 ||
+        source->mean_on <= 0 || source->mean_off <= 0 || source->shape <= 1.0)) {
+        ret = -1;
+    }
+    return ret;
+}
+
+static int pico_sim_cross_parse(char const* val, pico_sim_cross_source_t* sources, size_t* nb_sources)
+{
+    int ret = 0;
+    char const* x = val;
+    size_t nb = 0;
+
+    while (ret == 0 && *x != 0) {
+        char text[256];
+        size_t copied = 0;
+        pico_sim_cross_source_t source;
+
+        while (isspace(*x)) {
+            x++;
+        }
+        while (*x != 0 && *x != ';' && copied < sizeof(text) - 1) {
+            text[copied++] = *x++;
+        }
+        while (copied > 0 && isspace(text[copied - 1])) {
+            copied--;
+        }
+        text[copied] = 0;
+        if (*x == ';') {
+            x++;
+        }
+        if (copied == 0) {
+            continue;
+        }
+        if (nb >= PICO_SIM_CROSS_SOURCES_MAX || pico_sim_cross_parse_source(&source, text) != 0) {
+            ret = -1;
+        }
+        else {
+            sources[nb++] = source;
+        }
+    }
+    if (ret == 0 && nb == 0) {
+        ret = -1;
+    }
+    *nb_sources = nb;
+    return ret;
+}
+
+/* Check the list of sources when the spec is parsed */
+int pico_sim_cross_check(char const* val)
+{
+    pico_sim_cross_source_t sources[PICO_SIM_CROSS_SOURCES_MAX];
+    size_t nb_sources = 0;
+
+    return pico_sim_cross_parse(val, sources, &nb_sources);
+}
+
+static void pico_sim_cross_generate(pico_sim_cross_t* cross, pico_sim_cross_source_t const* source)
+{
+    /* bits per microsecond are megabits per second */
+    double gap = ((double)(source->packet_size * 8)) / (source->rate_in_gbps * 1000.0);
+    double horizon = (double)cross->horizon;
+    double t = 0;
+
+    if (source->type == pico_sim_cross_pareto) {
+        while (t < horizon) {
+            double on_end = t + pico_sim_cross_pareto_sample(cross, source->mean_on, source->shape);
+
+            while (t < on_end && t < horizon) {
+                pico_sim_cross_add(cross, t, source->packet_size);
+                t += gap;
+            }
+            t = on_end + pico_sim_cross_pareto_sample(cross, source->mean_off, source->shape);
+        }
+    }
+    else {
+        if (source->type == pico_sim_cross_poisson) {
+            t = pico_sim_cross_exponential(cross, gap);
+        }
+        while (t < horizon) {
+            pico_sim_cross_add(cross, t, source->packet_size);
+            t += (source->type == pico_sim_cross_poisson) ? pico_sim_cross_exponential(cross, gap) : gap;
+        }
+    }
+}
+
+/* Replay the packets of a trace file, in a loop until the horizon */
+static int pico_sim_cross_replay(pico_sim_cross_t* cross, char const* file_name, FILE* err_fd)
+{
+    int ret = 0;
+    FILE* F = NULL;
+    char line[256];
+    double t = 0;
+    double trace_time = 0;
+    uint64_t line_number = 0;
+
+    if ((F = picoquic_file_open(file_name, "r")) == NULL) {
+        fprintf(err_fd, "Cannot open cross traffic trace <%s>\n", file_name);
+        ret = -1;
+    }
+    while (ret == 0 && t < (double)cross->horizon) {
+        char* end = NULL;
+        char const* x = line;
+        double delta;
+        uint64_t size;
+
+        if (fgets(line, sizeof(line), F) == NULL) {
+            if (line_number == 0 || trace_time <= 0) {
+                fprintf(err_fd, "No packet duration in cross traffic trace <%s>\n", file_name);
+                ret = -1;
+            }
+            else {
+                /* Start the trace again */
+                rewind(F);
+                line_number = 0;
+                trace_time = 0;
+            }
+            continue;
+        }
+        line_number++;
+        while (isspace(*x)) {
+            x++;
+        }
+        if (*x == 0 || *x == '#') {
+            continue;
+        }
+        delta = strtod(x, &end);
+        size = (end == x) ? 0 : strtoull(end, &end, 10);
+        if (end == x || delta < 0 || size == 0) {
+            fprintf(err_fd, "Error in cross traffic trace <%s>, line %llu: %s", file_name,
+                (unsigned long long)line_number, line);
+            ret = -1;
+        }
+        else {
+            t += delta;
+            trace_time += delta;
+            if (t < (double)cross->horizon) {
+                pico_sim_cross_add(cross, t, size);
+            }
+        }
+    }
+    if (F != NULL) {
+        (void)picoquic_file_close(F);
+    }
+    return ret;
+}
+
+/* Serve the cross traffic of a piece of bin at the link rate, and return
+ * the rate left to the simulation, never below the floor */
+static double pico_sim_cross_serve(double rate_in_gbps, double* backlog, double bytes, uint64_t duration,
+    uint64_t queue_delay_max, int* is_clamped)
+{
+    double capacity = rate_in_gbps * 1000.0 * (double)duration / 8.0;
+    double floor_rate = rate_in_gbps * PICO_SIM_CROSS_RATE_FLOOR;
+    double left;
+    double served;
+
+    *backlog += bytes;
+    served = (*backlog < capacity) ? *backlog : capacity;
+    *backlog -= served;
+    if (queue_delay_max > 0) {
+        double queue_max = rate_in_gbps * 1000.0 * (double)queue_delay_max / 8.0;
+
+        if (*backlog > queue_max) {
+            /* Dropped at the tail of the queue */
+            *backlog = queue_max;
+        }
+    }
+    left = (capacity > 0) ? rate_in_gbps * (1.0 - served / capacity) : 0;
+    if (rate_in_gbps > 0 && left < floor_rate) {
+        left = floor_rate;
+        *is_clamped = 1;
+    }
+    return left;
+}
+
+static int pico_sim_cross_segments(pico_sim_cross_t* cross, picoquic_ns_link_spec_t const* base,
+    size_t nb_base, picoquic_ns_link_spec_t** segments, size_t* nb_segments)
+{
+    int ret = 0;
+    size_t nb_max = cross->nb_bins + nb_base;
+    size_t nb = 0;
+    size_t nb_merged = 0;
+    uint64_t t = 0;
+    double backlog_up = 0;
+    double backlog_down = 0;
+    picoquic_ns_link_spec_t* s = NULL;
+
+    if (nb_max > PICO_SIM_LINK_TRACE_SEGMENTS_MAX ||
+        (s = (picoquic_ns_link_spec_t*)malloc(nb_max * sizeof(picoquic_ns_link_spec_t))) == NULL) {
+        ret = -1;
+    }
+    for (size_t i = 0; ret == 0 && i < nb_base; i++) {
+        uint64_t segment_end = t + base[i].duration;
+        /* Only the pieces of the same base segment can be merged */
+        nb_merged = nb;
+
+        while (t < segment_end) {
+            size_t bin = (size_t)(t / cross->interval);
+            uint64_t bin_end = (bin + 1) * cross->interval;
+            uint64_t end = (bin_end < segment_end) ? bin_end : segment_end;
+            double bytes = (bin < cross->nb_bins) ? cross->bin_bytes[bin] * (double)(end - t) / (double)cross->interval : 0;
+            picoquic_ns_link_spec_t segment = base[i];
+            int is_clamped = 0;
+
+            segment.duration = end - t;
+            segment.data_rate_in_gbps_up = pico_sim_cross_serve(base[i].data_rate_in_gbps_up, &backlog_up, bytes,
+                segment.duration, base[i].queue_delay_max, &is_clamped);
+            segment.data_rate_in_gbps_down = pico_sim_cross_serve(base[i].data_rate_in_gbps_down, &backlog_down, bytes,
+                segment.duration, base[i].queue_delay_max, &is_clamped);
+            cross->nb_clamped += is_clamped;
+            if (nb > nb_merged && s[nb - 1].data_rate_in_gbps_up == segment.data_rate_in_gbps_up &&
+                s[nb - 1].data_rate_in_gbps_down == segment.data_rate_in_gbps_down) {
+                s[nb - 1].duration += segment.duration;
+            }
+            else if (nb >= nb_max) {
+                ret = -1;
+                break;
+            }
+            else {
+                s[nb++] = segment;
+            }
+            t = end;
+        }
+    }
+    if (ret == 0) {
+        *segments = s;
+        *nb_segments = nb;
+    }
+    else if (s != NULL) {
+        free(s);
+    }
+    return ret;
+}
+
+int pico_sim_cross_apply(pico_sim_spec_t* sim_spec, FILE* err_fd)
+{
+    int ret = 0;
+    picoquic_ns_spec_t* spec = &sim_spec->ns;
+    pico_sim_cross_t cross = { 0 };
+    pico_sim_cross_source_t sources[PICO_SIM_CROSS_SOURCES_MAX];
+    size_t nb_sources = 0;
+    picoquic_ns_link_spec_t link = { 0 };
+    picoquic_ns_link_spec_t const* base = &link;
+    size_t nb_base = 1;
+    picoquic_ns_link_spec_t* segments = NULL;
+    size_t nb_segments = 0;
+
+    if (spec->link_scenario == link_scenario_none && spec->vary_link_spec != NULL) {
+        base = spec->vary_link_spec;
+        nb_base = spec->vary_link_nb;
+        for (size_t i = 0; i < nb_base; i++) {
+            cross.horizon += base[i].duration;
+        }
+    }
+    else if (spec->link_scenario != link_scenario_none) {
+        fprintf(err_fd, "Cross traffic requires link segments, not a predefined link_scenario.\n");
+        ret = -1;
+    }
+    else {
+        link.duration = spec->main_target_time;
+        link.data_rate_in_gbps_up = spec->data_rate_in_gbps;
+        link.data_rate_in_gbps_down = spec->data_rate_in_gbps;
+        link.latency = spec->latency;
+        link.jitter = spec->jitter;
+        link.queue_delay_max = spec->queue_delay_max;
+        link.l4s_max = spec->l4s_max;
+        cross.horizon = spec->main_target_time;
+    }
+    if (ret == 0 && cross.horizon == 0) {
+        fprintf(err_fd, "Cross traffic requires link segments or a main_target_time.\n");
+        ret = -1;
+    }
+
+    if (ret == 0 && sim_spec->cross_traffic != NULL &&
+        pico_sim_cross_parse(sim_spec->cross_traffic, sources, &nb_sources) != 0) {
+        fprintf(err_fd, "Cannot parse the cross traffic: %s\n", sim_spec->cross_traffic);
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        cross.interval = (sim_spec->link_trace_interval > 0) ? sim_spec->link_trace_interval : PICO_SIM_LINK_TRACE_INTERVAL;
+        cross.nb_bins = (size_t)((cross.horizon + cross.interval - 1) / cross.interval);
+        for (size_t i = 0; i < 8; i++) {
+            cross.random_state = (cross.random_state << 8) | spec->icid.id[i];
+        }
+        if (cross.nb_bins > PICO_SIM_LINK_TRACE_SEGMENTS_MAX ||
+            (cross.bin_bytes = (double*)calloc(cross.nb_bins, sizeof(double))) == NULL) {
+            fprintf(err_fd, "Too many cross traffic bins: %zu\n", cross.nb_bins);
+            ret = -1;
+        }
+    }
+
+    for (size_t i = 0; ret == 0 && i < nb_sources; i++) {
+        pico_sim_cross_generate(&cross, &sources[i]);
+    }
+    if (ret == 0 && sim_spec->cross_traffic_trace != NULL) {
+        ret = pico_sim_cross_replay(&cross, sim_spec->cross_traffic_trace, err_fd);
+    }
+    if (ret == 0) {
+        ret = pico_sim_cross_segments(&cross, base, nb_base, &segments, &nb_segments);
+    }
+    if (ret == 0) {
+        if (spec->vary_link_spec != NULL) {
+            free(spec->vary_link_spec);
+        }
+        spec->link_scenario = link_scenario_none;
+        spec->vary_link_spec = segments;
+        spec->vary_link_nb = nb_segments;
+        fprintf(err_fd, "Cross traffic: %llu packets, %zu link segments\n", (unsigned long long)cross.nb_packets, nb_segments);
+        if (cross.nb_clamped > 0) {
+            fprintf(err_fd, "Cross traffic saturates the link: %llu bins kept at %.0f%% of the link rate\n",
+                (unsigned long long)cross.nb_clamped, PICO_SIM_CROSS_RATE_FLOOR * 100.0);
+        }
+    }
+
+    if (cross.bin_bytes != NULL) {
+        free(cross.bin_bytes);
+    }
+    return ret;
+}
@@ -0,0 +1,89 @@
+/* Expectations on the results of a simulation.
+* The picoquic simulation succeeds as soon as the transfers complete, so
+* a spec in which the fairness or the throughput regressed badly still
+* "passes". The spec keys "expect_goodput_min", "expect_completion_time_max",
+* "expect_fairness_min", "expect_rtt_p95_max" and "expect_queue_delay_p99_max"
+* set limits on the metrics of the whole run, as computed by the summary,
+* so that each spec is a pass/fail test.
+*
+* Each expectation that is set is reported in "<name>_expect.csv", with
+* the limit, the measured value and the verdict, and the failed ones are
+* also printed on the log. The run fails if any expectation is not met.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "picoquic.h"
+#include "picoquic_utils.h"
+#include "pico_sim.h"
+
+typedef struct st_pico_sim_expect_item_t {
+    char const* key;
+    char const* metric;
+    int is_max;
+    double limit;
+} pico_sim_expect_item_t;
+
+#define PICO_SIM_EXPECT_ITEMS_NB 5
+
+static void pico_sim_expect_items(pico_sim_expect_t const* expect, pico_sim_expect_item_t* items)
+{
+    pico_sim_expect_item_t const model[PICO_SIM_EXPECT_ITEMS_NB] = {
+        { "expect_goodput_min", "goodput_mbps", 0, expect->goodput_min },
+        { "expect_completion_time_max", "completion_time", 1, (double)expect->completion_time_max },
+        { "expect_fairness_min", "jain_index", 0, expect->fairness_min },
+        { "expect_rtt_p95_max", "rtt_p95", 1, (double)expect->rtt_p95_max },
+        { "expect_queue_delay_p99_max", "queue_delay_p99", 1, (double)expect->queue_delay_p99_max }
+    };
+
+    memcpy(items, model, sizeof(model));
+}
+
+int pico_sim_expect_is_set(pico_sim_expect_t const* expect)
+{
+    return (expect->goodput_min > 0 || expect->completion_time_max > 0 || expect->fairness_min > 0 ||
+        expect->rtt_p95_max > 0 || expect->queue_delay_p99_max > 0);
+}
+
+int pico_sim_expect_check(pico_sim_expect_t const* expect, double const* values, char const* name, FILE* err_fd)
+{
+    int ret = 0;
+    int nb_failed = 0;
+    char report_name[512];
+    pico_sim_expect_item_t items[PICO_SIM_EXPECT_ITEMS_NB];
+    FILE* F;
+
+    pico_sim_expect_items(expect, items);
+    (void)snprintf(report_name, sizeof(report_name), "%s_expect.csv", name);
+    if ((F = picoquic_file_open(report_name, "w")) == NULL) {
+        fprintf(err_fd, "Cannot create <%s>\n", report_name);
+        ret = -1;
+    }
+    else {
+        fprintf(F, "expectation, metric, limit, value, verdict\n");
+        for (size_t i = 0; i < PICO_SIM_EXPECT_ITEMS_NB; i++) {
+            int metric_id = pico_sim_summary_metric_id(items[i].metric, strlen(items[i].metric));
+            double value = values[metric_id];
+            int is_met = (items[i].is_max) ? (value <= items[i].limit) : (value >= items[i].limit);
+
+            if (items[i].limit <= 0) {
+                continue;
+            }
+            fprintf(F, "%s, %s, %.6f, %.6f, %s\n", items[i].key, items[i].metric, items[i].limit, value,
+                (is_met) ? "pass" : "fail");
+            if (!is_met) {
+                fprintf(err_fd, "Expectation failed (%s): %s = %.6f, %s %.6f\n", name, items[i].metric, value,
+                    (items[i].is_max) ? "above the max" : "below the min", items[i].limit);
+                nb_failed++;
+            }
+        }
+        (void)picoquic_file_close(F);
+        if (nb_failed > 0) {
+            fprintf(err_fd, "%d expectations failed for %s, see <%s>\n", nb_failed, name, report_name);
+            ret = -1;
+        }
+    }
+    return ret;
+}
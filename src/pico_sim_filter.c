@@ -0,0 +1,211 @@
+/* Qlog filtering.
+* The picoquic simulation writes all qlog events. For long simulations,
+* most of the volume is made of per packet events that are not used by
+* the analysis scripts. After the run, the qlogs are rewritten, keeping
+* only the categories or events listed in "qlog_level", and at most one
+* "recovery/metrics_updated" event per path and per "qlog_sample_interval"
+* microseconds of virtual time.
+*
+* The metrics updates only carry the values that changed. When updates
+* were dropped, the data of the next kept update is replaced by the
+* complete congestion control state, so the state reconstructed by
+* the scripts is the same as with the full trace at the sample times.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "picoquic.h"
+#include "picoquic_utils.h"
+#include "pico_sim.h"
+#include "pico_sim_qlog.h"
+
+#define PICO_SIM_FILTER_PATH_MAX 256
+#define PICO_SIM_FILTER_NAMES_MAX 32
+
+typedef struct st_pico_sim_filter_name_t {
+    char const* category;
+    size_t category_len;
+    char const* event; /* NULL if the whole category is kept */
+    size_t event_len;
+} pico_sim_filter_name_t;
+
+typedef struct st_pico_sim_filter_path_t {
+    pico_sim_cc_state_t cc_state;
+    int has_sample;
+    int has_dropped;
+    uint64_t last_sample_time;
+} pico_sim_filter_path_t;
+
+typedef struct st_pico_sim_filter_ctx_t {
+    int keep_all;
+    size_t nb_names;
+    pico_sim_filter_name_t names[PICO_SIM_FILTER_NAMES_MAX];
+    uint64_t sample_interval;
+    uint64_t nb_events;
+    uint64_t nb_kept;
+    char data[512];
+    pico_sim_filter_path_t paths[PICO_SIM_FILTER_PATH_MAX];
+} pico_sim_filter_ctx_t;
+
+/* Parse the list of categories or events, e.g., "recovery, transport:packet_lost" */
+static int pico_sim_filter_level(pico_sim_filter_ctx_t* f_ctx, char const* qlog_level)
+{
+    int ret = 0;
+    char const* x = qlog_level;
+
+    f_ctx->keep_all = (qlog_level == NULL);
+    while (ret == 0 && x != NULL && *x != 0) {
+        char const* start;
+        size_t len;
+
+        while (*x == ',' || *x == ' ' || *x == '\t') {
+            x++;
+        }
+        start = x;
+        while (*x != 0 && *x != ',' && *x != ' ' && *x != '\t') {
+            x++;
+        }
+        if ((len = x - start) == 0) {
+            break;
+        }
+        if (pico_sim_qlog_is(start, len, PICO_SIM_QLOG_LEVEL_ALL)) {
+            f_ctx->keep_all = 1;
+        }
+        else if (f_ctx->nb_names >= PICO_SIM_FILTER_NAMES_MAX) {
+            ret = -1;
+        }
+        else {
+            pico_sim_filter_name_t* name = &f_ctx->names[f_ctx->nb_names++];
+            char const* colon = memchr(start, ':', len);
+
+            name->category = start;
+            if (colon == NULL) {
+                name->category_len = len;
+            }
+            else {
+                name->category_len = colon - start;
+                name->event = colon + 1;
+                name->event_len = start + len - name->event;
+            }
+        }
+    }
+    return ret;
+}
+
+static int pico_sim_filter_is_listed(pico_sim_filter_ctx_t* f_ctx, pico_sim_qlog_event_t const* ev)
+{
+    int is_listed = f_ctx->keep_all;
+
+    for (size_t i = 0; !is_listed && i < f_ctx->nb_names; i++) {
+        pico_sim_filter_name_t* name = &f_ctx->names[i];
+        if (ev->category_len == name->category_len && memcmp(ev->category, name->category, ev->category_len) == 0) {
+            is_listed = (name->event == NULL ||
+                (ev->event_len == name->event_len && memcmp(ev->event, name->event, ev->event_len) == 0));
+        }
+    }
+    return is_listed;
+}
+
+static int pico_sim_filter_event(void* ctx, pico_sim_qlog_event_t const* ev, char const** data, size_t* data_len)
+{
+    int keep = 0;
+    pico_sim_filter_ctx_t* f_ctx = (pico_sim_filter_ctx_t*)ctx;
+
+    f_ctx->nb_events++;
+    if (pico_sim_filter_is_listed(f_ctx, ev)) {
+        uint64_t path_id = (ev->path_id < PICO_SIM_FILTER_PATH_MAX) ? ev->path_id : PICO_SIM_FILTER_PATH_MAX - 1;
+        pico_sim_filter_path_t* path = &f_ctx->paths[path_id];
+
+        if (f_ctx->sample_interval == 0 || !pico_sim_cc_update(&path->cc_state, ev)) {
+            keep = 1;
+        }
+        else if (path->has_sample && ev->event_time < path->last_sample_time + f_ctx->sample_interval) {
+            path->has_dropped = 1;
+        }
+        else {
+            keep = 1;
+            if (path->has_dropped) {
+                pico_sim_cc_state_t* cc = &path->cc_state;
+                int l = snprintf(f_ctx->data, sizeof(f_ctx->data),
+                    "{\"cwnd\": %llu, \"pacing_rate\": %llu, \"bytes_in_flight\": %llu, \"smoothed_rtt\": %llu, "
+                    "\"min_rtt\": %llu, \"latest_rtt\": %llu, \"app_limited\": %llu}",
+                    (unsigned long long)cc->cwnd, (unsigned long long)cc->pacing_rate,
+                    (unsigned long long)cc->bytes_in_flight, (unsigned long long)cc->smoothed_rtt,
+                    (unsigned long long)cc->min_rtt, (unsigned long long)cc->latest_rtt,
+                    (unsigned long long)cc->app_limited);
+                if (l > 0 && (size_t)l < sizeof(f_ctx->data)) {
+                    *data = f_ctx->data;
+                    *data_len = (size_t)l;
+                }
+            }
+            path->has_sample = 1;
+            path->has_dropped = 0;
+            path->last_sample_time = ev->event_time;
+        }
+    }
+    if (keep) {
+        f_ctx->nb_kept++;
+    }
+    return keep;
+}
+
+typedef struct st_pico_sim_filter_job_t {
+    char** names;
+    char const* qlog_level;
+    uint64_t sample_interval;
+} pico_sim_filter_job_t;
+
+/* Filter one qlog, possibly in parallel with the others */
+static int pico_sim_filter_one(void* ctx, size_t item, char* message, size_t message_size)
+{
+    int ret = 0;
+    pico_sim_filter_job_t* job = (pico_sim_filter_job_t*)ctx;
+    pico_sim_filter_ctx_t* f_ctx = (pico_sim_filter_ctx_t*)calloc(1, sizeof(pico_sim_filter_ctx_t));
+
+    if (f_ctx == NULL) {
+        ret = -1;
+    }
+    else {
+        f_ctx->sample_interval = job->sample_interval;
+        if (pico_sim_filter_level(f_ctx, job->qlog_level) != 0) {
+            (void)snprintf(message, message_size, "Too many names in qlog_level: %s", job->qlog_level);
+            ret = -1;
+        }
+        else if (pico_sim_qlog_filter(job->names[item], pico_sim_filter_event, f_ctx) != 0) {
+            (void)snprintf(message, message_size, "Cannot filter qlog <%s>", job->names[item]);
+            ret = -1;
+        }
+        else {
+            (void)snprintf(message, message_size, "Qlog <%s>: kept %llu events out of %llu", job->names[item],
+                (unsigned long long)f_ctx->nb_kept, (unsigned long long)f_ctx->nb_events);
+        }
+        free(f_ctx);
+    }
+    return ret;
+}
+
+int pico_sim_filter(pico_sim_run_files_t const* run_files, char const* qlog_level,
+    uint64_t sample_interval, int nb_threads, FILE* err_fd)
+{
+    int ret = 0;
+    char** names = NULL;
+    size_t nb_names = 0;
+    pico_sim_filter_job_t job;
+
+    if (pico_sim_list_run_qlogs(run_files, ".qlog", &names, &nb_names) != 0) {
+        fprintf(err_fd, "Cannot list the qlogs of the run\n");
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        job.names = names;
+        job.qlog_level = qlog_level;
+        job.sample_interval = sample_interval;
+        ret = pico_sim_parallel_for("Filter", nb_names, nb_threads, pico_sim_filter_one, &job, err_fd);
+    }
+    pico_sim_free_file_list(names, nb_names);
+
+    return ret;
+}
@@ -0,0 +1,213 @@
+/* Link capacity traces.
+* With "link_trace_file: <file>" in the spec, the variations of the link
+* are read from a trace file instead of the "link_scenario" line. The
+* file is read when the simulation starts, one line at a time, in one
+* of two formats:
+*
+* - One link segment per line, with the same syntax as an element of
+*   "link_scenario", e.g., "100000:U0.01:D0.01:L5000:Q15000".
+* - Mahimahi traces, in which each line is the time in milliseconds
+*   of a delivery opportunity for a 1500 bytes packet. The opportunities
+*   are counted in bins of "link_trace_interval" microseconds, and each
+*   bin becomes a segment with the corresponding data rate, in both
+*   directions, and with the latency, jitter and queue of the spec.
+*
+* A bin without delivery opportunities has a null data rate.
+* Lines starting with '#' are ignored. Consecutive segments with the
+* same characteristics are merged, so that traces with millisecond
+* granularity but long stable periods do not use much memory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include "picoquic.h"
+#include "picoquic_ns.h"
+#include "picoquic_utils.h"
+#include "pico_sim.h"
+
+#define PICO_SIM_LINK_TRACE_PACKET_BITS (1500 * 8)
+
+typedef struct st_pico_sim_link_trace_t {
+    picoquic_ns_link_spec_t* segments;
+    size_t nb_segments;
+    size_t nb_segments_max;
+    /* Mahimahi bins */
+    uint64_t bin_start;
+    uint64_t bin_count;
+} pico_sim_link_trace_t;
+
+char const* parse_link_spec_item(picoquic_ns_link_spec_t* line_spec, char const* val);
+
+static int pico_sim_link_trace_same(picoquic_ns_link_spec_t const* a, picoquic_ns_link_spec_t const* b)
+{
+    return (a->data_rate_in_gbps_up == b->data_rate_in_gbps_up &&
+        a->data_rate_in_gbps_down == b->data_rate_in_gbps_down &&
+        a->latency == b->latency && a->jitter == b->jitter &&
+        a->queue_delay_max == b->queue_delay_max && a->l4s_max == b->l4s_max &&
+        a->nb_loss_in_burst == b->nb_loss_in_burst &&
+        a->packets_between_losses == b->packets_between_losses);
+}
+
+/* Add a segment, or extend the last one if the link does not change */
+static int pico_sim_link_trace_add(pico_sim_link_trace_t* trace, picoquic_ns_link_spec_t const* segment)
+{
+    int ret = 0;
+
+    if (segment->duration == 0) {
+        /* Nothing to add */
+    }
+    else if (trace->nb_segments > 0 &&
+        pico_sim_link_trace_same(&trace->segments[trace->nb_segments - 1], segment)) {
+        trace->segments[trace->nb_segments - 1].duration += segment->duration;
+    }
+    else if (trace->nb_segments >= PICO_SIM_LINK_TRACE_SEGMENTS_MAX) {
+        ret = -1;
+    }
+    else {
+        if (trace->nb_segments >= trace->nb_segments_max) {
+            size_t new_max = (trace->nb_segments_max == 0) ? 256 : 2 * trace->nb_segments_max;
+            picoquic_ns_link_spec_t* new_segments = (picoquic_ns_link_spec_t*)realloc(trace->segments,
+                new_max * sizeof(picoquic_ns_link_spec_t));
+            if (new_segments == NULL) {
+                ret = -1;
+            }
+            else {
+                trace->segments = new_segments;
+                trace->nb_segments_max = new_max;
+            }
+        }
+        if (ret == 0) {
+            trace->segments[trace->nb_segments++] = *segment;
+        }
+    }
+    return ret;
+}
+
+/* Close the current Mahimahi bin */
+static int pico_sim_link_trace_bin(pico_sim_link_trace_t* trace, picoquic_ns_spec_t const* spec, uint64_t interval)
+{
+    picoquic_ns_link_spec_t segment = { 0 };
+    /* bits per microsecond are megabits per second */
+    double rate_in_gbps = ((double)(trace->bin_count * PICO_SIM_LINK_TRACE_PACKET_BITS)) / ((double)interval) / 1000.0;
+
+    segment.duration = interval;
+    segment.data_rate_in_gbps_up = rate_in_gbps;
+    segment.data_rate_in_gbps_down = rate_in_gbps;
+    segment.latency = spec->latency;
+    segment.jitter = spec->jitter;
+    segment.queue_delay_max = spec->queue_delay_max;
+    segment.l4s_max = spec->l4s_max;
+    trace->bin_start += interval;
+    trace->bin_count = 0;
+
+    return pico_sim_link_trace_add(trace, &segment);
+}
+
+static int pico_sim_link_trace_mahimahi(pico_sim_link_trace_t* trace, picoquic_ns_spec_t const* spec,
+    uint64_t interval, char const* line)
+{
+    int ret = 0;
+    uint64_t opportunity_time = 0;
+
+    if (parse_u64(&opportunity_time, line) != 0) {
+        ret = -1;
+    }
+    else {
+        opportunity_time *= 1000;
+        if (opportunity_time < trace->bin_start) {
+            /* Mahimahi times are in increasing order */
+            ret = -1;
+        }
+        while (ret == 0 && opportunity_time >= trace->bin_start + interval) {
+            ret = pico_sim_link_trace_bin(trace, spec, interval);
+        }
+        trace->bin_count++;
+    }
+    return ret;
+}
+
+int pico_sim_link_trace_load(pico_sim_spec_t* sim_spec, FILE* err_fd)
+{
+    int ret = 0;
+    picoquic_ns_spec_t* spec = &sim_spec->ns;
+    pico_sim_link_trace_t trace = { 0 };
+    uint64_t interval = (sim_spec->link_trace_interval > 0) ? sim_spec->link_trace_interval : PICO_SIM_LINK_TRACE_INTERVAL;
+    int is_mahimahi = 0;
+    int is_first = 1;
+    char line[1024];
+    uint64_t line_number = 0;
+    FILE* F = NULL;
+
+    if (spec->link_scenario != link_scenario_none || spec->vary_link_spec != NULL) {
+        fprintf(err_fd, "The spec cannot have both a link_scenario and a link_trace_file.\n");
+        ret = -1;
+    }
+    else if ((F = picoquic_file_open(sim_spec->link_trace_file, "r")) == NULL) {
+        fprintf(err_fd, "Cannot open link trace <%s>\n", sim_spec->link_trace_file);
+        ret = -1;
+    }
+
+    while (ret == 0 && fgets(line, sizeof(line), F) != NULL) {
+        size_t len = strlen(line);
+        char const* x = line;
+
+        line_number++;
+        while (len > 0 && isspace(line[len - 1])) {
+            len--;
+            line[len] = 0;
+        }
+        while (isspace(*x)) {
+            x++;
+        }
+        if (*x == 0 || *x == '#') {
+            continue;
+        }
+        if (is_first) {
+            /* The format is set by the first line */
+            is_mahimahi = (strchr(x, ':') == NULL);
+            is_first = 0;
+        }
+        if (is_mahimahi) {
+            ret = pico_sim_link_trace_mahimahi(&trace, spec, interval, x);
+        }
+        else {
+            picoquic_ns_link_spec_t segment = { 0 };
+            char const* next_val = parse_link_spec_item(&segment, x);
+
+            if (next_val == NULL || (*next_val != 0 && *next_val != ';')) {
+                ret = -1;
+            }
+            else {
+                ret = pico_sim_link_trace_add(&trace, &segment);
+            }
+        }
+        if (ret != 0) {
+            fprintf(err_fd, "Error in link trace <%s>, line %llu: %s\n", sim_spec->link_trace_file,
+                (unsigned long long)line_number, line);
+        }
+    }
+    if (ret == 0 && is_mahimahi && trace.bin_count > 0) {
+        ret = pico_sim_link_trace_bin(&trace, spec, interval);
+    }
+    if (ret == 0 && trace.nb_segments == 0) {
+        fprintf(err_fd, "No link segment in <%s>\n", sim_spec->link_trace_file);
+        ret = -1;
+    }
+
+    if (F != NULL) {
+        (void)picoquic_file_close(F);
+    }
+    if (ret == 0) {
+        spec->link_scenario = link_scenario_none;
+        spec->vary_link_nb = trace.nb_segments;
+        spec->vary_link_spec = trace.segments;
+        fprintf(err_fd, "Link trace <%s>: %zu segments\n", sim_spec->link_trace_file, trace.nb_segments);
+    }
+    else if (trace.segments != NULL) {
+        free(trace.segments);
+    }
+    return ret;
+}
@@ -0,0 +1,338 @@
+/* Latency histograms of the media streams.
+* The media scenarios are judged by picoquic_ns on the average and max
+* frame latency. A max does not tell whether the tail is one outlier or
+* a systematic problem, so after the run we read the "qperf_log" CSV and
+* count the latency of each frame in a histogram per media stream.
+*
+* Each line of the qperf log describes a received frame, with the id of
+* the media stream in the first column, and the time at which the frame
+* was sent and the time at which it was received, in microseconds, in the
+* last two columns. Lines that do not end with two numbers are ignored.
+* As in picoquic_ns, the frames sent before "media_stats_start" are not
+* counted, nor the streams listed in "media_excluded".
+*
+* The histograms are log-linear, as in HDR histograms: values below 64
+* have their own bucket, and each power of 2 above that is divided in 32
+* buckets, so the precision is about 3% and the memory is fixed,
+* whatever the number of frames.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include "picoquic.h"
+#include "picoquic_ns.h"
+#include "picoquic_utils.h"
+#include "pico_sim.h"
+
+#define PICO_SIM_MEDIA_SUB_BITS 5
+#define PICO_SIM_MEDIA_LINEAR (2 << PICO_SIM_MEDIA_SUB_BITS)
+#define PICO_SIM_MEDIA_SUB_BUCKETS (1 << PICO_SIM_MEDIA_SUB_BITS)
+#define PICO_SIM_MEDIA_BUCKETS (PICO_SIM_MEDIA_LINEAR + (64 - PICO_SIM_MEDIA_SUB_BITS - 1) * PICO_SIM_MEDIA_SUB_BUCKETS)
+#define PICO_SIM_MEDIA_ID_MAX 64
+
+typedef struct st_pico_sim_media_stream_t {
+    char id[PICO_SIM_MEDIA_ID_MAX];
+    uint64_t nb_frames;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t counts[PICO_SIM_MEDIA_BUCKETS];
+} pico_sim_media_stream_t;
+
+typedef struct st_pico_sim_media_t {
+    size_t nb_streams;
+    pico_sim_media_stream_t streams[PICO_SIM_MEDIA_STREAMS_MAX];
+} pico_sim_media_t;
+
+static size_t pico_sim_media_bucket(uint64_t v)
+{
+    size_t bucket;
+
+    if (v < PICO_SIM_MEDIA_LINEAR) {
+        bucket = (size_t)v;
+    }
+    else {
+        int msb = 63;
+        int shift;
+
+        while ((v >> msb) == 0) {
+            msb--;
+        }
+        shift = msb - PICO_SIM_MEDIA_SUB_BITS;
+        bucket = PICO_SIM_MEDIA_LINEAR + (size_t)(shift - 1) * PICO_SIM_MEDIA_SUB_BUCKETS +
+            (size_t)((v >> shift) - PICO_SIM_MEDIA_SUB_BUCKETS);
+    }
+    return bucket;
+}
+
+static void pico_sim_media_bucket_range(size_t bucket, uint64_t* low, uint64_t* high)
+{
+    if (bucket < PICO_SIM_MEDIA_LINEAR) {
+        *low = bucket;
+        *high = bucket;
+    }
+    else {
+        int shift = (int)((bucket - PICO_SIM_MEDIA_LINEAR) / PICO_SIM_MEDIA_SUB_BUCKETS) + 1;
+        uint64_t sub = PICO_SIM_MEDIA_SUB_BUCKETS + (bucket - PICO_SIM_MEDIA_LINEAR) % PICO_SIM_MEDIA_SUB_BUCKETS;
+
+        *low = sub << shift;
+        *high = ((sub + 1) << shift) - 1;
+    }
+}
+
+/* Latency at the given rank, in parts per thousand. The upper bound of
+ * the bucket is returned, but not more than the max seen. */
+static uint64_t pico_sim_media_percentile(pico_sim_media_stream_t const* stream, uint64_t permille)
+{
+    uint64_t v = 0;
+    uint64_t rank = (stream->nb_frames * permille + 999) / 1000;
+    uint64_t seen = 0;
+
+    if (rank == 0) {
+        rank = 1;
+    }
+    for (size_t i = 0; stream->nb_frames > 0 && i < PICO_SIM_MEDIA_BUCKETS; i++) {
+        seen += stream->counts[i];
+        if (seen >= rank) {
+            uint64_t low;
+            pico_sim_media_bucket_range(i, &low, &v);
+            break;
+        }
+    }
+    return (v > stream->max) ? stream->max : v;
+}
+
+/* The excluded streams are listed as "vhigh, vmid, vlast" */
+static int pico_sim_media_is_excluded(char const* media_excluded, char const* id)
+{
+    int is_excluded = 0;
+    char const* x = media_excluded;
+    size_t id_len = strlen(id);
+
+    while (x != NULL && *x != 0 && !is_excluded) {
+        char const* start;
+
+        while (*x == ',' || isspace(*x)) {
+            x++;
+        }
+        start = x;
+        while (*x != 0 && *x != ',' && !isspace(*x)) {
+            x++;
+        }
+        is_excluded = (x > start && (size_t)(x - start) == id_len && memcmp(start, id, id_len) == 0);
+    }
+    return is_excluded;
+}
+
+static pico_sim_media_stream_t* pico_sim_media_stream(pico_sim_media_t* media, char const* id)
+{
+    pico_sim_media_stream_t* stream = NULL;
+
+    for (size_t i = 0; i < media->nb_streams; i++) {
+        if (strcmp(media->streams[i].id, id) == 0) {
+            stream = &media->streams[i];
+            break;
+        }
+    }
+    if (stream == NULL && media->nb_streams < PICO_SIM_MEDIA_STREAMS_MAX) {
+        stream = &media->streams[media->nb_streams++];
+        /* The length of the id was checked when parsing the line */
+        memcpy(stream->id, id, strlen(id) + 1);
+        stream->min = UINT64_MAX;
+    }
+    return stream;
+}
+
+/* A number, possibly surrounded by spaces */
+static int pico_sim_media_u64(char const* field, uint64_t* v)
+{
+    int ret = 0;
+    char* end = NULL;
+
+    while (isspace(*field)) {
+        field++;
+    }
+    if (!isdigit(*field)) {
+        ret = -1;
+    }
+    else {
+        *v = (uint64_t)strtoull(field, &end, 10);
+        while (isspace(*end)) {
+            end++;
+        }
+        ret = (*end == 0) ? 0 : -1;
+    }
+    return ret;
+}
+
+/* Parse a line of the qperf log, return 0 if it describes a frame */
+static int pico_sim_media_line(char* line, char const** id, uint64_t* send_time, uint64_t* receive_time)
+{
+    int ret = 0;
+    char* fields[2] = { NULL, NULL };
+    char* x = line;
+
+    while (isspace(*x)) {
+        x++;
+    }
+    *id = x;
+    while (*x != 0 && *x != ',') {
+        x++;
+    }
+    if (*x != ',') {
+        ret = -1;
+    }
+    else {
+        char* end = x;
+
+        while (end > *id && isspace(end[-1])) {
+            end--;
+        }
+        *end = 0;
+        x++;
+        /* Keep the start of the last two fields */
+        while (*x != 0) {
+            fields[0] = fields[1];
+            fields[1] = x;
+            while (*x != 0 && *x != ',') {
+                x++;
+            }
+            if (*x == ',') {
+                *x = 0;
+                x++;
+            }
+        }
+        if (fields[0] == NULL || **id == 0 || strlen(*id) >= PICO_SIM_MEDIA_ID_MAX ||
+            pico_sim_media_u64(fields[0], send_time) != 0 ||
+            pico_sim_media_u64(fields[1], receive_time) != 0) {
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+static int pico_sim_media_write(pico_sim_media_t const* media, char const* media_excluded, char const* name, FILE* err_fd)
+{
+    int ret = 0;
+    char file_name[512];
+    FILE* F;
+
+    (void)snprintf(file_name, sizeof(file_name), "%s_media_latency.csv", name);
+    if ((F = picoquic_file_open(file_name, "w")) == NULL) {
+        fprintf(err_fd, "Cannot create <%s>\n", file_name);
+        ret = -1;
+    }
+    else {
+        fprintf(F, "stream, excluded, nb_frames, min, mean, p50, p90, p99, p999, max\n");
+        for (size_t i = 0; i < media->nb_streams; i++) {
+            pico_sim_media_stream_t const* s = &media->streams[i];
+            fprintf(F, "%s, %d, %llu, %llu, %.1f, %llu, %llu, %llu, %llu, %llu\n", s->id,
+                pico_sim_media_is_excluded(media_excluded, s->id),
+                (unsigned long long)s->nb_frames, (unsigned long long)((s->nb_frames > 0) ? s->min : 0),
+                (s->nb_frames > 0) ? ((double)s->sum) / ((double)s->nb_frames) : 0.0,
+                (unsigned long long)pico_sim_media_percentile(s, 500), (unsigned long long)pico_sim_media_percentile(s, 900),
+                (unsigned long long)pico_sim_media_percentile(s, 990), (unsigned long long)pico_sim_media_percentile(s, 999),
+                (unsigned long long)s->max);
+        }
+        (void)picoquic_file_close(F);
+    }
+
+    (void)snprintf(file_name, sizeof(file_name), "%s_media_histogram.csv", name);
+    if (ret == 0 && (F = picoquic_file_open(file_name, "w")) == NULL) {
+        fprintf(err_fd, "Cannot create <%s>\n", file_name);
+        ret = -1;
+    }
+    else if (ret == 0) {
+        fprintf(F, "stream, latency_low, latency_high, count\n");
+        for (size_t i = 0; i < media->nb_streams; i++) {
+            for (size_t b = 0; b < PICO_SIM_MEDIA_BUCKETS; b++) {
+                if (media->streams[i].counts[b] > 0) {
+                    uint64_t low;
+                    uint64_t high;
+
+                    pico_sim_media_bucket_range(b, &low, &high);
+                    fprintf(F, "%s, %llu, %llu, %llu\n", media->streams[i].id, (unsigned long long)low,
+                        (unsigned long long)high, (unsigned long long)media->streams[i].counts[b]);
+                }
+            }
+        }
+        (void)picoquic_file_close(F);
+    }
+    return ret;
+}
+
+int pico_sim_media_report(pico_sim_spec_t const* spec, char const* name, FILE* err_fd)
+{
+    int ret = 0;
+    pico_sim_media_t* media = NULL;
+    FILE* F = NULL;
+    char line[1024];
+
+    if ((media = (pico_sim_media_t*)calloc(1, sizeof(pico_sim_media_t))) == NULL) {
+        ret = -1;
+    }
+    else if ((F = picoquic_file_open(spec->ns.qperf_log, "r")) == NULL) {
+        fprintf(err_fd, "Cannot open the qperf log <%s>\n", spec->ns.qperf_log);
+        ret = -1;
+    }
+
+    while (ret == 0 && fgets(line, sizeof(line), F) != NULL) {
+        char const* id;
+        uint64_t send_time;
+        uint64_t receive_time;
+        pico_sim_media_stream_t* stream;
+
+        if (pico_sim_media_line(line, &id, &send_time, &receive_time) != 0 ||
+            send_time < spec->ns.media_stats_start || receive_time < send_time) {
+            continue;
+        }
+        if ((stream = pico_sim_media_stream(media, id)) == NULL) {
+            fprintf(err_fd, "More than %d media streams in <%s>\n", PICO_SIM_MEDIA_STREAMS_MAX, spec->ns.qperf_log);
+            ret = -1;
+        }
+        else {
+            uint64_t latency = receive_time - send_time;
+
+            stream->nb_frames++;
+            stream->sum += latency;
+            stream->min = (latency < stream->min) ? latency : stream->min;
+            stream->max = (latency > stream->max) ? latency : stream->max;
+            stream->counts[pico_sim_media_bucket(latency)]++;
+        }
+    }
+    if (F != NULL) {
+        (void)picoquic_file_close(F);
+    }
+
+    if (ret == 0) {
+        ret = pico_sim_media_write(media, spec->ns.media_excluded, name, err_fd);
+    }
+
+    for (size_t i = 0; ret == 0 && media != NULL && i < media->nb_streams; i++) {
+        pico_sim_media_stream_t const* s = &media->streams[i];
+        uint64_t p99 = pico_sim_media_percentile(s, 990);
+        uint64_t p999 = pico_sim_media_percentile(s, 999);
+
+        if (pico_sim_media_is_excluded(spec->ns.media_excluded, s->id)) {
+            continue;
+        }
+        if (spec->media_latency_p99 > 0 && p99 > spec->media_latency_p99) {
+            fprintf(err_fd, "Media stream %s: p99 latency %llu > %llu\n", s->id,
+                (unsigned long long)p99, (unsigned long long)spec->media_latency_p99);
+            ret = -1;
+        }
+        if (spec->media_latency_p999 > 0 && p999 > spec->media_latency_p999) {
+            fprintf(err_fd, "Media stream %s: p99.9 latency %llu > %llu\n", s->id,
+                (unsigned long long)p999, (unsigned long long)spec->media_latency_p999);
+            ret = -1;
+        }
+    }
+
+    if (media != NULL) {
+        free(media);
+    }
+    return ret;
+}
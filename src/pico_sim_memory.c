@@ -0,0 +1,147 @@
+/* Memory accounting of the simulations.
+* The packets, link queues and connections of a simulation are allocated
+* and freed by picoquic_ns, which pico_sim cannot change, so their memory
+* is measured from the process: the resident memory before the call, and
+* the peak resident memory during the call. On Linux, the peak is reset
+* before each simulation, so that runs made one after the other in the
+* same process, in a benchmark or in a batch on Windows, are each measured
+* on their own. On other systems the peak is that of the process.
+*
+* After each simulation, the memory freed by picoquic_ns is returned to
+* the system if the C library supports it, so that the heap left by a
+* large run does not add to the resident memory of the following runs.
+*
+* The memory of the spec itself, texts and link segments, is counted
+* separately.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef _WINDOWS
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include "picoquic.h"
+#include "picoquic_utils.h"
+#include "pico_sim.h"
+
+/* Current resident memory of the process, in bytes, or 0 if unknown */
+uint64_t pico_sim_memory_current(void)
+{
+    uint64_t current = 0;
+#ifdef _WINDOWS
+    PROCESS_MEMORY_COUNTERS pmc;
+
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        current = (uint64_t)pmc.WorkingSetSize;
+    }
+#else
+    FILE* F = fopen("/proc/self/statm", "r");
+
+    if (F != NULL) {
+        unsigned long long size = 0;
+        unsigned long long resident = 0;
+
+        if (fscanf(F, "%llu %llu", &size, &resident) == 2) {
+            current = (uint64_t)resident * (uint64_t)sysconf(_SC_PAGESIZE);
+        }
+        (void)fclose(F);
+    }
+#endif
+    return current;
+}
+
+/* Peak resident memory of the process, in bytes, since the start or
+ * since the last call to pico_sim_memory_reset_peak. On Linux, this is
+ * VmHWM, which is reset, unlike ru_maxrss. */
+uint64_t pico_sim_memory_peak(void)
+{
+    uint64_t peak = 0;
+#if defined(_WINDOWS)
+    PROCESS_MEMORY_COUNTERS pmc;
+
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        peak = (uint64_t)pmc.PeakWorkingSetSize;
+    }
+#elif defined(__linux__)
+    FILE* F = fopen("/proc/self/status", "r");
+    char line[256];
+
+    if (F != NULL) {
+        while (fgets(line, sizeof(line), F) != NULL) {
+            unsigned long long hwm = 0;
+            if (sscanf(line, "VmHWM: %llu kB", &hwm) == 1) {
+                peak = ((uint64_t)hwm) * 1024;
+                break;
+            }
+        }
+        (void)fclose(F);
+    }
+#else
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+        peak = (uint64_t)usage.ru_maxrss;
+#else
+        peak = ((uint64_t)usage.ru_maxrss) * 1024;
+#endif
+    }
+#endif
+    return peak;
+}
+
+/* Set the peak to the current resident memory, where the system allows it */
+void pico_sim_memory_reset_peak(void)
+{
+#ifdef __linux__
+    FILE* F = fopen("/proc/self/clear_refs", "w");
+
+    if (F != NULL) {
+        (void)fputs("5", F);
+        (void)fclose(F);
+    }
+#endif
+}
+
+/* Return the free memory of the heap to the system */
+void pico_sim_memory_release(void)
+{
+#ifdef __GLIBC__
+    (void)malloc_trim(0);
+#endif
+}
+
+static size_t pico_sim_memory_text(char const* text)
+{
+    return (text == NULL) ? 0 : strlen(text) + 1;
+}
+
+/* Bytes allocated for the texts and the link segments of a spec */
+size_t pico_sim_memory_spec(pico_sim_spec_t const* spec)
+{
+    size_t bytes = pico_sim_memory_text(spec->ns.main_scenario_text) +
+        pico_sim_memory_text(spec->ns.background_scenario_text) +
+        pico_sim_memory_text(spec->ns.main_cc_options) +
+        pico_sim_memory_text(spec->ns.background_cc_options) +
+        pico_sim_memory_text(spec->ns.qlog_dir) +
+        pico_sim_memory_text(spec->ns.qperf_log) +
+        pico_sim_memory_text(spec->ns.media_excluded) +
+        pico_sim_memory_text(spec->qlog_level) +
+        pico_sim_memory_text(spec->link_trace_file) +
+        pico_sim_memory_text(spec->cross_traffic) +
+        pico_sim_memory_text(spec->cross_traffic_trace);
+
+    if (spec->ns.link_scenario == link_scenario_none && spec->ns.vary_link_spec != NULL) {
+        bytes += spec->ns.vary_link_nb * sizeof(picoquic_ns_link_spec_t);
+    }
+    return bytes;
+}
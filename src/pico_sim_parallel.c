@@ -0,0 +1,182 @@
+/* Parallel processing of the qlogs of a simulation.
+* The picoquic simulation itself runs as a single call, on one core, and
+* its partitioning is not visible from pico_sim. A large scenario, with
+* many flows, does however produce many qlogs, and the processing of
+* these qlogs after the run (summary, filtering, segmentation) can
+* take as long as the simulation. With "-T nb", each of these steps
+* processes the qlogs on nb threads.
+*
+* This is not a parallel simulation: the simulation runs as before, and
+* only the processing of its qlogs is spread over the threads.
+*
+* The qlogs are assigned to the threads in a fixed order, thread t taking
+* the items t, t + nb, t + 2*nb, etc., and each item writes its results
+* in its own slot, merged by the caller in the order of the items, so the
+* outputs are identical to those of the sequential processing. The log
+* message of each item is also kept in its slot, and the messages are
+* printed in the order of the items once all the threads are done.
+*
+* The log reports the utilization of the threads, the time that they
+* spent processing items divided by the elapsed time of all the threads.
+* This is not a speed-up: items that compete for the memory bandwidth or
+* the disk are slower on several threads than on one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef _WINDOWS
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#include "picoquic.h"
+#include "picoquic_utils.h"
+#include "pico_sim.h"
+
+#ifdef _WINDOWS
+typedef HANDLE pico_sim_thread_t;
+#else
+typedef pthread_t pico_sim_thread_t;
+#endif
+
+typedef struct st_pico_sim_parallel_thread_t {
+    size_t first_item;
+    size_t nb_items;
+    size_t step;
+    pico_sim_parallel_fn fn;
+    void* ctx;
+    char** messages;
+    uint64_t work_time;
+    int ret;
+} pico_sim_parallel_thread_t;
+
+static void pico_sim_parallel_work(pico_sim_parallel_thread_t* thread)
+{
+    uint64_t start_time = picoquic_current_time();
+    char message[PICO_SIM_PARALLEL_MESSAGE_SIZE];
+
+    for (size_t i = thread->first_item; i < thread->nb_items; i += thread->step) {
+        message[0] = 0;
+        if (thread->fn(thread->ctx, i, message, sizeof(message)) != 0) {
+            thread->ret = -1;
+        }
+        if (message[0] != 0) {
+            size_t l = strlen(message);
+
+            if ((thread->messages[i] = (char*)malloc(l + 1)) == NULL) {
+                thread->ret = -1;
+            }
+            else {
+                memcpy(thread->messages[i], message, l + 1);
+            }
+        }
+    }
+    thread->work_time = picoquic_current_time() - start_time;
+}
+
+#ifdef _WINDOWS
+static DWORD WINAPI pico_sim_parallel_thread(LPVOID arg)
+{
+    pico_sim_parallel_work((pico_sim_parallel_thread_t*)arg);
+    return 0;
+}
+#else
+static void* pico_sim_parallel_thread(void* arg)
+{
+    pico_sim_parallel_work((pico_sim_parallel_thread_t*)arg);
+    return NULL;
+}
+#endif
+
+int pico_sim_parallel_for(char const* label, size_t nb_items, int nb_threads, pico_sim_parallel_fn fn, void* ctx,
+    FILE* err_fd)
+{
+    int ret = 0;
+    pico_sim_parallel_thread_t* threads = NULL;
+    pico_sim_thread_t* handles = NULL;
+    char** messages = NULL;
+    int nb_started = 0;
+    uint64_t start_time = picoquic_current_time();
+
+    if (nb_threads > (int)nb_items) {
+        nb_threads = (int)nb_items;
+    }
+    if (nb_threads < 1) {
+        nb_threads = 1;
+    }
+    if ((threads = (pico_sim_parallel_thread_t*)calloc(nb_threads, sizeof(pico_sim_parallel_thread_t))) == NULL ||
+        (handles = (pico_sim_thread_t*)calloc(nb_threads, sizeof(pico_sim_thread_t))) == NULL ||
+        (messages = (char**)calloc(nb_items + 1, sizeof(char*))) == NULL) {
+        ret = -1;
+    }
+
+    for (int t = 0; ret == 0 && t < nb_threads; t++) {
+        threads[t].first_item = (size_t)t;
+        threads[t].nb_items = nb_items;
+        threads[t].step = (size_t)nb_threads;
+        threads[t].fn = fn;
+        threads[t].ctx = ctx;
+        threads[t].messages = messages;
+    }
+
+    /* Thread 0 is the calling thread */
+    for (int t = 1; ret == 0 && t < nb_threads; t++) {
+#ifdef _WINDOWS
+        if ((handles[t] = CreateThread(NULL, 0, pico_sim_parallel_thread, &threads[t], 0, NULL)) == NULL) {
+#else
+        if (pthread_create(&handles[t], NULL, pico_sim_parallel_thread, &threads[t]) != 0) {
+#endif
+            fprintf(err_fd, "Cannot start the %s threads\n", label);
+            ret = -1;
+        }
+        else {
+            nb_started = t;
+        }
+    }
+    if (ret == 0) {
+        pico_sim_parallel_work(&threads[0]);
+        ret = threads[0].ret;
+    }
+    for (int t = 1; t <= nb_started; t++) {
+#ifdef _WINDOWS
+        (void)WaitForSingleObject(handles[t], INFINITE);
+        (void)CloseHandle(handles[t]);
+#else
+        (void)pthread_join(handles[t], NULL);
+#endif
+        ret |= threads[t].ret;
+    }
+
+    if (messages != NULL) {
+        /* In the order of the items, whatever the thread that processed them */
+        for (size_t i = 0; i < nb_items; i++) {
+            if (messages[i] != NULL) {
+                fprintf(err_fd, "%s\n", messages[i]);
+                free(messages[i]);
+            }
+        }
+        free(messages);
+    }
+
+    if (ret == 0 && nb_threads > 1) {
+        uint64_t wall_time = picoquic_current_time() - start_time;
+        uint64_t work_time = 0;
+
+        for (int t = 0; t < nb_threads; t++) {
+            work_time += threads[t].work_time;
+        }
+        fprintf(err_fd, "%s of %zu qlogs on %d threads: %.3f s, thread utilization %.0f%%\n", label, nb_items,
+            nb_threads, ((double)wall_time) / 1000000.0,
+            (wall_time > 0) ? (100.0 * (double)work_time) / ((double)wall_time * (double)nb_threads) : 100.0);
+    }
+
+    if (handles != NULL) {
+        free(handles);
+    }
+    if (threads != NULL) {
+        free(threads);
+    }
+    return ret;
+}
@@ -0,0 +1,244 @@
+/* Self profiling of the simulator.
+* Reports, for each run, the wall time and CPU time, the virtual time
+* simulated, the speed-up ratio between virtual time and the wall time
+* of the simulation, and the rate of simulated events and packets, with
+* the wall time spent in each phase of the run, and the memory used by the
+* spec and by the simulation, with the max number of bytes and packets in
+* flight in the link. The results are printed after the
+* "picoquic_ns (...) returns" line, and written to "<name>_profile.csv".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "picoquic.h"
+#include "picoquic_utils.h"
+#include "pico_sim.h"
+#include "pico_sim_qlog.h"
+
+#define PICO_SIM_PROFILE_PATH_MAX 256
+
+/* Change of the bytes in flight of a path. The sum of the changes of all
+ * the qlogs, in time order, is the number of bytes in flight in the link. */
+typedef struct st_pico_sim_profile_delta_t {
+    uint64_t event_time;
+    int64_t delta;
+} pico_sim_profile_delta_t;
+
+typedef struct st_pico_sim_profile_ctx_t {
+    pico_sim_profile_t* profile;
+    pico_sim_cc_state_t cc_state[PICO_SIM_PROFILE_PATH_MAX];
+    uint64_t last_time;
+    pico_sim_profile_delta_t* deltas;
+    size_t nb_deltas;
+    size_t nb_deltas_max;
+} pico_sim_profile_ctx_t;
+
+static int pico_sim_profile_add_delta(pico_sim_profile_ctx_t* ctx, uint64_t event_time, int64_t delta)
+{
+    int ret = 0;
+
+    if (ctx->nb_deltas >= ctx->nb_deltas_max) {
+        size_t new_max = (ctx->nb_deltas_max == 0) ? 1024 : 2 * ctx->nb_deltas_max;
+        pico_sim_profile_delta_t* new_deltas = (pico_sim_profile_delta_t*)realloc(ctx->deltas,
+            new_max * sizeof(pico_sim_profile_delta_t));
+        if (new_deltas == NULL) {
+            ret = -1;
+        }
+        else {
+            ctx->deltas = new_deltas;
+            ctx->nb_deltas_max = new_max;
+        }
+    }
+    if (ret == 0) {
+        ctx->deltas[ctx->nb_deltas].event_time = event_time;
+        ctx->deltas[ctx->nb_deltas].delta = delta;
+        ctx->nb_deltas++;
+    }
+    return ret;
+}
+
+static int pico_sim_profile_compare_delta(void const* a, void const* b)
+{
+    pico_sim_profile_delta_t const* da = (pico_sim_profile_delta_t const*)a;
+    pico_sim_profile_delta_t const* db = (pico_sim_profile_delta_t const*)b;
+    int ret = 0;
+
+    /* At the same time, the decreases come first, not to count a packet twice */
+    if (da->event_time != db->event_time) {
+        ret = (da->event_time < db->event_time) ? -1 : 1;
+    }
+    else if (da->delta != db->delta) {
+        ret = (da->delta < db->delta) ? -1 : 1;
+    }
+    return ret;
+}
+
+static int pico_sim_profile_header_member(void* ctx, char const* name, size_t name_len, char const* value, size_t value_len)
+{
+    if (pico_sim_qlog_is(name, name_len, "packet_size")) {
+        *((uint64_t*)ctx) = pico_sim_qlog_u64(value, value_len);
+    }
+    return 0;
+}
+
+static int pico_sim_profile_packet_member(void* ctx, char const* name, size_t name_len, char const* value, size_t value_len)
+{
+    if (pico_sim_qlog_is(name, name_len, "header")) {
+        (void)pico_sim_qlog_members(value, value_len, pico_sim_profile_header_member, ctx);
+    }
+    return 0;
+}
+
+static int pico_sim_profile_event(void* v_ctx, pico_sim_qlog_event_t const* ev)
+{
+    int ret = 0;
+    pico_sim_profile_ctx_t* ctx = (pico_sim_profile_ctx_t*)v_ctx;
+    pico_sim_profile_t* profile = ctx->profile;
+    uint64_t path_id = (ev->path_id < PICO_SIM_PROFILE_PATH_MAX) ? ev->path_id : PICO_SIM_PROFILE_PATH_MAX - 1;
+    uint64_t bytes_in_flight = ctx->cc_state[path_id].bytes_in_flight;
+
+    profile->nb_events++;
+    if (ev->event_time > profile->virtual_time) {
+        profile->virtual_time = ev->event_time;
+    }
+    ctx->last_time = ev->event_time;
+    if (pico_sim_qlog_is(ev->event, ev->event_len, "packet_sent")) {
+        uint64_t packet_size = 0;
+        profile->nb_packets++;
+        (void)pico_sim_qlog_members(ev->data, ev->data_len, pico_sim_profile_packet_member, &packet_size);
+        profile->packet_bytes += packet_size;
+    }
+    else if (pico_sim_cc_update(&ctx->cc_state[path_id], ev) &&
+        ctx->cc_state[path_id].bytes_in_flight != bytes_in_flight) {
+        ret = pico_sim_profile_add_delta(ctx, ev->event_time,
+            (int64_t)ctx->cc_state[path_id].bytes_in_flight - (int64_t)bytes_in_flight);
+    }
+    return ret;
+}
+
+/* The bytes still in flight at the end of a qlog leave the link then */
+static int pico_sim_profile_end_qlog(pico_sim_profile_ctx_t* ctx)
+{
+    int ret = 0;
+
+    for (size_t i = 0; ret == 0 && i < PICO_SIM_PROFILE_PATH_MAX; i++) {
+        if (ctx->cc_state[i].bytes_in_flight > 0) {
+            ret = pico_sim_profile_add_delta(ctx, ctx->last_time, -(int64_t)ctx->cc_state[i].bytes_in_flight);
+        }
+    }
+    memset(ctx->cc_state, 0, sizeof(ctx->cc_state));
+    return ret;
+}
+
+/* Count the events and packets in the qlogs, and find the last event time.
+ * The simulation starts at virtual time 0. Packets are counted by their
+ * sender, in the qlogs that are available. */
+int pico_sim_profile_scan(pico_sim_run_files_t const* run_files, pico_sim_profile_t* profile)
+{
+    int ret = 0;
+    char** names = NULL;
+    size_t nb_names = 0;
+    pico_sim_profile_ctx_t* ctx = NULL;
+
+    if ((ctx = (pico_sim_profile_ctx_t*)calloc(1, sizeof(pico_sim_profile_ctx_t))) == NULL) {
+        ret = -1;
+    }
+    else if ((ret = pico_sim_list_run_qlogs(run_files, ".qlog", &names, &nb_names)) == 0) {
+        ctx->profile = profile;
+        for (size_t i = 0; ret == 0 && i < nb_names; i++) {
+            ret = pico_sim_qlog_scan(names[i], pico_sim_profile_event, ctx);
+            if (ret == 0) {
+                ret = pico_sim_profile_end_qlog(ctx);
+            }
+            profile->nb_qlogs++;
+        }
+    }
+    pico_sim_free_file_list(names, nb_names);
+
+    if (ret == 0) {
+        int64_t bytes_in_flight = 0;
+
+        qsort(ctx->deltas, ctx->nb_deltas, sizeof(pico_sim_profile_delta_t), pico_sim_profile_compare_delta);
+        for (size_t i = 0; i < ctx->nb_deltas; i++) {
+            bytes_in_flight += ctx->deltas[i].delta;
+            if (bytes_in_flight > (int64_t)profile->max_bytes_in_flight) {
+                profile->max_bytes_in_flight = (uint64_t)bytes_in_flight;
+            }
+        }
+    }
+    if (ctx != NULL) {
+        if (ctx->deltas != NULL) {
+            free(ctx->deltas);
+        }
+        free(ctx);
+    }
+
+    return ret;
+}
+
+int pico_sim_profile_report(pico_sim_profile_t const* profile, char const* name, FILE* err_fd)
+{
+    int ret = 0;
+    char profile_name[512];
+    uint64_t simulation_time = profile->phase_time[pico_sim_phase_simulation];
+    double wall_seconds = ((double)profile->wall_time) / 1000000.0;
+    double speed_ratio = 0;
+    double events_per_second = 0;
+    double packets_per_second = 0;
+    uint64_t simulation_bytes = (profile->memory_peak > profile->memory_start) ?
+        profile->memory_peak - profile->memory_start : 0;
+    uint64_t bytes_per_connection = simulation_bytes / ((profile->nb_connections > 1) ? profile->nb_connections : 1);
+    uint64_t max_packets_in_flight = 0;
+    FILE* F;
+
+    if (profile->packet_bytes > 0) {
+        /* In packets of the mean size sent */
+        max_packets_in_flight = (profile->max_bytes_in_flight * profile->nb_packets + profile->packet_bytes - 1) /
+            profile->packet_bytes;
+    }
+
+    /* Rates are relative to the time spent in the simulation itself */
+    if (simulation_time > 0) {
+        speed_ratio = ((double)profile->virtual_time) / ((double)simulation_time);
+        events_per_second = ((double)profile->nb_events) * 1000000.0 / ((double)simulation_time);
+        packets_per_second = ((double)profile->nb_packets) * 1000000.0 / ((double)simulation_time);
+    }
+    fprintf(err_fd, "Profile (%s): wall %.3f s, cpu %.3f s, virtual %.3f s, speed ratio %.2f, %.0f events/s, %.0f packets/s\n",
+        name, wall_seconds, ((double)profile->cpu_time) / 1000000.0, ((double)profile->virtual_time) / 1000000.0,
+        speed_ratio, events_per_second, packets_per_second);
+    fprintf(err_fd, "Phases (%s): simulation %.3f s, summary %.3f s, filter %.3f s, trace %.3f s\n", name,
+        ((double)profile->phase_time[pico_sim_phase_simulation]) / 1000000.0,
+        ((double)profile->phase_time[pico_sim_phase_summary]) / 1000000.0,
+        ((double)profile->phase_time[pico_sim_phase_filter]) / 1000000.0,
+        ((double)profile->phase_time[pico_sim_phase_trace]) / 1000000.0);
+    fprintf(err_fd, "Memory (%s): spec %llu bytes, peak %.1f MB, simulation %.1f MB, %.1f kB per connection, in flight %llu bytes, %llu packets\n",
+        name, (unsigned long long)profile->spec_bytes, ((double)profile->memory_peak) / 1000000.0,
+        ((double)simulation_bytes) / 1000000.0, ((double)bytes_per_connection) / 1000.0,
+        (unsigned long long)profile->max_bytes_in_flight, (unsigned long long)max_packets_in_flight);
+
+    (void)snprintf(profile_name, sizeof(profile_name), "%s_profile.csv", name);
+    if ((F = picoquic_file_open(profile_name, "w")) == NULL) {
+        fprintf(err_fd, "Cannot create profile <%s>\n", profile_name);
+        ret = -1;
+    }
+    else {
+        fprintf(F, "%s\n", PICO_SIM_PROFILE_HEADER);
+        fprintf(F, "%llu, %llu, %llu, %.3f, %llu, %llu, %llu, %.1f, %.1f",
+            (unsigned long long)profile->wall_time, (unsigned long long)profile->cpu_time,
+            (unsigned long long)profile->virtual_time, speed_ratio,
+            (unsigned long long)profile->nb_qlogs, (unsigned long long)profile->nb_events,
+            (unsigned long long)profile->nb_packets, events_per_second, packets_per_second);
+        for (int i = 0; i < pico_sim_phase_max; i++) {
+            fprintf(F, ", %llu", (unsigned long long)profile->phase_time[i]);
+        }
+        fprintf(F, ", %llu, %llu, %llu, %llu, %llu, %llu", (unsigned long long)profile->spec_bytes,
+            (unsigned long long)profile->memory_peak, (unsigned long long)simulation_bytes,
+            (unsigned long long)bytes_per_connection, (unsigned long long)profile->max_bytes_in_flight,
+            (unsigned long long)max_packets_in_flight);
+        fprintf(F, "\n");
+        (void)picoquic_file_close(F);
+    }
+    return ret;
+}
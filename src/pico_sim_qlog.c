@@ -0,0 +1,952 @@
+/* Streaming scanner for picoquic qlog files.
+* The qlog files are JSON documents with a list of traces. Each trace
+* has an "event_fields" list, giving the order of the fields in each
+* event, "common_fields" with the reference time, and the "events"
+* list, in which each event is a JSON array. Events written as JSON
+* objects, with "time", "name" and "data" members, are also accepted.
+ */
+
+#if !defined(_WINDOWS) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifndef _WINDOWS
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+#ifdef PICO_SIM_ZLIB
+#include <zlib.h>
+#endif
+#include "pico_sim_qlog.h"
+
+typedef enum {
+    qlog_field_time = 0,
+    qlog_field_path_id,
+    qlog_field_category,
+    qlog_field_event,
+    qlog_field_data,
+    qlog_field_other
+} qlog_field_enum;
+
+#define QLOG_FIELDS_MAX 16
+
+typedef struct st_qlog_parser_t {
+    char const* p;
+    char const* end;
+    pico_sim_qlog_event_fn event_fn;
+    void* ctx;
+    uint64_t reference_time;
+    size_t nb_fields;
+    qlog_field_enum fields[QLOG_FIELDS_MAX];
+} qlog_parser_t;
+
+static int qlog_is_space(char c)
+{
+    return (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+}
+
+static void qlog_skip_space(qlog_parser_t* q)
+{
+    while (q->p < q->end && qlog_is_space(*q->p)) {
+        q->p++;
+    }
+}
+
+/* Check and skip the next significant character */
+static int qlog_expect(qlog_parser_t* q, char c)
+{
+    int ret = -1;
+
+    qlog_skip_space(q);
+    if (q->p < q->end && *q->p == c) {
+        q->p++;
+        ret = 0;
+    }
+    return ret;
+}
+
+/* Check whether the next element is the end of an object or array,
+ * or skip the comma before the next element. */
+static int qlog_next_element(qlog_parser_t* q, char closing, int is_first, int* is_last)
+{
+    int ret = 0;
+
+    qlog_skip_space(q);
+    *is_last = 0;
+    if (q->p >= q->end) {
+        ret = -1;
+    }
+    else if (*q->p == closing) {
+        q->p++;
+        *is_last = 1;
+    }
+    else if (!is_first) {
+        ret = qlog_expect(q, ',');
+    }
+    return ret;
+}
+
+/* Return the raw content of a string, without the quotes.
+ * Escape sequences are left as is. */
+static int qlog_string(qlog_parser_t* q, char const** s, size_t* len)
+{
+    int ret = qlog_expect(q, '"');
+
+    if (ret == 0) {
+        char const* start = q->p;
+        while (q->p < q->end && *q->p != '"') {
+            if (*q->p == '\\') {
+                q->p++;
+            }
+            q->p++;
+        }
+        if (q->p >= q->end) {
+            ret = -1;
+        }
+        else {
+            *s = start;
+            *len = q->p - start;
+            q->p++;
+        }
+    }
+    return ret;
+}
+
+/* Skip a value of any type. Objects and arrays are skipped by counting
+ * the nesting depth, without recursion. */
+static int qlog_skip_value(qlog_parser_t* q)
+{
+    int ret = 0;
+    int depth = 0;
+
+    qlog_skip_space(q);
+    do {
+        if (q->p >= q->end) {
+            ret = -1;
+        }
+        else if (*q->p == '"') {
+            char const* s;
+            size_t len;
+            ret = qlog_string(q, &s, &len);
+        }
+        else {
+            if (*q->p == '{' || *q->p == '[') {
+                depth++;
+            }
+            else if (*q->p == '}' || *q->p == ']') {
+                depth--;
+            }
+            else if (depth == 0) {
+                /* number or literal */
+                while (q->p < q->end && *q->p != ',' && *q->p != '}' && *q->p != ']' && !qlog_is_space(*q->p)) {
+                    q->p++;
+                }
+                break;
+            }
+            q->p++;
+        }
+    } while (ret == 0 && depth > 0);
+
+    return ret;
+}
+
+/* Get the raw text of the next value */
+static int qlog_value(qlog_parser_t* q, char const** v, size_t* len)
+{
+    int ret;
+
+    qlog_skip_space(q);
+    *v = q->p;
+    ret = qlog_skip_value(q);
+    *len = q->p - *v;
+    return ret;
+}
+
+int pico_sim_qlog_is(char const* text, size_t len, char const* name)
+{
+    size_t l = strlen(name);
+    return (l == len && memcmp(text, name, len) == 0);
+}
+
+uint64_t pico_sim_qlog_u64(char const* value, size_t value_len)
+{
+    uint64_t v = 0;
+    size_t i = 0;
+
+    if (i < value_len && value[i] == '"') {
+        i++;
+    }
+    while (i < value_len && value[i] >= '0' && value[i] <= '9') {
+        v *= 10;
+        v += value[i] - '0';
+        i++;
+    }
+    return v;
+}
+
+int pico_sim_qlog_members(char const* data, size_t data_len, pico_sim_qlog_member_fn member_fn, void* ctx)
+{
+    qlog_parser_t q = { 0 };
+    int ret;
+    int is_last = 0;
+
+    q.p = data;
+    q.end = data + data_len;
+    ret = qlog_expect(&q, '{');
+    for (int is_first = 1; ret == 0; is_first = 0) {
+        char const* name;
+        size_t name_len;
+        char const* value;
+        size_t value_len;
+
+        if ((ret = qlog_next_element(&q, '}', is_first, &is_last)) != 0 || is_last) {
+            break;
+        }
+        if ((ret = qlog_string(&q, &name, &name_len)) == 0 &&
+            (ret = qlog_expect(&q, ':')) == 0 &&
+            (ret = qlog_value(&q, &value, &value_len)) == 0) {
+            ret = member_fn(ctx, name, name_len, value, value_len);
+        }
+    }
+    return ret;
+}
+
+int pico_sim_qlog_elements(char const* data, size_t data_len, pico_sim_qlog_element_fn element_fn, void* ctx)
+{
+    qlog_parser_t q = { 0 };
+    int ret;
+    int is_last = 0;
+
+    q.p = data;
+    q.end = data + data_len;
+    ret = qlog_expect(&q, '[');
+    for (int is_first = 1; ret == 0; is_first = 0) {
+        char const* value;
+        size_t value_len;
+
+        if ((ret = qlog_next_element(&q, ']', is_first, &is_last)) != 0 || is_last) {
+            break;
+        }
+        if ((ret = qlog_value(&q, &value, &value_len)) == 0) {
+            ret = element_fn(ctx, value, value_len);
+        }
+    }
+    return ret;
+}
+
+static int qlog_event_fields(qlog_parser_t* q)
+{
+    int ret = qlog_expect(q, '[');
+    int is_last = 0;
+
+    q->nb_fields = 0;
+    for (int is_first = 1; ret == 0; is_first = 0) {
+        char const* s;
+        size_t len;
+        qlog_field_enum f = qlog_field_other;
+
+        if ((ret = qlog_next_element(q, ']', is_first, &is_last)) != 0 || is_last ||
+            (ret = qlog_string(q, &s, &len)) != 0) {
+            break;
+        }
+        if (pico_sim_qlog_is(s, len, "relative_time") || pico_sim_qlog_is(s, len, "time")) {
+            f = qlog_field_time;
+        }
+        else if (pico_sim_qlog_is(s, len, "path_id")) {
+            f = qlog_field_path_id;
+        }
+        else if (pico_sim_qlog_is(s, len, "category")) {
+            f = qlog_field_category;
+        }
+        else if (pico_sim_qlog_is(s, len, "event")) {
+            f = qlog_field_event;
+        }
+        else if (pico_sim_qlog_is(s, len, "data")) {
+            f = qlog_field_data;
+        }
+        if (q->nb_fields < QLOG_FIELDS_MAX) {
+            q->fields[q->nb_fields++] = f;
+        }
+    }
+    return ret;
+}
+
+static int qlog_common_member(void* ctx, char const* name, size_t name_len, char const* value, size_t value_len)
+{
+    if (pico_sim_qlog_is(name, name_len, "reference_time")) {
+        ((qlog_parser_t*)ctx)->reference_time = pico_sim_qlog_u64(value, value_len);
+    }
+    return 0;
+}
+
+/* Event in array format, following the order of "event_fields" */
+static int qlog_event_array(qlog_parser_t* q, pico_sim_qlog_event_t* ev)
+{
+    int ret = qlog_expect(q, '[');
+    int is_last = 0;
+
+    for (size_t i = 0; ret == 0; i++) {
+        qlog_field_enum f = (i < q->nb_fields) ? q->fields[i] : qlog_field_other;
+        char const* v;
+        size_t len;
+
+        if ((ret = qlog_next_element(q, ']', i == 0, &is_last)) != 0 || is_last) {
+            break;
+        }
+        if (f == qlog_field_category) {
+            ret = qlog_string(q, &ev->category, &ev->category_len);
+        }
+        else if (f == qlog_field_event) {
+            ret = qlog_string(q, &ev->event, &ev->event_len);
+        }
+        else if ((ret = qlog_value(q, &v, &len)) == 0) {
+            if (f == qlog_field_time) {
+                ev->event_time = pico_sim_qlog_u64(v, len) + q->reference_time;
+            }
+            else if (f == qlog_field_path_id) {
+                ev->path_id = pico_sim_qlog_u64(v, len);
+            }
+            else if (f == qlog_field_data) {
+                ev->data = v;
+                ev->data_len = len;
+            }
+        }
+    }
+    return ret;
+}
+
+/* Event in object format, e.g., { "time": 0, "name": "recovery:metrics_updated", "data": {} } */
+static int qlog_event_member(void* ctx, char const* name, size_t name_len, char const* value, size_t value_len)
+{
+    pico_sim_qlog_event_t* ev = (pico_sim_qlog_event_t*)ctx;
+
+    if (pico_sim_qlog_is(name, name_len, "time") || pico_sim_qlog_is(name, name_len, "relative_time")) {
+        ev->event_time += pico_sim_qlog_u64(value, value_len);
+    }
+    else if (pico_sim_qlog_is(name, name_len, "path_id")) {
+        ev->path_id = pico_sim_qlog_u64(value, value_len);
+    }
+    else if (pico_sim_qlog_is(name, name_len, "data")) {
+        ev->data = value;
+        ev->data_len = value_len;
+    }
+    else if (value_len >= 2 && value[0] == '"') {
+        if (pico_sim_qlog_is(name, name_len, "category")) {
+            ev->category = value + 1;
+            ev->category_len = value_len - 2;
+        }
+        else if (pico_sim_qlog_is(name, name_len, "event")) {
+            ev->event = value + 1;
+            ev->event_len = value_len - 2;
+        }
+        else if (pico_sim_qlog_is(name, name_len, "name")) {
+            char const* colon = memchr(value + 1, ':', value_len - 2);
+            if (colon != NULL) {
+                ev->category = value + 1;
+                ev->category_len = colon - ev->category;
+                ev->event = colon + 1;
+                ev->event_len = value + value_len - 1 - ev->event;
+            }
+            else {
+                ev->event = value + 1;
+                ev->event_len = value_len - 2;
+            }
+        }
+    }
+    return 0;
+}
+
+static int qlog_events(qlog_parser_t* q)
+{
+    int ret = qlog_expect(q, '[');
+    int is_last = 0;
+
+    for (int is_first = 1; ret == 0; is_first = 0) {
+        pico_sim_qlog_event_t ev;
+
+        if ((ret = qlog_next_element(q, ']', is_first, &is_last)) != 0 || is_last) {
+            break;
+        }
+        memset(&ev, 0, sizeof(ev));
+        qlog_skip_space(q);
+        ev.raw = q->p;
+        if (q->p < q->end && *q->p == '{') {
+            char const* v;
+            size_t len;
+            ev.event_time = q->reference_time;
+            if ((ret = qlog_value(q, &v, &len)) == 0) {
+                ret = pico_sim_qlog_members(v, len, qlog_event_member, &ev);
+            }
+        }
+        else {
+            ret = qlog_event_array(q, &ev);
+        }
+        if (ret == 0) {
+            ev.raw_len = q->p - ev.raw;
+            ret = q->event_fn(q->ctx, &ev);
+        }
+    }
+    return ret;
+}
+
+static int qlog_trace(qlog_parser_t* q)
+{
+    int ret = qlog_expect(q, '{');
+    int is_last = 0;
+
+    /* Default event fields, if "event_fields" is not present */
+    q->reference_time = 0;
+    q->nb_fields = 4;
+    q->fields[0] = qlog_field_time;
+    q->fields[1] = qlog_field_category;
+    q->fields[2] = qlog_field_event;
+    q->fields[3] = qlog_field_data;
+
+    for (int is_first = 1; ret == 0; is_first = 0) {
+        char const* name;
+        size_t name_len;
+
+        if ((ret = qlog_next_element(q, '}', is_first, &is_last)) != 0 || is_last ||
+            (ret = qlog_string(q, &name, &name_len)) != 0 ||
+            (ret = qlog_expect(q, ':')) != 0) {
+            break;
+        }
+        if (pico_sim_qlog_is(name, name_len, "event_fields")) {
+            ret = qlog_event_fields(q);
+        }
+        else if (pico_sim_qlog_is(name, name_len, "common_fields")) {
+            char const* v;
+            size_t len;
+            if ((ret = qlog_value(q, &v, &len)) == 0) {
+                ret = pico_sim_qlog_members(v, len, qlog_common_member, q);
+            }
+        }
+        else if (pico_sim_qlog_is(name, name_len, "events")) {
+            ret = qlog_events(q);
+        }
+        else {
+            ret = qlog_skip_value(q);
+        }
+    }
+    return ret;
+}
+
+int pico_sim_qlog_scan_text(char const* text, size_t text_len, pico_sim_qlog_event_fn event_fn, void* ctx)
+{
+    qlog_parser_t q = { 0 };
+    int ret;
+    int is_last = 0;
+
+    q.p = text;
+    q.end = text + text_len;
+    q.event_fn = event_fn;
+    q.ctx = ctx;
+
+    ret = qlog_expect(&q, '{');
+    for (int is_first = 1; ret == 0; is_first = 0) {
+        char const* name;
+        size_t name_len;
+
+        if ((ret = qlog_next_element(&q, '}', is_first, &is_last)) != 0 || is_last ||
+            (ret = qlog_string(&q, &name, &name_len)) != 0 ||
+            (ret = qlog_expect(&q, ':')) != 0) {
+            break;
+        }
+        if (pico_sim_qlog_is(name, name_len, "traces")) {
+            ret = qlog_expect(&q, '[');
+            for (int is_first_trace = 1; ret == 0; is_first_trace = 0) {
+                if ((ret = qlog_next_element(&q, ']', is_first_trace, &is_last)) != 0 || is_last) {
+                    break;
+                }
+                ret = qlog_trace(&q);
+            }
+        }
+        else {
+            ret = qlog_skip_value(&q);
+        }
+    }
+    return ret;
+}
+
+/* Map the qlog file in memory, or read it on Windows */
+typedef struct st_qlog_text_t {
+    char const* text;
+    size_t text_len;
+#ifdef _WINDOWS
+    char* buffer;
+#else
+    int fd;
+#endif
+} qlog_text_t;
+
+static int qlog_load(char const* file_name, qlog_text_t* t)
+{
+    int ret = 0;
+#ifdef _WINDOWS
+    FILE* F = NULL;
+    long text_len = 0;
+
+    memset(t, 0, sizeof(qlog_text_t));
+    if (fopen_s(&F, file_name, "rb") != 0 || F == NULL) {
+        ret = -1;
+    }
+    else {
+        if (fseek(F, 0, SEEK_END) != 0 || (text_len = ftell(F)) <= 0 || fseek(F, 0, SEEK_SET) != 0 ||
+            (t->buffer = (char*)malloc((size_t)text_len)) == NULL ||
+            fread(t->buffer, 1, (size_t)text_len, F) != (size_t)text_len) {
+            ret = -1;
+        }
+        else {
+            t->text = t->buffer;
+            t->text_len = (size_t)text_len;
+        }
+        fclose(F);
+    }
+#else
+    struct stat st;
+
+    memset(t, 0, sizeof(qlog_text_t));
+    if ((t->fd = open(file_name, O_RDONLY)) < 0) {
+        ret = -1;
+    }
+    else if (fstat(t->fd, &st) != 0 || st.st_size <= 0) {
+        ret = -1;
+    }
+    else {
+        void* text = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, t->fd, 0);
+        if (text == MAP_FAILED) {
+            ret = -1;
+        }
+        else {
+            (void)posix_madvise(text, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+            t->text = (char const*)text;
+            t->text_len = (size_t)st.st_size;
+        }
+    }
+#endif
+    return ret;
+}
+
+static void qlog_unload(qlog_text_t* t)
+{
+#ifdef _WINDOWS
+    if (t->buffer != NULL) {
+        free(t->buffer);
+    }
+#else
+    if (t->text != NULL) {
+        munmap((void*)t->text, t->text_len);
+    }
+    if (t->fd >= 0) {
+        close(t->fd);
+    }
+#endif
+    memset(t, 0, sizeof(qlog_text_t));
+}
+
+int pico_sim_qlog_scan(char const* file_name, pico_sim_qlog_event_fn event_fn, void* ctx)
+{
+    qlog_text_t t;
+    int ret = qlog_load(file_name, &t);
+
+    if (ret == 0) {
+        ret = pico_sim_qlog_scan_text(t.text, t.text_len, event_fn, ctx);
+    }
+    qlog_unload(&t);
+    return ret;
+}
+
+/* Filtering copies the text of the qlog, skipping the events that are not
+ * kept. The text between two events is copied if it is not just a comma,
+ * e.g., the start of the "events" array, or the end of a trace and the
+ * start of the next one.
+ */
+typedef struct st_qlog_filter_t {
+    FILE* F;
+    char const* last_end;
+    int is_first_in_array;
+    pico_sim_qlog_filter_fn filter_fn;
+    void* ctx;
+} qlog_filter_t;
+
+static int qlog_filter_event(void* ctx, pico_sim_qlog_event_t const* ev)
+{
+    int ret = 0;
+    qlog_filter_t* filter = (qlog_filter_t*)ctx;
+    char const* data = NULL;
+    size_t data_len = 0;
+    int is_separator = 1;
+
+    for (char const* x = filter->last_end; x < ev->raw; x++) {
+        if (*x != ',' && !qlog_is_space(*x)) {
+            is_separator = 0;
+            break;
+        }
+    }
+    if (!is_separator) {
+        (void)fwrite(filter->last_end, 1, ev->raw - filter->last_end, filter->F);
+        filter->is_first_in_array = 1;
+    }
+    filter->last_end = ev->raw + ev->raw_len;
+
+    if ((ret = filter->filter_fn(filter->ctx, ev, &data, &data_len)) > 0) {
+        ret = 0;
+        if (!filter->is_first_in_array) {
+            fputs(",\n", filter->F);
+        }
+        filter->is_first_in_array = 0;
+        if (data != NULL && ev->data != NULL) {
+            /* Replace the data of the event */
+            (void)fwrite(ev->raw, 1, ev->data - ev->raw, filter->F);
+            (void)fwrite(data, 1, data_len, filter->F);
+            (void)fwrite(ev->data + ev->data_len, 1, ev->raw + ev->raw_len - ev->data - ev->data_len, filter->F);
+        }
+        else {
+            (void)fwrite(ev->raw, 1, ev->raw_len, filter->F);
+        }
+    }
+    return ret;
+}
+
+int pico_sim_qlog_filter(char const* file_name, pico_sim_qlog_filter_fn filter_fn, void* ctx)
+{
+    qlog_text_t t;
+    qlog_filter_t filter = { 0 };
+    char filtered_name[1024];
+    int ret = 0;
+
+    (void)snprintf(filtered_name, sizeof(filtered_name), "%s.filtered", file_name);
+    filter.filter_fn = filter_fn;
+    filter.ctx = ctx;
+
+    if ((ret = qlog_load(file_name, &t)) == 0) {
+#ifdef _WINDOWS
+        if (fopen_s(&filter.F, filtered_name, "wb") != 0) {
+            filter.F = NULL;
+        }
+#else
+        filter.F = fopen(filtered_name, "wb");
+#endif
+        if (filter.F == NULL) {
+            ret = -1;
+        }
+        else {
+            filter.last_end = t.text;
+            if ((ret = pico_sim_qlog_scan_text(t.text, t.text_len, qlog_filter_event, &filter)) == 0) {
+                (void)fwrite(filter.last_end, 1, t.text + t.text_len - filter.last_end, filter.F);
+            }
+            if (ferror(filter.F)) {
+                ret = -1;
+            }
+            if (fclose(filter.F) != 0) {
+                ret = -1;
+            }
+        }
+    }
+    qlog_unload(&t);
+
+    if (ret == 0) {
+#ifdef _WINDOWS
+        (void)remove(file_name);
+#endif
+        if (rename(filtered_name, file_name) != 0) {
+            ret = -1;
+        }
+    }
+    if (ret != 0) {
+        (void)remove(filtered_name);
+    }
+    return ret;
+}
+
+/* Segmentation writes the events of a qlog to several files, each starting
+ * with the text of the qlog before the first event and ending with the text
+ * after the last event, so that each segment is a complete qlog with the
+ * same reference time. A first pass finds the end of the last event, and
+ * checks that the qlog has a single trace, as written by picoquic.
+ */
+typedef struct st_qlog_out_t {
+    FILE* F;
+#ifdef PICO_SIM_ZLIB
+    gzFile gz;
+#endif
+} qlog_out_t;
+
+typedef struct st_qlog_segment_t {
+    char const* text;
+    char const* first_raw;
+    char const* last_end;
+    char const* footer;
+    size_t footer_len;
+    char const* name_base;
+    uint64_t segment_time;
+    uint64_t segment_size;
+    int do_compress;
+    qlog_out_t out;
+    int is_open;
+    int is_first_in_segment;
+    size_t nb_segments;
+    uint64_t first_time;
+    uint64_t segment_end_time;
+    uint64_t segment_bytes;
+} qlog_segment_t;
+
+static int qlog_out_open(qlog_out_t* out, char const* name, int do_compress)
+{
+    int ret = 0;
+
+    memset(out, 0, sizeof(qlog_out_t));
+    if (do_compress) {
+#ifdef PICO_SIM_ZLIB
+        if ((out->gz = gzopen(name, "wb")) == NULL) {
+            ret = -1;
+        }
+#else
+        ret = -1;
+#endif
+    }
+    else {
+#ifdef _WINDOWS
+        if (fopen_s(&out->F, name, "wb") != 0) {
+            out->F = NULL;
+        }
+#else
+        out->F = fopen(name, "wb");
+#endif
+        if (out->F == NULL) {
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+static int qlog_out_write(qlog_out_t* out, char const* text, size_t len)
+{
+    int ret = 0;
+
+#ifdef PICO_SIM_ZLIB
+    if (out->gz != NULL) {
+        if (len > 0 && gzwrite(out->gz, text, (unsigned int)len) != (int)len) {
+            ret = -1;
+        }
+    }
+    else
+#endif
+    if (fwrite(text, 1, len, out->F) != len) {
+        ret = -1;
+    }
+    return ret;
+}
+
+static int qlog_out_close(qlog_out_t* out)
+{
+    int ret = 0;
+
+#ifdef PICO_SIM_ZLIB
+    if (out->gz != NULL) {
+        ret = (gzclose(out->gz) == Z_OK) ? 0 : -1;
+    }
+    else
+#endif
+    if (out->F != NULL && fclose(out->F) != 0) {
+        ret = -1;
+    }
+    memset(out, 0, sizeof(qlog_out_t));
+    return ret;
+}
+
+static void qlog_segment_name(char* name, size_t name_size, qlog_segment_t const* seg, size_t segment)
+{
+    (void)snprintf(name, name_size, "%s_%zu.qlog%s", seg->name_base, segment, (seg->do_compress) ? ".gz" : "");
+}
+
+static int qlog_segment_first_pass(void* ctx, pico_sim_qlog_event_t const* ev)
+{
+    int ret = 0;
+    qlog_segment_t* seg = (qlog_segment_t*)ctx;
+
+    if (seg->first_raw == NULL) {
+        seg->first_raw = ev->raw;
+        seg->first_time = ev->event_time;
+    }
+    else {
+        for (char const* x = seg->last_end; x < ev->raw; x++) {
+            if (*x != ',' && !qlog_is_space(*x)) {
+                /* Several traces in the same qlog */
+                ret = -1;
+                break;
+            }
+        }
+    }
+    seg->last_end = ev->raw + ev->raw_len;
+    return ret;
+}
+
+static int qlog_segment_close(qlog_segment_t* seg)
+{
+    int ret = 0;
+
+    if (seg->is_open) {
+        ret = qlog_out_write(&seg->out, seg->footer, seg->footer_len);
+        if (qlog_out_close(&seg->out) != 0) {
+            ret = -1;
+        }
+        seg->is_open = 0;
+    }
+    return ret;
+}
+
+static int qlog_segment_event(void* ctx, pico_sim_qlog_event_t const* ev)
+{
+    int ret = 0;
+    qlog_segment_t* seg = (qlog_segment_t*)ctx;
+
+    if (seg->is_open &&
+        ((seg->segment_time > 0 && ev->event_time >= seg->segment_end_time) ||
+        (seg->segment_size > 0 && seg->segment_bytes + ev->raw_len > seg->segment_size))) {
+        ret = qlog_segment_close(seg);
+    }
+    if (ret == 0 && !seg->is_open) {
+        char name[1024];
+
+        qlog_segment_name(name, sizeof(name), seg, seg->nb_segments);
+        if ((ret = qlog_out_open(&seg->out, name, seg->do_compress)) == 0) {
+            seg->is_open = 1;
+            seg->is_first_in_segment = 1;
+            seg->nb_segments++;
+            seg->segment_bytes = 0;
+            if (seg->segment_time > 0) {
+                /* Segments are aligned on multiples of the segment time, empty ones are skipped */
+                seg->segment_end_time = seg->first_time +
+                    ((ev->event_time - seg->first_time) / seg->segment_time + 1) * seg->segment_time;
+            }
+            ret = qlog_out_write(&seg->out, seg->text, seg->first_raw - seg->text);
+        }
+    }
+    if (ret == 0) {
+        if (!seg->is_first_in_segment) {
+            ret = qlog_out_write(&seg->out, ",\n", 2);
+        }
+        seg->is_first_in_segment = 0;
+        if (ret == 0) {
+            ret = qlog_out_write(&seg->out, ev->raw, ev->raw_len);
+        }
+        seg->segment_bytes += ev->raw_len;
+    }
+    return ret;
+}
+
+void pico_sim_qlog_segment_name(char* name, size_t name_size, char const* file_name, size_t segment, int do_compress)
+{
+    size_t len = strlen(file_name);
+
+    if (len > 5 && strcmp(file_name + len - 5, ".qlog") == 0) {
+        len -= 5;
+    }
+    (void)snprintf(name, name_size, "%.*s_%zu.qlog%s", (int)len, file_name, segment, (do_compress) ? ".gz" : "");
+}
+
+int pico_sim_qlog_segment(char const* file_name, uint64_t segment_time, uint64_t segment_size,
+    int do_compress, size_t* nb_segments)
+{
+    qlog_text_t t;
+    qlog_segment_t seg = { 0 };
+    char name_base[1024];
+    size_t len = strlen(file_name);
+    int ret = 0;
+
+    (void)snprintf(name_base, sizeof(name_base), "%s", file_name);
+    if (len > 5 && len < sizeof(name_base) && strcmp(name_base + len - 5, ".qlog") == 0) {
+        name_base[len - 5] = 0;
+    }
+    seg.name_base = name_base;
+    seg.segment_time = segment_time;
+    seg.segment_size = segment_size;
+    seg.do_compress = do_compress;
+
+    if (len >= sizeof(name_base)) {
+        ret = -1;
+    }
+    else {
+        if ((ret = qlog_load(file_name, &t)) == 0) {
+            seg.text = t.text;
+            seg.last_end = t.text;
+            if ((ret = pico_sim_qlog_scan_text(t.text, t.text_len, qlog_segment_first_pass, &seg)) == 0 &&
+                seg.first_raw != NULL) {
+                seg.footer = seg.last_end;
+                seg.footer_len = t.text + t.text_len - seg.last_end;
+                ret = pico_sim_qlog_scan_text(t.text, t.text_len, qlog_segment_event, &seg);
+                if (qlog_segment_close(&seg) != 0) {
+                    ret = -1;
+                }
+            }
+        }
+        qlog_unload(&t);
+    }
+
+    if (ret == 0 && seg.nb_segments > 0) {
+        ret = remove(file_name);
+    }
+    else {
+        /* Keep the original qlog, remove the partial segments */
+        for (size_t i = 0; i < seg.nb_segments; i++) {
+            char name[1024];
+            qlog_segment_name(name, sizeof(name), &seg, i);
+            (void)remove(name);
+        }
+        seg.nb_segments = 0;
+    }
+    *nb_segments = seg.nb_segments;
+    return ret;
+}
+
+static int cc_state_member(void* ctx, char const* name, size_t name_len, char const* value, size_t value_len)
+{
+    pico_sim_cc_state_t* cc_state = (pico_sim_cc_state_t*)ctx;
+    uint64_t v = pico_sim_qlog_u64(value, value_len);
+
+    if (pico_sim_qlog_is(name, name_len, "cwnd")) {
+        cc_state->cwnd = v;
+    }
+    else if (pico_sim_qlog_is(name, name_len, "bytes_in_flight")) {
+        cc_state->bytes_in_flight = v;
+    }
+    else if (pico_sim_qlog_is(name, name_len, "pacing_rate")) {
+        cc_state->pacing_rate = v;
+    }
+    else if (pico_sim_qlog_is(name, name_len, "smoothed_rtt")) {
+        cc_state->smoothed_rtt = v;
+    }
+    else if (pico_sim_qlog_is(name, name_len, "min_rtt")) {
+        cc_state->min_rtt = v;
+    }
+    else if (pico_sim_qlog_is(name, name_len, "latest_rtt")) {
+        cc_state->latest_rtt = v;
+    }
+    else if (pico_sim_qlog_is(name, name_len, "app_limited")) {
+        cc_state->app_limited = v;
+    }
+    return 0;
+}
+
+int pico_sim_cc_update(pico_sim_cc_state_t* cc_state, pico_sim_qlog_event_t const* ev)
+{
+    int is_updated = 0;
+
+    if (pico_sim_qlog_is(ev->category, ev->category_len, "recovery") &&
+        pico_sim_qlog_is(ev->event, ev->event_len, "metrics_updated")) {
+        cc_state->event_time = ev->event_time;
+        if (ev->data != NULL) {
+            (void)pico_sim_qlog_members(ev->data, ev->data_len, cc_state_member, cc_state);
+        }
+        is_updated = 1;
+    }
+    return is_updated;
+}
@@ -0,0 +1,88 @@
+/* Streaming scanner for the qlog files produced by picoquic.
+ * The file is mapped in memory and scanned in a single pass, without
+ * building a document tree. The scanner calls back for each event,
+ * passing the time, path, category, event name and the raw JSON text
+ * of the event data.
+ */
+
+#ifndef PICO_SIM_QLOG_H
+#define PICO_SIM_QLOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct st_pico_sim_qlog_event_t {
+    uint64_t event_time; /* relative time plus the reference time of the trace */
+    uint64_t path_id;
+    char const* category;
+    size_t category_len;
+    char const* event;
+    size_t event_len;
+    char const* data; /* JSON text of the data object */
+    size_t data_len;
+    char const* raw; /* JSON text of the whole event */
+    size_t raw_len;
+} pico_sim_qlog_event_t;
+
+typedef int (*pico_sim_qlog_event_fn)(void* ctx, pico_sim_qlog_event_t const* ev);
+typedef int (*pico_sim_qlog_member_fn)(void* ctx, char const* name, size_t name_len, char const* value, size_t value_len);
+typedef int (*pico_sim_qlog_element_fn)(void* ctx, char const* value, size_t value_len);
+
+/* Scan a qlog file. The scan stops if the callback returns a non
+ * zero value, which is then returned by the function. */
+int pico_sim_qlog_scan(char const* file_name, pico_sim_qlog_event_fn event_fn, void* ctx);
+/* Same, for a qlog already in memory. */
+int pico_sim_qlog_scan_text(char const* text, size_t text_len, pico_sim_qlog_event_fn event_fn, void* ctx);
+
+/* Filter a qlog file, keeping the events for which the callback returns
+ * a positive value, and dropping those for which it returns 0. The callback
+ * can replace the data of a kept event by setting "data". A negative value
+ * stops the filtering, and the file is left unchanged. */
+typedef int (*pico_sim_qlog_filter_fn)(void* ctx, pico_sim_qlog_event_t const* ev, char const** data, size_t* data_len);
+int pico_sim_qlog_filter(char const* file_name, pico_sim_qlog_filter_fn filter_fn, void* ctx);
+
+/* Split a qlog file in segments, "<name>_<n>.qlog", each a complete qlog,
+ * starting a new segment when the events reach segment_time microseconds
+ * of virtual time or segment_size bytes, or both, if not zero. With
+ * do_compress, the segments are written with gzip, as "<name>_<n>.qlog.gz".
+ * The original file is removed if all the segments were written. */
+int pico_sim_qlog_segment(char const* file_name, uint64_t segment_time, uint64_t segment_size,
+    int do_compress, size_t* nb_segments);
+/* Name of the segment number "segment" of the qlog file_name. */
+void pico_sim_qlog_segment_name(char* name, size_t name_size, char const* file_name, size_t segment, int do_compress);
+
+/* Iterate over the members of a JSON object, e.g., the event data. */
+int pico_sim_qlog_members(char const* data, size_t data_len, pico_sim_qlog_member_fn member_fn, void* ctx);
+/* Iterate over the elements of a JSON array, e.g., the frames of a packet. */
+int pico_sim_qlog_elements(char const* data, size_t data_len, pico_sim_qlog_element_fn element_fn, void* ctx);
+/* Compare a string found in the qlog with a name. */
+int pico_sim_qlog_is(char const* text, size_t len, char const* name);
+/* Parse a numeric value, which may be quoted. Decimals are truncated. */
+uint64_t pico_sim_qlog_u64(char const* value, size_t value_len);
+
+/* Congestion control state, updated by the "recovery/metrics_updated"
+ * events, as in cc_state in scripts/qlogparse.py. */
+typedef struct st_pico_sim_cc_state_t {
+    uint64_t event_time;
+    uint64_t cwnd;
+    uint64_t bytes_in_flight;
+    uint64_t pacing_rate;
+    uint64_t smoothed_rtt;
+    uint64_t min_rtt;
+    uint64_t latest_rtt;
+    uint64_t app_limited;
+} pico_sim_cc_state_t;
+
+/* Returns 1 if the event is "metrics_updated" and the state was updated,
+ * 0 if the event is not a metrics update. */
+int pico_sim_cc_update(pico_sim_cc_state_t* cc_state, pico_sim_qlog_event_t const* ev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PICO_SIM_QLOG_H */
@@ -0,0 +1,81 @@
+/* Queue presets of the bottleneck link.
+* The link model of picoquic_ns has a single drop tail queue, with two
+* controls: a limit on the queue delay, "queue_delay_max", and a threshold
+* above which the packets of L4S flows are marked CE, "l4s_max". Its queue
+* is part of the simulation, which pico_sim cannot change, so no active
+* queue management can run in it. The spec key "queue_preset" and the
+* letter "K" of the link segments only select named values of these two
+* controls:
+* - "short" limits the queue delay to 10 ms,
+* - "medium" limits the queue delay to 30 ms,
+* - "l4s" limits the queue delay to 30 ms, and marks the L4S flows above
+*   1 ms,
+* - "none" keeps the values of the spec.
+* A limit or threshold set explicitly in the spec or in the segment is kept.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "picoquic.h"
+#include "picoquic_utils.h"
+#include "pico_sim.h"
+
+typedef struct st_pico_sim_queue_preset_values_t {
+    pico_sim_queue_preset_enum preset;
+    char const* name;
+    uint64_t queue_delay_max;
+    uint64_t l4s_max;
+} pico_sim_queue_preset_values_t;
+
+static pico_sim_queue_preset_values_t const pico_sim_queue_presets[] = {
+    { pico_sim_queue_preset_none, "none", 0, 0 },
+    { pico_sim_queue_preset_short, "short", 10000, 0 },
+    { pico_sim_queue_preset_medium, "medium", 30000, 0 },
+    { pico_sim_queue_preset_l4s, "l4s", 30000, 1000 }
+};
+
+#define PICO_SIM_QUEUE_PRESETS_NB (sizeof(pico_sim_queue_presets) / sizeof(pico_sim_queue_preset_values_t))
+
+int pico_sim_queue_preset_parse(pico_sim_queue_preset_enum* preset, char const* val)
+{
+    int ret = -1;
+
+    for (size_t i = 0; i < PICO_SIM_QUEUE_PRESETS_NB; i++) {
+        if (strcmp(val, pico_sim_queue_presets[i].name) == 0) {
+            *preset = pico_sim_queue_presets[i].preset;
+            ret = 0;
+            break;
+        }
+    }
+    return ret;
+}
+
+void pico_sim_queue_preset_apply(pico_sim_queue_preset_enum preset, uint64_t* queue_delay_max, uint64_t* l4s_max)
+{
+    for (size_t i = 0; i < PICO_SIM_QUEUE_PRESETS_NB; i++) {
+        if (pico_sim_queue_presets[i].preset == preset) {
+            if (*queue_delay_max == 0) {
+                *queue_delay_max = pico_sim_queue_presets[i].queue_delay_max;
+            }
+            if (*l4s_max == 0) {
+                *l4s_max = pico_sim_queue_presets[i].l4s_max;
+            }
+            break;
+        }
+    }
+}
+
+/* Apply the preset of the spec to the link, and to the segments of the
+ * link scenario that do not set their own values. */
+void pico_sim_queue_preset_apply_spec(pico_sim_spec_t* spec)
+{
+    pico_sim_queue_preset_apply(spec->queue_preset, &spec->ns.queue_delay_max, &spec->ns.l4s_max);
+    if (spec->ns.link_scenario == link_scenario_none) {
+        for (size_t i = 0; i < spec->ns.vary_link_nb; i++) {
+            pico_sim_queue_preset_apply(spec->queue_preset, &spec->ns.vary_link_spec[i].queue_delay_max,
+                &spec->ns.vary_link_spec[i].l4s_max);
+        }
+    }
+}
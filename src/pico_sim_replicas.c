@@ -0,0 +1,109 @@
+/* Replicas of a simulation.
+* With "replicas: N" in the spec, each simulation runs N times, with a
+* different icid for each replica, so that the scenarios with jitter or
+* random losses can be compared on more than one sample. Each replica
+* writes its own summary, and the summaries of the replicas are
+* aggregated in "<name>_replicas.csv", with the mean, the standard
+* deviation and the 95% confidence interval of each metric.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "picoquic.h"
+#include "picoquic_utils.h"
+#include "pico_sim.h"
+
+/* Student's t for a 95% two sided interval, for 1 to 30 degrees of freedom */
+static const double pico_sim_replica_t95[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+/* Replica 0 runs with the icid of the spec. The other replicas flip the
+ * last two bytes of the icid with their number. */
+void pico_sim_replica_apply(pico_sim_spec_t* spec, size_t replica)
+{
+    picoquic_connection_id_t* icid = &spec->ns.icid;
+
+    if (replica > 0) {
+        if (icid->id_len < 8) {
+            memset(icid->id + icid->id_len, 0, 8 - icid->id_len);
+            icid->id_len = 8;
+        }
+        icid->id[icid->id_len - 2] ^= (uint8_t)(replica >> 8);
+        icid->id[icid->id_len - 1] ^= (uint8_t)(replica & 0xff);
+    }
+    if (spec->summary_format == pico_sim_summary_none) {
+        spec->summary_format = pico_sim_summary_csv;
+    }
+}
+
+int pico_sim_replicas_report(char const* name, char const** replica_names, size_t nb_replicas,
+    pico_sim_summary_format_enum summary_format, FILE* err_fd)
+{
+    int ret = 0;
+    char report_name[512];
+    double* values = NULL;
+    size_t nb_read = 0;
+    FILE* F;
+
+    if ((values = (double*)calloc(nb_replicas * PICO_SIM_SUMMARY_METRICS_NB, sizeof(double))) == NULL) {
+        ret = -1;
+    }
+    for (size_t r = 0; ret == 0 && r < nb_replicas; r++) {
+        if (pico_sim_summary_read(replica_names[r], summary_format, values + nb_read * PICO_SIM_SUMMARY_METRICS_NB) == 0) {
+            nb_read++;
+        }
+        else {
+            fprintf(err_fd, "No summary for replica <%s>\n", replica_names[r]);
+        }
+    }
+
+    (void)snprintf(report_name, sizeof(report_name), "%s_replicas.csv", name);
+    if (ret != 0 || nb_read == 0) {
+        ret = -1;
+    }
+    else if ((F = picoquic_file_open(report_name, "w")) == NULL) {
+        fprintf(err_fd, "Cannot create replicas report <%s>\n", report_name);
+        ret = -1;
+    }
+    else {
+        double t95 = (nb_read < 2) ? 0 :
+            ((nb_read - 1 <= sizeof(pico_sim_replica_t95) / sizeof(double)) ? pico_sim_replica_t95[nb_read - 2] : 1.96);
+
+        fprintf(F, "metric, nb_replicas, mean, stddev, ci95_low, ci95_high\n");
+        for (size_t i = 0; i < PICO_SIM_SUMMARY_METRICS_NB; i++) {
+            double sum = 0;
+            double sum_sq = 0;
+            double mean;
+            double stddev = 0;
+            double half_width;
+
+            for (size_t r = 0; r < nb_read; r++) {
+                sum += values[r * PICO_SIM_SUMMARY_METRICS_NB + i];
+            }
+            mean = sum / (double)nb_read;
+            for (size_t r = 0; r < nb_read; r++) {
+                double d = values[r * PICO_SIM_SUMMARY_METRICS_NB + i] - mean;
+                sum_sq += d * d;
+            }
+            if (nb_read > 1) {
+                stddev = sqrt(sum_sq / (double)(nb_read - 1));
+            }
+            half_width = t95 * stddev / sqrt((double)nb_read);
+            fprintf(F, "%s, %zu, %.6f, %.6f, %.6f, %.6f\n", pico_sim_summary_metric_names[i], nb_read,
+                mean, stddev, mean - half_width, mean + half_width);
+        }
+        (void)picoquic_file_close(F);
+        fprintf(err_fd, "Aggregate of %zu replicas written to <%s>\n", nb_read, report_name);
+    }
+
+    if (values != NULL) {
+        free(values);
+    }
+    return ret;
+}
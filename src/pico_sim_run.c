@@ -0,0 +1,274 @@
+/* Execution of a single simulation.
+* Runs the picoquic network simulation for the spec, then processes
+* the outputs as requested by the pico_sim options of the spec.
+ */
+
+#if !defined(_WINDOWS) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#ifdef _WINDOWS
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+#include "picoquic.h"
+#include "picoquic_ns.h"
+#include "picoquic_utils.h"
+#include "pico_sim.h"
+
+/* Remove the files of the run written in a temporary directory, and the directory. */
+static void pico_sim_run_remove_dir(char const* dir, pico_sim_run_files_t const* run_files, FILE* err_fd)
+{
+    for (size_t i = 0; i < run_files->nb_names; i++) {
+        (void)remove(run_files->names[i]);
+    }
+#ifdef _WINDOWS
+    if (_rmdir(dir) != 0) {
+#else
+    if (rmdir(dir) != 0) {
+#endif
+        fprintf(err_fd, "Cannot remove the temporary directory <%s>\n", dir);
+    }
+}
+
+/* Each simulation loads the test certificate and key of the picoquic
+ * source tree. Check once, before the runs, that they can be read, so that
+ * a wrong "-S" path fails immediately rather than in every run of a batch.
+ * Reading them here also brings them in the file cache for the runs.
+ */
+int pico_sim_check_solution_dir(char const* solution_dir, FILE* err_fd)
+{
+    int ret = 0;
+    char const* files[2] = { PICO_SIM_CERT_FILE, PICO_SIM_KEY_FILE };
+
+    for (int i = 0; ret == 0 && i < 2; i++) {
+        char file_name[512];
+        char buffer[1024];
+        FILE* F;
+
+        (void)snprintf(file_name, sizeof(file_name), "%s%s%s", solution_dir, PICO_SIM_PATH_SEP_STR, files[i]);
+        if ((F = picoquic_file_open(file_name, "rb")) == NULL) {
+            fprintf(err_fd, "Cannot read <%s>, set the picoquic source directory with -S\n", file_name);
+            ret = -1;
+        }
+        else {
+            while (fread(buffer, 1, sizeof(buffer), F) > 0) {
+                /* Only read the file */
+            }
+            (void)picoquic_file_close(F);
+        }
+    }
+    return ret;
+}
+
+int pico_sim_run_prepare(pico_sim_spec_t* spec, FILE* err_fd)
+{
+    int ret = 0;
+
+    /* Before the link trace, whose segments take the queue of the spec */
+    pico_sim_queue_preset_apply_spec(spec);
+
+    if (spec->link_trace_file != NULL) {
+        ret = pico_sim_link_trace_load(spec, err_fd);
+    }
+
+    if (ret == 0 && (spec->cross_traffic != NULL || spec->cross_traffic_trace != NULL)) {
+        /* After the link trace, whose capacity the cross traffic shares */
+        ret = pico_sim_cross_apply(spec, err_fd);
+    }
+    return ret;
+}
+
+int pico_sim_run(pico_sim_spec_t* spec, char const* name, FILE* err_fd)
+{
+    int ret = 0;
+    uint64_t run_start = picoquic_current_time();
+    uint64_t phase_start = run_start;
+    clock_t cpu_start = clock();
+    pico_sim_profile_t profile = { 0 };
+    char tmp_dir[512];
+    int is_tmp_dir = 0;
+    pico_sim_cache_entry_t cache_entry = { 0 };
+    int is_cached = 0;
+    pico_sim_run_files_t run_files = { 0 };
+    int verdict = 0;
+
+    if (pico_sim_expect_is_set(&spec->expect) && spec->result == NULL &&
+        spec->summary_format == pico_sim_summary_none) {
+        /* The expectations are checked on the summary, which is also restored from the cache */
+        spec->summary_format = pico_sim_summary_csv;
+    }
+
+    ret = pico_sim_run_prepare(spec, err_fd);
+
+    if (ret == 0 && spec->cache_dir != NULL) {
+        /* The key includes the link segments, so the trace is loaded first */
+        ret = pico_sim_cache_lookup(spec, name, &cache_entry, &is_cached, err_fd);
+        if (ret == 0 && is_cached) {
+            fprintf(err_fd, "picoquic_ns (%s) result restored from cache entry %s\n", name, cache_entry.key);
+        }
+    }
+
+    if (ret != 0 || is_cached) {
+        /* Nothing to simulate */
+    }
+    else if (spec->trace_format != pico_sim_trace_qlog && spec->ns.qlog_dir == NULL) {
+        fprintf(err_fd, "Binary trace of %s requires a qlog_dir.\n", name);
+        ret = -1;
+    }
+    else if ((spec->summary_format != pico_sim_summary_none || spec->result != NULL || spec->metrics_bin_interval > 0) &&
+        spec->ns.qlog_dir == NULL) {
+        /* The summary and the bins are computed from the qlogs, which are only kept until then */
+        (void)snprintf(tmp_dir, sizeof(tmp_dir), "%s.qlog_tmp", name);
+        if (pico_sim_mkdir(tmp_dir) != 0) {
+            fprintf(err_fd, "Cannot create the temporary directory <%s>\n", tmp_dir);
+            ret = -1;
+        }
+        else {
+            spec->ns.qlog_dir = tmp_dir;
+            is_tmp_dir = 1;
+        }
+    }
+
+    if (ret == 0 && !is_cached) {
+        if (spec->do_profile) {
+            profile.spec_bytes = pico_sim_memory_spec(spec);
+            profile.nb_connections = spec->ns.nb_connections;
+            pico_sim_memory_reset_peak();
+            profile.memory_start = pico_sim_memory_current();
+        }
+        phase_start = picoquic_current_time();
+        if (spec->ns.qlog_dir == NULL) {
+            ret = picoquic_ns(&spec->ns, err_fd);
+        }
+        else if (pico_sim_run_files_open(&run_files, spec->ns.qlog_dir, name) != 0) {
+            fprintf(err_fd, "Cannot create the run directory of %s in <%s>\n", name, spec->ns.qlog_dir);
+            ret = -1;
+        }
+        else {
+            /* The qlogs of the run are written apart from those of other runs sharing the qlog_dir */
+            char const* qlog_dir = spec->ns.qlog_dir;
+
+            spec->ns.qlog_dir = run_files.run_dir;
+            ret = picoquic_ns(&spec->ns, err_fd);
+            spec->ns.qlog_dir = qlog_dir;
+            if (pico_sim_run_files_close(&run_files, qlog_dir) != 0) {
+                fprintf(err_fd, "Cannot move the qlogs of %s to <%s>\n", name, qlog_dir);
+                ret = -1;
+            }
+        }
+        profile.phase_time[pico_sim_phase_simulation] = picoquic_current_time() - phase_start;
+        profile.memory_peak = pico_sim_memory_peak();
+        /* Do not leave the heap of this simulation to the next one in the process */
+        pico_sim_memory_release();
+        fprintf(err_fd, "picoquic_ns (%s) returns %d\n", name, ret);
+    }
+
+    if (ret == 0 && !is_cached && spec->do_profile && spec->ns.qlog_dir != NULL) {
+        /* Counting the events is not part of the profiled phases */
+        uint64_t scan_start = picoquic_current_time();
+        if (pico_sim_profile_scan(&run_files, &profile) != 0) {
+            fprintf(err_fd, "Cannot count the events in <%s>\n", spec->ns.qlog_dir);
+        }
+        run_start += picoquic_current_time() - scan_start;
+    }
+
+    if (ret == 0 && !is_cached && spec->result != NULL) {
+        /* Results kept in memory for the embedding API, and written if a summary is also required */
+        phase_start = picoquic_current_time();
+        ret = pico_sim_summary_compute(&run_files, spec->result, 1, spec->nb_threads, err_fd);
+        if (ret == 0 && spec->summary_format != pico_sim_summary_none) {
+            ret = pico_sim_summary_write(name, spec->summary_format, spec->result, err_fd);
+        }
+        profile.phase_time[pico_sim_phase_summary] = picoquic_current_time() - phase_start;
+    }
+    else if (ret == 0 && !is_cached && spec->summary_format != pico_sim_summary_none) {
+        phase_start = picoquic_current_time();
+        ret = pico_sim_summary(&run_files, name, spec->summary_format, spec->nb_threads, err_fd);
+        profile.phase_time[pico_sim_phase_summary] = picoquic_current_time() - phase_start;
+    }
+
+    if (ret == 0 && !is_cached && spec->metrics_bin_interval > 0) {
+        /* Before the filter, so that the bins see all the metrics updates */
+        phase_start = picoquic_current_time();
+        ret = pico_sim_bins(&run_files, spec->metrics_bin_interval, name, err_fd);
+        profile.phase_time[pico_sim_phase_summary] += picoquic_current_time() - phase_start;
+    }
+
+    if (ret == 0 && !is_cached && !is_tmp_dir && spec->ns.qlog_dir != NULL &&
+        (spec->qlog_level != NULL || spec->qlog_sample_interval > 0)) {
+        phase_start = picoquic_current_time();
+        ret = pico_sim_filter(&run_files, spec->qlog_level, spec->qlog_sample_interval, spec->nb_threads, err_fd);
+        profile.phase_time[pico_sim_phase_filter] = picoquic_current_time() - phase_start;
+    }
+
+    if (ret == 0 && !is_cached && spec->trace_format != pico_sim_trace_qlog) {
+        phase_start = picoquic_current_time();
+        ret = pico_sim_trace_convert(spec->ns.qlog_dir, &run_files, spec->trace_format == pico_sim_trace_binary, err_fd);
+        profile.phase_time[pico_sim_phase_trace] = picoquic_current_time() - phase_start;
+    }
+
+    if (ret == 0 && !is_cached && !is_tmp_dir && spec->ns.qlog_dir != NULL &&
+        (spec->qlog_segment_time > 0 || spec->qlog_segment_size > 0 || spec->qlog_compress)) {
+        /* Last step on the qlogs, since the other steps only read complete qlogs,
+         * and before the cache, which stores the segments */
+        phase_start = picoquic_current_time();
+        ret = pico_sim_segment(&run_files, spec->qlog_segment_time,
+            spec->qlog_segment_size, spec->qlog_compress, spec->nb_threads, err_fd);
+        profile.phase_time[pico_sim_phase_filter] += picoquic_current_time() - phase_start;
+    }
+
+    if (ret == 0 && !is_cached && spec->cache_dir != NULL) {
+        /* Failing to store the result does not fail the run */
+        (void)pico_sim_cache_store(&cache_entry, spec, is_tmp_dir ? NULL : &run_files, name, err_fd);
+    }
+
+    if (ret == 0 && spec->ns.qperf_log != NULL) {
+        /* Also on a cache hit, since the qperf log is restored and the gates are not in the key */
+        phase_start = picoquic_current_time();
+        ret = pico_sim_media_report(spec, name, err_fd);
+        profile.phase_time[pico_sim_phase_summary] += picoquic_current_time() - phase_start;
+    }
+
+    if (ret == 0 && pico_sim_expect_is_set(&spec->expect)) {
+        double values[PICO_SIM_SUMMARY_METRICS_NB];
+
+        if (spec->result != NULL) {
+            pico_sim_summary_values(spec->result, spec->result->nb_cnx, values);
+        }
+        else if (pico_sim_summary_read(name, spec->summary_format, values) != 0) {
+            fprintf(err_fd, "Cannot read the summary of %s\n", name);
+            ret = -1;
+        }
+        if (ret == 0) {
+            /* A failed expectation fails the run, but does not stop the processing of its outputs */
+            verdict = pico_sim_expect_check(&spec->expect, values, name, err_fd);
+        }
+    }
+
+    if (is_tmp_dir) {
+        pico_sim_run_remove_dir(tmp_dir, &run_files, err_fd);
+        spec->ns.qlog_dir = NULL;
+    }
+
+    if (ret == 0 && !is_cached && spec->do_profile) {
+        profile.wall_time = picoquic_current_time() - run_start;
+        profile.cpu_time = (uint64_t)(((double)(clock() - cpu_start)) * 1000000.0 / CLOCKS_PER_SEC);
+        ret = pico_sim_profile_report(&profile, name, err_fd);
+    }
+
+    pico_sim_cache_release(&cache_entry);
+    pico_sim_run_files_release(&run_files);
+
+    if (ret == 0) {
+        ret = verdict;
+    }
+
+    return ret;
+}
@@ -0,0 +1,95 @@
+/* Qlog segmentation and compression.
+* Long simulations produce qlog files of several gigabytes, which the
+* analysis tools have to load in one piece. With "qlog_segment_time" or
+* "qlog_segment_size" in the spec, each qlog is split after the run in
+* segments of that many microseconds of virtual time or bytes, each of
+* them a complete qlog that can be loaded on its own. With
+* "qlog_compress: gzip", the segments are written with gzip.
+*
+* The qlog is mapped in memory and the segments are written as a stream,
+* so the memory used does not depend on the length of the run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "picoquic.h"
+#include "picoquic_utils.h"
+#include "pico_sim.h"
+#include "pico_sim_qlog.h"
+
+typedef struct st_pico_sim_segment_job_t {
+    char** names;
+    size_t* nb_segments;
+    uint64_t segment_time;
+    uint64_t segment_size;
+    int do_compress;
+} pico_sim_segment_job_t;
+
+/* Segment one qlog, possibly in parallel with the others */
+static int pico_sim_segment_one(void* ctx, size_t item, char* message, size_t message_size)
+{
+    int ret = 0;
+    pico_sim_segment_job_t* job = (pico_sim_segment_job_t*)ctx;
+    size_t nb_segments = 0;
+
+    if (pico_sim_qlog_segment(job->names[item], job->segment_time, job->segment_size, job->do_compress, &nb_segments) != 0) {
+        (void)snprintf(message, message_size, "Cannot segment qlog <%s>", job->names[item]);
+        ret = -1;
+    }
+    else {
+        (void)snprintf(message, message_size, "Qlog <%s>: %zu segments%s", job->names[item], nb_segments,
+            (job->do_compress) ? ", compressed" : "");
+    }
+    job->nb_segments[item] = nb_segments;
+    return ret;
+}
+
+int pico_sim_segment(pico_sim_run_files_t* run_files, uint64_t segment_time,
+    uint64_t segment_size, int do_compress, int nb_threads, FILE* err_fd)
+{
+    int ret = 0;
+    char** names = NULL;
+    size_t nb_names = 0;
+    size_t* nb_segments = NULL;
+    pico_sim_segment_job_t job;
+
+    if (pico_sim_list_run_qlogs(run_files, ".qlog", &names, &nb_names) != 0) {
+        fprintf(err_fd, "Cannot list the qlogs of the run\n");
+        ret = -1;
+    }
+    else if (nb_names > 0 && (nb_segments = (size_t*)calloc(nb_names, sizeof(size_t))) == NULL) {
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        job.names = names;
+        job.nb_segments = nb_segments;
+        job.segment_time = segment_time;
+        job.segment_size = segment_size;
+        job.do_compress = do_compress;
+        ret = pico_sim_parallel_for("Segmentation", nb_names, nb_threads, pico_sim_segment_one, &job, err_fd);
+    }
+
+    /* The segments replace the qlogs in the files of the run, also if some qlogs failed */
+    for (size_t i = 0; nb_segments != NULL && i < nb_names; i++) {
+        if (nb_segments[i] > 0) {
+            pico_sim_run_files_remove(run_files, names[i]);
+            for (size_t j = 0; j < nb_segments[i]; j++) {
+                char segment_name[1024];
+
+                pico_sim_qlog_segment_name(segment_name, sizeof(segment_name), names[i], j, do_compress);
+                if (pico_sim_run_files_add(run_files, segment_name) != 0) {
+                    ret = -1;
+                }
+            }
+        }
+    }
+    if (nb_segments != NULL) {
+        free(nb_segments);
+    }
+    pico_sim_free_file_list(names, nb_names);
+
+    return ret;
+}
@@ -0,0 +1,1082 @@
+/* Parsing of the simulation specifications.
+* A spec file is a list of "parameter: value" lines, describing
+* the picoquic network simulation and the pico_sim options.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include "picoquic.h"
+#include "picoquic_ns.h"
+#include "picoquic_utils.h"
+#include "pico_sim.h"
+
+typedef enum {
+    e_main_start_time = 0,
+    e_background_start_time,
+    e_main_scenario_text,
+    e_background_scenario_text,
+    e_main_cc_algo,
+    e_main_cc_options,
+    e_background_cc_algo,
+    e_background_cc_options,
+    e_nb_connections,
+    e_main_target_time,
+    e_data_rate_in_gbps,
+    e_latency,
+    e_jitter,
+    e_queue_delay_max,
+    e_l4s_max,
+    e_icid,
+    e_qlog_dir,
+    e_link_scenario,
+    e_qperf_log,
+    e_media_stats_start,
+    e_media_excluded,
+    e_media_latency_average,
+    e_media_latency_max,
+    e_seed_cwin,
+    e_seed_rtt,
+    e_trace_format,
+    e_summary,
+    e_qlog_level,
+    e_qlog_sample_interval,
+    e_qlog_segment_time,
+    e_qlog_segment_size,
+    e_qlog_compress,
+    e_replicas,
+    e_link_trace_file,
+    e_link_trace_interval,
+    e_path_hops,
+    e_media_latency_p999,
+    e_media_latency_p99,
+    e_expect_goodput_min,
+    e_expect_completion_time_max,
+    e_expect_fairness_min,
+    e_expect_rtt_p95_max,
+    e_expect_queue_delay_p99_max,
+    e_metrics_bin_interval,
+    e_queue_preset,
+    e_cross_traffic_trace,
+    e_cross_traffic,
+    e_error
+} spec_param_enum;
+
+typedef struct st_spec_param_t {
+    spec_param_enum p_e;
+    char const* p_name;
+    size_t p_len;
+} spec_param_t;
+
+spec_param_t params[] = {
+    { e_main_start_time, "main_start_time", 15 },
+    { e_main_target_time, "main_target_time", 16 },
+    { e_background_start_time, "background_start_time", 21 },
+    { e_main_scenario_text, "main_scenario_text", 18  },
+    { e_background_scenario_text, "background_scenario_text", 24 },
+    { e_main_cc_algo, "main_cc_algo", 12 },
+    { e_main_cc_options, "main_cc_options", 15 },
+    { e_background_cc_algo, "background_cc_algo", 18 },
+    { e_background_cc_options, "background_cc_options", 21 },
+    { e_nb_connections, "nb_connections", 14 },
+    { e_data_rate_in_gbps, "data_rate_in_gbps", 17 },
+    { e_latency, "latency" , 7},
+    { e_jitter, "jitter", 6 },
+    { e_queue_delay_max, "queue_delay_max", 15 },
+    { e_l4s_max, "l4s_max", 7 },
+    { e_icid, "icid", 4 },
+    { e_qlog_dir, "qlog_dir", 8 },
+    { e_link_scenario, "link_scenario", 13 },
+    { e_qperf_log, "qperf_log", 9},
+    { e_media_stats_start, "media_stats_start", 17},
+    { e_media_excluded, "media_excluded", 14},
+    { e_media_latency_average, "media_latency_average", 21},
+    { e_media_latency_max, "media_latency_max", 17},
+    { e_seed_cwin, "seed_cwin", 9},
+    { e_seed_rtt, "seed_rtt", 8},
+    { e_trace_format, "trace_format", 12},
+    { e_summary, "summary", 7},
+    { e_qlog_level, "qlog_level", 10},
+    { e_qlog_sample_interval, "qlog_sample_interval", 20},
+    { e_qlog_segment_time, "qlog_segment_time", 17},
+    { e_qlog_segment_size, "qlog_segment_size", 17},
+    { e_qlog_compress, "qlog_compress", 13},
+    { e_replicas, "replicas", 8},
+    { e_link_trace_file, "link_trace_file", 15},
+    { e_link_trace_interval, "link_trace_interval", 19},
+    { e_path_hops, "path_hops", 9},
+    /* Listed before "media_latency_p99", which is a prefix */
+    { e_media_latency_p999, "media_latency_p999", 18},
+    { e_media_latency_p99, "media_latency_p99", 17},
+    { e_expect_goodput_min, "expect_goodput_min", 18},
+    { e_expect_completion_time_max, "expect_completion_time_max", 26},
+    { e_expect_fairness_min, "expect_fairness_min", 19},
+    { e_expect_rtt_p95_max, "expect_rtt_p95_max", 18},
+    { e_expect_queue_delay_p99_max, "expect_queue_delay_p99_max", 26},
+    { e_metrics_bin_interval, "metrics_bin_interval", 20},
+    { e_queue_preset, "queue_preset", 12},
+    /* Listed before "cross_traffic", which is a prefix */
+    { e_cross_traffic_trace, "cross_traffic_trace", 19},
+    { e_cross_traffic, "cross_traffic", 13},
+};
+
+const size_t nb_params = sizeof(params) / sizeof(spec_param_t);
+
+int parse_param(pico_sim_spec_t* spec, spec_param_enum p_e, char const * text);
+char const* parse_param_value(char const* line);
+
+int parse_spec_file(pico_sim_spec_t * spec, FILE* F)
+{
+    return parse_spec_file_sweep(spec, NULL, F);
+}
+
+/* Parse one line of a spec, either a parameter or the start of a variant */
+static int parse_spec_line(pico_sim_spec_t* spec, pico_sim_sweep_t* sweep, char* line)
+{
+    int ret = 0;
+    spec_param_enum p_e = e_error;
+    size_t p_len = 0;
+    size_t len = strlen(line);
+    char const* name = NULL;
+
+    while (len > 0 && isspace(line[len - 1]))
+    {
+        len--;
+        line[len] = 0;
+    }
+
+    if (len > 7 && strncmp(line, "variant", 7) == 0 && parse_param_value(line + 7) != NULL) {
+        /* Start of a variant, the following parameters only apply to it */
+        if (sweep == NULL) {
+            fprintf(stderr, "Variants not supported here: %s\n", line);
+            ret = -1;
+        }
+        else {
+            ret = pico_sim_variant_add(sweep, parse_param_value(line + 7));
+        }
+    }
+    else if (len > 0) {
+        for (int i = 0; i < nb_params; i++) {
+            if (len > params[i].p_len &&
+                strncmp(line, params[i].p_name, params[i].p_len) == 0)
+            {
+                p_e = params[i].p_e;
+                p_len = params[i].p_len;
+                name = params[i].p_name;
+                break;
+            }
+        }
+
+        if (p_e == e_error) {
+            fprintf(stderr, "Incorrect specification line: %s\n", line);
+            ret = -1;
+        }
+        else {
+            char const* value = parse_param_value(line + p_len);
+
+            if (sweep != NULL && sweep->nb_variants > 0) {
+                if (value == NULL || pico_sim_is_sweep_value(value)) {
+                    fprintf(stderr, "Incorrect variant parameter: %s\n", line);
+                    ret = -1;
+                }
+                else {
+                    ret = pico_sim_variant_add_param(sweep, (int)p_e, name, value);
+                }
+            }
+            else if (value != NULL && pico_sim_is_sweep_value(value)) {
+                /* Range or list of values, expanded when running the simulations */
+                if (sweep == NULL) {
+                    fprintf(stderr, "Parameter sweep not supported here: %s\n", line);
+                    ret = -1;
+                }
+                else {
+                    ret = pico_sim_sweep_add(sweep, (int)p_e, name, value);
+                }
+            }
+            else {
+                ret = parse_param(spec, p_e, line + p_len);
+            }
+        }
+    }
+    return ret;
+}
+
+int parse_spec_file_sweep(pico_sim_spec_t* spec, pico_sim_sweep_t* sweep, FILE* F)
+{
+    int ret = 0;
+    char line[1024];
+
+    memset(spec, 0, sizeof(pico_sim_spec_t));
+    if (sweep != NULL) {
+        memset(sweep, 0, sizeof(pico_sim_sweep_t));
+    }
+
+    while (ret == 0 && fgets(line, sizeof(line), F) != NULL) {
+        ret = parse_spec_line(spec, sweep, line);
+    }
+    if (ret != 0 && sweep != NULL) {
+        pico_sim_sweep_release(sweep);
+    }
+    return ret;
+}
+
+/* Parse the text of a spec file held in memory. The parameters are added
+ * to those already set in the spec. Sweeps and variants are not supported. */
+int parse_spec_text(pico_sim_spec_t* spec, char const* text)
+{
+    int ret = 0;
+    char line[1024];
+
+    while (ret == 0 && *text != 0) {
+        size_t len = 0;
+
+        while (text[len] != 0 && text[len] != '\n') {
+            len++;
+        }
+        if (len >= sizeof(line)) {
+            fprintf(stderr, "Specification line too long.\n");
+            ret = -1;
+        }
+        else {
+            memcpy(line, text, len);
+            line[len] = 0;
+            ret = parse_spec_line(spec, NULL, line);
+        }
+        text += len;
+        if (*text == '\n') {
+            text++;
+        }
+    }
+    return ret;
+}
+
+/* Set a parameter by its name, e.g., "latency", and its value */
+int parse_param_by_name(pico_sim_spec_t* spec, char const* name, char const* value)
+{
+    int ret = -1;
+
+    for (int i = 0; i < nb_params; i++) {
+        if (strcmp(name, params[i].p_name) == 0) {
+            ret = parse_param_by_id(spec, (int)params[i].p_e, value);
+            break;
+        }
+    }
+    return ret;
+}
+
+int parse_u64(uint64_t* x, char const* val);
+int parse_int(int* x, char const* val);
+int parse_double(double* x, char const* val);
+int parse_cc_algo(picoquic_congestion_algorithm_t const ** x, char const* val);
+int parse_cid(picoquic_connection_id_t* x, char const* val);
+int parse_text(char const** x, char const* val);
+int parse_file_name(char const** x, char const* val);
+int parse_link_scenario(picoquic_ns_spec_t* link_scenario, char const* val);
+int parse_path_hops(picoquic_ns_spec_t* spec, char const* val);
+int parse_trace_format(pico_sim_trace_format_enum* x, char const* val);
+int parse_summary_format(pico_sim_summary_format_enum* x, char const* val);
+int parse_qlog_compress(int* x, char const* val);
+void release_text(char const** text);
+
+/* Skip the colon and spaces before the value of a parameter,
+ * return NULL if the colon is missing. */
+char const* parse_param_value(char const* line)
+{
+    while (isspace(line[0])) {
+        line++;
+    }
+    if (line[0] != ':') {
+        line = NULL;
+    }
+    else {
+        line++;
+        while (isspace(line[0])) {
+            line++;
+        }
+    }
+    return line;
+}
+
+int parse_param(pico_sim_spec_t* spec, spec_param_enum p_e, char const* line)
+{
+    int ret = 0;
+
+    if ((line = parse_param_value(line)) == NULL) {
+        ret = -1;
+    }
+    else {
+        ret = parse_param_by_id(spec, (int)p_e, line);
+    }
+
+    return ret;
+}
+
+int parse_param_by_id(pico_sim_spec_t* spec, int param_id, char const* line)
+{
+    int ret = 0;
+    spec_param_enum p_e = (spec_param_enum)param_id;
+
+    switch (p_e) {
+    case e_main_start_time:
+        ret = parse_u64(&spec->ns.main_start_time, line);
+        break;
+    case e_main_target_time:
+        ret = parse_u64(&spec->ns.main_target_time, line);
+        break;
+    case e_background_start_time:
+        ret = parse_u64(&spec->ns.background_start_time, line);
+        break;
+    case e_main_scenario_text:
+        release_text(&spec->ns.main_scenario_text);
+        ret = parse_text(&spec->ns.main_scenario_text, line);
+        break;
+    case e_background_scenario_text:
+        release_text(&spec->ns.background_scenario_text);
+        ret = parse_text(&spec->ns.background_scenario_text, line);
+        break;
+    case e_main_cc_algo:
+        ret = parse_cc_algo(&spec->ns.main_cc_algo, line);
+        break;
+    case e_main_cc_options:
+        release_text(&spec->ns.main_cc_options);
+        ret = parse_text(&spec->ns.main_cc_options, line);
+        break;
+    case e_background_cc_algo:
+        ret = parse_cc_algo(&spec->ns.background_cc_algo, line);
+        break;
+    case e_background_cc_options:
+        release_text(&spec->ns.background_cc_options);
+        ret = parse_text(&spec->ns.background_cc_options, line);
+        break;
+    case e_nb_connections:
+        ret = parse_int(&spec->ns.nb_connections, line);
+        break;
+    case e_data_rate_in_gbps:
+        ret = parse_double(&spec->ns.data_rate_in_gbps, line);
+        break;
+    case e_latency:
+        ret = parse_u64(&spec->ns.latency, line);
+        break;
+    case e_jitter:
+        ret = parse_u64(&spec->ns.jitter, line);
+        break;
+    case e_queue_delay_max:
+        ret = parse_u64(&spec->ns.queue_delay_max, line);
+        break;
+    case e_l4s_max:
+        ret = parse_u64(&spec->ns.l4s_max, line);
+        break;
+    case e_icid:
+        ret = parse_cid(&spec->ns.icid, line);
+        break;
+    case e_qlog_dir:
+        release_text(&spec->ns.qlog_dir);
+        ret = parse_file_name(&spec->ns.qlog_dir, line);
+        break;
+    case e_link_scenario:
+        ret = parse_link_scenario(&spec->ns, line);
+        break;
+    case e_qperf_log:
+        release_text(&spec->ns.qperf_log);
+        ret = parse_file_name(&spec->ns.qperf_log, line);
+        break;
+    case e_media_stats_start:
+        ret = parse_u64(&spec->ns.media_stats_start, line);
+        break;
+    case e_media_excluded:
+        release_text(&spec->ns.media_excluded);
+        ret = parse_text(&spec->ns.media_excluded, line);
+        break;
+    case e_media_latency_average:
+        ret = parse_u64(&spec->ns.media_latency_average, line);
+        break;
+    case e_media_latency_max:
+        ret = parse_u64(&spec->ns.media_latency_max, line);
+        break;
+    case e_seed_cwin:
+        ret = parse_u64(&spec->ns.seed_cwin, line);
+        break;
+    case e_seed_rtt:
+        ret = parse_u64(&spec->ns.seed_rtt, line);
+        break;
+    case e_trace_format:
+        ret = parse_trace_format(&spec->trace_format, line);
+        break;
+    case e_summary:
+        ret = parse_summary_format(&spec->summary_format, line);
+        break;
+    case e_qlog_level:
+        release_text(&spec->qlog_level);
+        ret = parse_text(&spec->qlog_level, line);
+        break;
+    case e_qlog_sample_interval:
+        ret = parse_u64(&spec->qlog_sample_interval, line);
+        break;
+    case e_qlog_segment_time:
+        ret = parse_u64(&spec->qlog_segment_time, line);
+        break;
+    case e_qlog_segment_size:
+        ret = parse_u64(&spec->qlog_segment_size, line);
+        break;
+    case e_qlog_compress:
+        ret = parse_qlog_compress(&spec->qlog_compress, line);
+        break;
+    case e_replicas:
+        if ((ret = parse_u64(&spec->nb_replicas, line)) == 0 &&
+            (spec->nb_replicas == 0 || spec->nb_replicas > PICO_SIM_REPLICAS_MAX)) {
+            ret = -1;
+        }
+        break;
+    case e_link_trace_file:
+        release_text(&spec->link_trace_file);
+        ret = parse_file_name(&spec->link_trace_file, line);
+        break;
+    case e_link_trace_interval:
+        ret = parse_u64(&spec->link_trace_interval, line);
+        break;
+    case e_path_hops:
+        ret = parse_path_hops(&spec->ns, line);
+        break;
+    case e_media_latency_p999:
+        ret = parse_u64(&spec->media_latency_p999, line);
+        break;
+    case e_media_latency_p99:
+        ret = parse_u64(&spec->media_latency_p99, line);
+        break;
+    case e_expect_goodput_min:
+        ret = parse_double(&spec->expect.goodput_min, line);
+        break;
+    case e_expect_completion_time_max:
+        ret = parse_u64(&spec->expect.completion_time_max, line);
+        break;
+    case e_expect_fairness_min:
+        ret = parse_double(&spec->expect.fairness_min, line);
+        break;
+    case e_expect_rtt_p95_max:
+        ret = parse_u64(&spec->expect.rtt_p95_max, line);
+        break;
+    case e_expect_queue_delay_p99_max:
+        ret = parse_u64(&spec->expect.queue_delay_p99_max, line);
+        break;
+    case e_metrics_bin_interval:
+        ret = parse_u64(&spec->metrics_bin_interval, line);
+        break;
+    case e_queue_preset:
+        ret = pico_sim_queue_preset_parse(&spec->queue_preset, line);
+        break;
+    case e_cross_traffic_trace:
+        release_text(&spec->cross_traffic_trace);
+        ret = parse_file_name(&spec->cross_traffic_trace, line);
+        break;
+    case e_cross_traffic:
+        release_text(&spec->cross_traffic);
+        if ((ret = pico_sim_cross_check(line)) == 0) {
+            ret = parse_text(&spec->cross_traffic, line);
+        }
+        break;
+    default:
+        ret = -1;
+        break;
+    }
+    if (ret != 0) {
+        fprintf(stderr, "Error parsing param %d: %s\n", p_e, line);
+    }
+
+    return ret;
+}
+
+void release_spec_data(pico_sim_spec_t* sim_spec)
+{
+    picoquic_ns_spec_t* spec = &sim_spec->ns;
+
+    release_text(&spec->main_scenario_text);
+    release_text(&spec->background_scenario_text);
+    release_text(&spec->main_cc_options);
+    release_text(&spec->background_cc_options);
+    release_text(&spec->qlog_dir);
+    if (spec->link_scenario == link_scenario_none && spec->vary_link_spec != NULL) {
+        free(spec->vary_link_spec);
+        spec->vary_link_spec = NULL;
+    }
+    release_text(&spec->qperf_log);
+    release_text(&spec->media_excluded);
+    release_text(&sim_spec->qlog_level);
+    release_text(&sim_spec->link_trace_file);
+    release_text(&sim_spec->cross_traffic);
+    release_text(&sim_spec->cross_traffic_trace);
+}
+
+/* Deep copy of a spec, so that each simulation of a batch or a
+ * sweep can modify its own copy of a common parsed spec.
+ */
+int copy_spec_data(pico_sim_spec_t* sim_spec, pico_sim_spec_t const* sim_model)
+{
+    int ret = 0;
+    picoquic_ns_spec_t* spec = &sim_spec->ns;
+    picoquic_ns_spec_t const* model = &sim_model->ns;
+
+    *sim_spec = *sim_model;
+    spec->main_scenario_text = NULL;
+    spec->background_scenario_text = NULL;
+    spec->main_cc_options = NULL;
+    spec->background_cc_options = NULL;
+    spec->qlog_dir = NULL;
+    spec->qperf_log = NULL;
+    spec->media_excluded = NULL;
+    sim_spec->qlog_level = NULL;
+    sim_spec->link_trace_file = NULL;
+    sim_spec->cross_traffic = NULL;
+    sim_spec->cross_traffic_trace = NULL;
+    if (spec->link_scenario == link_scenario_none) {
+        spec->vary_link_spec = NULL;
+    }
+
+    if ((model->main_scenario_text != NULL && parse_text(&spec->main_scenario_text, model->main_scenario_text) != 0) ||
+        (model->background_scenario_text != NULL && parse_text(&spec->background_scenario_text, model->background_scenario_text) != 0) ||
+        (model->main_cc_options != NULL && parse_text(&spec->main_cc_options, model->main_cc_options) != 0) ||
+        (model->background_cc_options != NULL && parse_text(&spec->background_cc_options, model->background_cc_options) != 0) ||
+        (model->qlog_dir != NULL && parse_text(&spec->qlog_dir, model->qlog_dir) != 0) ||
+        (model->qperf_log != NULL && parse_text(&spec->qperf_log, model->qperf_log) != 0) ||
+        (model->media_excluded != NULL && parse_text(&spec->media_excluded, model->media_excluded) != 0) ||
+        (sim_model->qlog_level != NULL && parse_text(&sim_spec->qlog_level, sim_model->qlog_level) != 0) ||
+        (sim_model->link_trace_file != NULL && parse_text(&sim_spec->link_trace_file, sim_model->link_trace_file) != 0) ||
+        (sim_model->cross_traffic != NULL && parse_text(&sim_spec->cross_traffic, sim_model->cross_traffic) != 0) ||
+        (sim_model->cross_traffic_trace != NULL && parse_text(&sim_spec->cross_traffic_trace, sim_model->cross_traffic_trace) != 0)) {
+        ret = -1;
+    }
+    else if (model->link_scenario == link_scenario_none && model->vary_link_spec != NULL) {
+        size_t l = sizeof(picoquic_ns_link_spec_t) * model->vary_link_nb;
+        if ((spec->vary_link_spec = (picoquic_ns_link_spec_t*)malloc(l)) == NULL) {
+            ret = -1;
+        }
+        else {
+            memcpy(spec->vary_link_spec, model->vary_link_spec, l);
+        }
+    }
+    if (ret != 0) {
+        release_spec_data(sim_spec);
+    }
+    return ret;
+}
+
+int parse_u64(uint64_t* x, char const* val)
+{
+    int ret = 0;
+    uint64_t v = 0;
+    int i = 0;
+
+    while (isdigit(val[i])) {
+        v *= 10;
+        v += val[i] - '0';
+        i++;
+    }
+    if (val[i] != 0) {
+        ret = -1;
+    }
+    else {
+        *x = v;
+    }
+    return ret;
+}
+
+int parse_int(int* x, char const* val)
+{
+    uint64_t v = 0;
+    int ret = parse_u64(&v, val);
+
+    if (ret == 0) {
+        if (v > 0x7ffffff) {
+            ret = -1;
+        }
+        else {
+            *x = (int)v;
+        }
+    }
+    return ret;
+}
+
+int parse_double(double* x, char const* val)
+{
+    int ret = 0;
+    double v = 0;
+    int i = 0;
+
+    while (isdigit(val[i])) {
+        v *= 10;
+        v += val[i] - '0';
+        i++;
+    }
+    if (val[i] == '.') {
+        double decimal = 1;
+        i++; 
+        while (isdigit(val[i])) {
+            decimal /= 10;
+            v += (val[i] - '0') * decimal;
+            i++;
+        }
+    }
+    if (val[i] != 0) {
+        ret = -1;
+    }
+    else {
+        *x = v;
+    }
+    return ret;
+}
+
+int parse_cc_algo(picoquic_congestion_algorithm_t const ** x, char const* val)
+{
+    int ret = 0;
+
+    if ((*x = picoquic_get_congestion_algorithm(val)) == NULL) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+static int hexdigit(char v)
+{
+    int y = -1;
+
+    if (v >= '0' && v <= '9') {
+        y = v - '0';
+    }
+    else if (v >= 'A' && v <= 'Z') {
+        y = 10 + v - 'A';
+    }
+    else if (v >= 'a' && v <= 'z') {
+        y = 10 + v - 'a';
+    }
+    return y;
+}
+
+int parse_cid(picoquic_connection_id_t* x, char const* val)
+{
+    int ret = 0;
+    int i = 0;
+    int j = 0;
+    int k = 0;
+    int u8 = 0;
+
+
+    while (val[i] != 0) {
+        int hx = hexdigit(val[i]);
+        if (hx < 0) {
+            ret = -1;
+            break;
+        }
+        else if (j >= 8) {
+            ret = -1;
+            break;
+        }
+        else {
+            u8 += (uint8_t)hx;
+            k++;
+            if (k == 2) {
+                x->id[j] = u8;
+                j++;
+                u8 = 0;
+                k = 0;
+            }
+            else {
+                u8 <<= 4;
+                x->id[j] = u8;
+            }
+        }
+        i++;
+    }
+    if (ret == 0) {
+        j++;
+        while (j < 8) {
+            x->id[j] = 0;
+            j++;
+        }
+        x->id_len = 8;
+    }
+
+    if (ret == 0 && val[j] != 0) {
+        ret = -1;
+    }
+    return ret;
+}
+
+int parse_text(char const** x, char const* val)
+{
+    int ret = 0;
+    size_t l = strlen(val);
+
+    if (val > 0) {
+        char* y = malloc(l + 1);
+        if (y == NULL) {
+            ret = -1;
+        }
+        else {
+            memcpy(y, val, l);
+            y[l] = 0;
+            *x = y;
+        }
+    }
+    return ret;
+}
+
+int parse_file_name(char const** x, char const* val)
+{
+#ifdef _WINDOWS
+    /* For windows, replace slashes by whacks */
+    int i = 0;
+    char line[1024];
+
+    while (i < 1024 && val[i] != 0) {
+        if (val[i] == '/') {
+            line[i] = '\\';
+        }
+        else {
+            line[i] = val[i];
+        }
+        i++;
+    }
+    line[i] = 0;
+    return parse_text(x, line);
+#else
+    return parse_text(x, val);
+#endif
+}
+
+int parse_trace_format(pico_sim_trace_format_enum* x, char const* val)
+{
+    int ret = 0;
+
+    if (strcmp(val, "qlog") == 0) {
+        *x = pico_sim_trace_qlog;
+    }
+    else if (strcmp(val, "binary") == 0) {
+        *x = pico_sim_trace_binary;
+    }
+    else if (strcmp(val, "both") == 0) {
+        *x = pico_sim_trace_both;
+    }
+    else {
+        ret = -1;
+    }
+    return ret;
+}
+
+int parse_summary_format(pico_sim_summary_format_enum* x, char const* val)
+{
+    int ret = 0;
+
+    if (strcmp(val, "none") == 0) {
+        *x = pico_sim_summary_none;
+    }
+    else if (strcmp(val, "csv") == 0) {
+        *x = pico_sim_summary_csv;
+    }
+    else if (strcmp(val, "json") == 0) {
+        *x = pico_sim_summary_json;
+    }
+    else {
+        ret = -1;
+    }
+    return ret;
+}
+
+int parse_qlog_compress(int* x, char const* val)
+{
+    int ret = 0;
+
+    if (strcmp(val, "none") == 0) {
+        *x = 0;
+    }
+    else if (strcmp(val, "gzip") == 0) {
+#ifdef PICO_SIM_ZLIB
+        *x = 1;
+#else
+        fprintf(stderr, "This build of pico_sim does not support gzip compression.\n");
+        ret = -1;
+#endif
+    }
+    else {
+        ret = -1;
+    }
+    return ret;
+}
+
+typedef struct st_link_scenario_spec_t {
+    picoquic_ns_link_scenario_enum v;
+    char const* n;
+    size_t l;
+}link_scenario_spec_t;
+
+static const link_scenario_spec_t link_scenarios[] = {
+    { link_scenario_none, "none", 4 },
+    { link_scenario_black_hole, "black_hole", 10  },
+    { link_scenario_drop_and_back, "drop_and_back", 13 },
+    { link_scenario_low_and_up, "low_and_up", 10 },
+    { link_scenario_wifi_fade, "wifi_fade", 5 },
+    { link_scenario_wifi_suspension, "wifi_suspension", 15 }
+};
+
+size_t nb_link_scenarios = sizeof(link_scenarios) / sizeof(link_scenario_spec_t);
+int parse_specified_link_scenario(picoquic_ns_spec_t* spec, char const* val);
+
+int parse_link_scenario(picoquic_ns_spec_t* spec, char const* val)
+{
+    int ret = -1;
+    if (spec->link_scenario == link_scenario_none && spec->vary_link_spec != NULL) {
+        free(spec->vary_link_spec);
+    }
+    spec->vary_link_spec = NULL;
+    spec->vary_link_nb = 0;
+    spec->link_scenario = link_scenario_none;
+    for (size_t i = 0; i < nb_link_scenarios; i++) {
+        if (strcmp(val, link_scenarios[i].n) == 0) {
+            spec->link_scenario = link_scenarios[i].v;
+            ret = 0;
+            break;
+        }
+    }
+    if (ret < 0) {
+        /* Not a stock link scenario. Parse the details */
+        ret = parse_specified_link_scenario(spec, val);
+    }
+
+    return ret;
+}
+
+
+size_t count_char(char const* val, char target);
+char const* parse_link_spec_item(picoquic_ns_link_spec_t* line_spec, char const* val);
+
+int parse_specified_link_scenario(picoquic_ns_spec_t * spec, char const * val)
+{
+    int ret = -1;
+    size_t vary_link_max = count_char(val, ';') + 1;
+    picoquic_ns_link_spec_t* vary_link_spec = (picoquic_ns_link_spec_t*)malloc(sizeof(picoquic_ns_link_spec_t) * vary_link_max);
+
+    if (vary_link_spec != NULL) {
+        char const* next_val = val;
+        size_t vary_link_nb = 0;
+        memset(vary_link_spec, 0, sizeof(picoquic_ns_link_spec_t) * vary_link_max);
+
+        while (vary_link_nb < vary_link_max) {
+            next_val = parse_link_spec_item(&vary_link_spec[vary_link_nb], next_val);
+            if (next_val == NULL) {
+                /* Found an error in the text */
+                break;
+            }
+            else {
+                vary_link_nb++;
+                if (*next_val == 0) {
+                    /* parsed the last spec element */
+                    ret = 0;
+                    break;
+                }
+            }
+        }
+        if (ret < 0) {
+            free(vary_link_spec);
+        }
+        else {
+            spec->link_scenario = link_scenario_none;
+            spec->vary_link_nb = vary_link_nb;
+            spec->vary_link_spec = vary_link_spec;
+        }
+    }
+    return ret;
+}
+
+/* Path of several hops, e.g., "R0.1:L10000:Q20000;R0.02:L30000:Q80000",
+ * with for each hop the data rate in Gbps, the latency and the max queue
+ * delay. The simulation has a single link, shared by all connections, so
+ * the path is reduced to its bottleneck: the data rate and the queue of
+ * the slowest hop, and the sum of the latencies. This only holds if the
+ * other hops are faster, and never queue: a path in which several hops
+ * have the lowest rate has several bottlenecks, and is rejected.
+ */
+int parse_path_hops(picoquic_ns_spec_t* spec, char const* val)
+{
+    int ret = 0;
+    char const* x = val;
+    double rate_min = 0;
+    uint64_t latency = 0;
+    uint64_t queue_delay_max = 0;
+    size_t nb_hops = 0;
+    size_t nb_bottlenecks = 0;
+
+    while (ret == 0 && *x != 0) {
+        double rate = 0;
+        uint64_t hop_latency = 0;
+        uint64_t hop_queue_delay_max = 0;
+
+        while (ret == 0 && *x != 0 && *x != ';') {
+            char intermediate[64];
+            size_t copied = 0;
+
+            while (*x != 0 && *x != ':' && *x != ';' && copied < sizeof(intermediate) - 1) {
+                intermediate[copied] = *x;
+                copied++;
+                x++;
+            }
+            intermediate[copied] = 0;
+            if (*x == ':') {
+                x++;
+            }
+            else if (*x != 0 && *x != ';') {
+                ret = -1;
+                break;
+            }
+            switch (intermediate[0]) {
+            case 'R':
+                ret = parse_double(&rate, &intermediate[1]);
+                break;
+            case 'L':
+                ret = parse_u64(&hop_latency, &intermediate[1]);
+                break;
+            case 'Q':
+                ret = parse_u64(&hop_queue_delay_max, &intermediate[1]);
+                break;
+            default:
+                ret = -1;
+                break;
+            }
+        }
+        if (*x == ';') {
+            x++;
+        }
+        if (ret == 0 && rate <= 0) {
+            /* Each hop needs a data rate */
+            ret = -1;
+        }
+        if (ret == 0) {
+            latency += hop_latency;
+            if (nb_hops == 0 || rate < rate_min) {
+                rate_min = rate;
+                queue_delay_max = hop_queue_delay_max;
+                nb_bottlenecks = 1;
+            }
+            else if (rate == rate_min) {
+                nb_bottlenecks++;
+            }
+            nb_hops++;
+        }
+    }
+    if (ret == 0 && nb_hops == 0) {
+        ret = -1;
+    }
+    if (ret == 0 && nb_bottlenecks > 1) {
+        fprintf(stderr, "path_hops: %zu hops have the lowest data rate, %f Gbps, only one bottleneck is simulated\n",
+            nb_bottlenecks, rate_min);
+        ret = -1;
+    }
+    if (ret == 0) {
+        spec->data_rate_in_gbps = rate_min;
+        spec->latency = latency;
+        spec->queue_delay_max = queue_delay_max;
+    }
+    return ret;
+}
+
+size_t count_char(char const* val, char target)
+{
+    char const * x = val;
+    size_t n = 0;
+
+    while (*x != 0) {
+        if (*x == target) {
+            n++;
+        }
+        x++;
+    }
+    return n;
+}
+
+char const* parse_link_spec_item(picoquic_ns_link_spec_t * line_spec, char const* val)
+{
+    int is_first = 1;
+    int ret = 0;
+    char const* next_val = val;
+    pico_sim_queue_preset_enum preset = pico_sim_queue_preset_none;
+
+    while (*next_val != 0 && *next_val != ';' && ret == 0) {
+        char intermediate[256];
+        size_t copied = 0;
+
+        while (*next_val != 0 && *next_val != ':' && *next_val != ';' && copied < 255) {
+            intermediate[copied] = *next_val;
+            copied++;
+            next_val++;
+        }
+        intermediate[copied] = 0;
+        if (*next_val == ':') {
+            next_val++;
+        }
+        else if (*next_val != 0 && *next_val != ';') {
+            /* malformed parameter ! */
+            ret = -1;
+            break;
+        }
+        if (is_first) {
+            /* parse the duration */
+            ret = parse_u64(&line_spec->duration, intermediate);
+            is_first = 0;
+        }
+        else
+        {
+            switch (intermediate[0]) {
+            case 'U':
+                ret = parse_double(&line_spec->data_rate_in_gbps_up, &intermediate[1]);
+                break;
+            case 'D':
+                ret = parse_double(&line_spec->data_rate_in_gbps_down, &intermediate[1]);
+                break;
+            case 'L':
+                ret = parse_u64(&line_spec->latency, &intermediate[1]);
+                break;
+            case 'J':
+                ret = parse_u64(&line_spec->jitter, &intermediate[1]);
+                break;
+            case 'Q':
+                ret = parse_u64(&line_spec->queue_delay_max, &intermediate[1]);
+                break;
+            case 'S':
+                ret = parse_u64(&line_spec->l4s_max, &intermediate[1]);
+                break;
+            case 'B':
+                ret = parse_u64(&line_spec->nb_loss_in_burst, &intermediate[1]);
+                break;
+            case 'P':
+                ret = parse_u64(&line_spec->packets_between_losses, &intermediate[1]);
+                break;
+            case 'K':
+                /* Queue preset of the segment, see pico_sim_queue.c */
+                if ((ret = pico_sim_queue_preset_parse(&preset, &intermediate[1])) == 0) {
+                    pico_sim_queue_preset_apply(preset, &line_spec->queue_delay_max, &line_spec->l4s_max);
+                }
+                break;
+            default:
+                /* unknown parameter */
+                ret = -1;
+                break;
+            }
+        }
+    }
+    if (ret < 0) {
+        next_val = NULL;
+    }
+    else if (*next_val == ';') {
+        next_val++;
+    }
+    return next_val;
+}
+
+void release_text(char const** text)
+{
+    if (*text != NULL) {
+        free((void*)*text);
+        *text = NULL;
+    }
+}
+
@@ -0,0 +1,830 @@
+/* Summary metrics of a simulation.
+* The picoquic simulation does not expose its internal state, so the
+* metrics are extracted from the qlog traces, with the streaming scanner
+* of pico_sim_qlog.c. For each connection, we compute:
+* - the stream data sent and received, not counting retransmissions,
+*   from the offsets of the stream frames,
+* - the completion time, from the first event to the last stream frame,
+* - the goodput, i.e., stream data divided by completion time,
+* - the mean, median, 95th and 99th percentile of the RTT samples,
+* - the mean, 99th percentile and max queue delay, i.e., latest RTT
+*   minus min RTT,
+* - the number of packet losses, and of packets marked CE by the link,
+*   from the ECN counts of the acknowledgements received.
+* The same metrics are computed for the whole run, plus Jain's fairness
+* index of the goodput of the competing connections.
+*
+* Each connection appears in two qlogs, one at the client and one at the
+* server. We only use the server traces if there are any, so connections
+* are not counted twice.
+*
+* The metrics can also be kept in memory, with the time series of the
+* congestion control state, for the embedding API of pico_sim_api.c,
+* and the metrics of the whole run read back from a summary file, for
+* the replicas and the expectations.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "picoquic.h"
+#include "picoquic_utils.h"
+#include "pico_sim.h"
+#include "pico_sim_qlog.h"
+
+#define PICO_SIM_SUMMARY_PATH_MAX 256
+
+/* The metrics, in the order of the CSV columns */
+char const* const pico_sim_summary_metric_names[PICO_SIM_SUMMARY_METRICS_NB] = {
+    "bytes_sent", "bytes_received", "completion_time", "goodput_mbps",
+    "rtt_mean", "rtt_p50", "rtt_p95", "rtt_p99", "queue_delay_mean", "queue_delay_p99",
+    "queue_delay_max", "nb_losses", "nb_ce_marks", "jain_index"
+};
+
+typedef struct st_pico_sim_summary_stream_t {
+    uint64_t stream_id;
+    uint64_t sent;
+    uint64_t received;
+} pico_sim_summary_stream_t;
+
+typedef struct st_pico_sim_summary_samples_t {
+    uint64_t* v;
+    size_t nb;
+    size_t nb_max;
+} pico_sim_summary_samples_t;
+
+typedef struct st_pico_sim_summary_cnx_t {
+    char const* qlog_name;
+    int has_events;
+    uint64_t first_time;
+    uint64_t last_data_time;
+    uint64_t nb_losses;
+    uint64_t nb_ce_marks;
+    pico_sim_summary_stream_t* streams;
+    size_t nb_streams;
+    size_t nb_streams_max;
+    pico_sim_summary_samples_t rtt;
+    pico_sim_summary_samples_t queue_delay;
+    uint64_t queue_delay_max;
+} pico_sim_summary_cnx_t;
+
+typedef struct st_pico_sim_summary_ctx_t {
+    pico_sim_summary_cnx_t* cnx;
+    pico_sim_result_t* result;
+    size_t cnx_index;
+    pico_sim_cc_state_t cc_state[PICO_SIM_SUMMARY_PATH_MAX];
+    uint64_t ecn_ce[PICO_SIM_SUMMARY_PATH_MAX];
+} pico_sim_summary_ctx_t;
+
+typedef struct st_pico_sim_summary_frame_t {
+    int is_stream;
+    uint64_t stream_id;
+    uint64_t offset;
+    uint64_t length;
+    int nb_ecn;
+    uint64_t ecn_ce;
+} pico_sim_summary_frame_t;
+
+typedef struct st_pico_sim_summary_packet_t {
+    pico_sim_summary_cnx_t* cnx;
+    int is_sent;
+    int has_data;
+    int has_ecn;
+    uint64_t ecn_ce;
+} pico_sim_summary_packet_t;
+
+static int pico_sim_summary_add_sample(pico_sim_summary_samples_t* samples, uint64_t v)
+{
+    int ret = 0;
+
+    if (samples->nb >= samples->nb_max) {
+        size_t new_max = (samples->nb_max == 0) ? 256 : 2 * samples->nb_max;
+        uint64_t* new_v = (uint64_t*)realloc(samples->v, new_max * sizeof(uint64_t));
+        if (new_v == NULL) {
+            ret = -1;
+        }
+        else {
+            samples->v = new_v;
+            samples->nb_max = new_max;
+        }
+    }
+    if (ret == 0) {
+        samples->v[samples->nb++] = v;
+    }
+    return ret;
+}
+
+/* Add one row to the time series, growing all the columns together */
+static int pico_sim_summary_add_series(pico_sim_result_t* result, size_t cnx_index, uint64_t path_id,
+    pico_sim_cc_state_t const* cc_state)
+{
+    int ret = 0;
+
+    if (result->nb_samples >= result->nb_samples_max) {
+        size_t new_max = (result->nb_samples_max == 0) ? 1024 : 2 * result->nb_samples_max;
+
+        for (int i = 0; ret == 0 && i < pico_sim_series_nb; i++) {
+            uint64_t* new_column = (uint64_t*)realloc(result->series[i], new_max * sizeof(uint64_t));
+            if (new_column == NULL) {
+                ret = -1;
+            }
+            else {
+                result->series[i] = new_column;
+            }
+        }
+        if (ret == 0) {
+            result->nb_samples_max = new_max;
+        }
+    }
+    if (ret == 0) {
+        size_t n = result->nb_samples++;
+
+        result->series[pico_sim_series_time][n] = cc_state->event_time;
+        result->series[pico_sim_series_connection][n] = (uint64_t)cnx_index;
+        result->series[pico_sim_series_path][n] = path_id;
+        result->series[pico_sim_series_cwnd][n] = cc_state->cwnd;
+        result->series[pico_sim_series_bytes_in_flight][n] = cc_state->bytes_in_flight;
+        result->series[pico_sim_series_pacing_rate][n] = cc_state->pacing_rate;
+        result->series[pico_sim_series_smoothed_rtt][n] = cc_state->smoothed_rtt;
+        result->series[pico_sim_series_latest_rtt][n] = cc_state->latest_rtt;
+    }
+    return ret;
+}
+
+/* Streams are kept sorted by stream id, found by binary search */
+static pico_sim_summary_stream_t* pico_sim_summary_stream(pico_sim_summary_cnx_t* cnx, uint64_t stream_id)
+{
+    pico_sim_summary_stream_t* stream = NULL;
+    size_t low = 0;
+    size_t high = cnx->nb_streams;
+
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (cnx->streams[mid].stream_id < stream_id) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+    if (low < cnx->nb_streams && cnx->streams[low].stream_id == stream_id) {
+        stream = &cnx->streams[low];
+    }
+    else {
+        if (cnx->nb_streams >= cnx->nb_streams_max) {
+            size_t new_max = (cnx->nb_streams_max == 0) ? 16 : 2 * cnx->nb_streams_max;
+            pico_sim_summary_stream_t* new_streams = (pico_sim_summary_stream_t*)realloc(cnx->streams,
+                new_max * sizeof(pico_sim_summary_stream_t));
+            if (new_streams != NULL) {
+                cnx->streams = new_streams;
+                cnx->nb_streams_max = new_max;
+            }
+        }
+        if (cnx->nb_streams < cnx->nb_streams_max) {
+            memmove(&cnx->streams[low + 1], &cnx->streams[low], (cnx->nb_streams - low) * sizeof(pico_sim_summary_stream_t));
+            stream = &cnx->streams[low];
+            memset(stream, 0, sizeof(pico_sim_summary_stream_t));
+            stream->stream_id = stream_id;
+            cnx->nb_streams++;
+        }
+    }
+    return stream;
+}
+
+/* The ECN counts of an ACK frame are ECT(0), ECT(1) and CE */
+static int pico_sim_summary_ecn_count(void* ctx, char const* value, size_t value_len)
+{
+    pico_sim_summary_frame_t* frame = (pico_sim_summary_frame_t*)ctx;
+
+    if (frame->nb_ecn == 2) {
+        frame->ecn_ce = pico_sim_qlog_u64(value, value_len);
+    }
+    frame->nb_ecn++;
+    return 0;
+}
+
+static int pico_sim_summary_frame_member(void* ctx, char const* name, size_t name_len, char const* value, size_t value_len)
+{
+    pico_sim_summary_frame_t* frame = (pico_sim_summary_frame_t*)ctx;
+
+    if (pico_sim_qlog_is(name, name_len, "frame_type")) {
+        frame->is_stream = pico_sim_qlog_is(value, value_len, "\"stream\"");
+    }
+    else if (pico_sim_qlog_is(name, name_len, "id")) {
+        frame->stream_id = pico_sim_qlog_u64(value, value_len);
+    }
+    else if (pico_sim_qlog_is(name, name_len, "offset")) {
+        frame->offset = pico_sim_qlog_u64(value, value_len);
+    }
+    else if (pico_sim_qlog_is(name, name_len, "length")) {
+        frame->length = pico_sim_qlog_u64(value, value_len);
+    }
+    else if (pico_sim_qlog_is(name, name_len, "ecn")) {
+        (void)pico_sim_qlog_elements(value, value_len, pico_sim_summary_ecn_count, frame);
+    }
+    return 0;
+}
+
+static int pico_sim_summary_frame(void* ctx, char const* value, size_t value_len)
+{
+    int ret = 0;
+    pico_sim_summary_packet_t* packet = (pico_sim_summary_packet_t*)ctx;
+    pico_sim_summary_frame_t frame = { 0 };
+
+    if (value_len > 0 && value[0] == '{') {
+        ret = pico_sim_qlog_members(value, value_len, pico_sim_summary_frame_member, &frame);
+    }
+    if (ret == 0 && frame.is_stream) {
+        pico_sim_summary_stream_t* stream = pico_sim_summary_stream(packet->cnx, frame.stream_id);
+        uint64_t end = frame.offset + frame.length;
+
+        if (stream == NULL) {
+            ret = -1;
+        }
+        else if (packet->is_sent) {
+            stream->sent = (end > stream->sent) ? end : stream->sent;
+        }
+        else {
+            stream->received = (end > stream->received) ? end : stream->received;
+        }
+        packet->has_data = 1;
+    }
+    if (ret == 0 && frame.nb_ecn >= 3 && !packet->is_sent) {
+        packet->has_ecn = 1;
+        packet->ecn_ce = (frame.ecn_ce > packet->ecn_ce) ? frame.ecn_ce : packet->ecn_ce;
+    }
+    return ret;
+}
+
+static int pico_sim_summary_packet_member(void* ctx, char const* name, size_t name_len, char const* value, size_t value_len)
+{
+    int ret = 0;
+
+    if (pico_sim_qlog_is(name, name_len, "frames")) {
+        ret = pico_sim_qlog_elements(value, value_len, pico_sim_summary_frame, ctx);
+    }
+    return ret;
+}
+
+static int pico_sim_summary_has_rtt(void* ctx, char const* name, size_t name_len, char const* value, size_t value_len)
+{
+    (void)value;
+    (void)value_len;
+    if (pico_sim_qlog_is(name, name_len, "latest_rtt")) {
+        *(int*)ctx = 1;
+    }
+    return 0;
+}
+
+static int pico_sim_summary_event(void* ctx, pico_sim_qlog_event_t const* ev)
+{
+    int ret = 0;
+    pico_sim_summary_ctx_t* s_ctx = (pico_sim_summary_ctx_t*)ctx;
+    pico_sim_summary_cnx_t* cnx = s_ctx->cnx;
+    uint64_t path_id = (ev->path_id < PICO_SIM_SUMMARY_PATH_MAX) ? ev->path_id : PICO_SIM_SUMMARY_PATH_MAX - 1;
+    pico_sim_cc_state_t* cc_state = &s_ctx->cc_state[path_id];
+
+    if (!cnx->has_events) {
+        cnx->has_events = 1;
+        cnx->first_time = ev->event_time;
+    }
+
+    if (pico_sim_cc_update(cc_state, ev)) {
+        int has_rtt = 0;
+
+        if (s_ctx->result != NULL) {
+            ret = pico_sim_summary_add_series(s_ctx->result, s_ctx->cnx_index, path_id, cc_state);
+        }
+        if (ev->data != NULL) {
+            (void)pico_sim_qlog_members(ev->data, ev->data_len, pico_sim_summary_has_rtt, &has_rtt);
+        }
+        if (has_rtt) {
+            uint64_t queue_delay = (cc_state->latest_rtt > cc_state->min_rtt) ? cc_state->latest_rtt - cc_state->min_rtt : 0;
+
+            if (ret == 0) {
+                ret = pico_sim_summary_add_sample(&cnx->rtt, cc_state->latest_rtt);
+            }
+            if (ret == 0) {
+                ret = pico_sim_summary_add_sample(&cnx->queue_delay, queue_delay);
+            }
+            if (queue_delay > cnx->queue_delay_max) {
+                cnx->queue_delay_max = queue_delay;
+            }
+        }
+    }
+    else if (pico_sim_qlog_is(ev->category, ev->category_len, "recovery")) {
+        if (pico_sim_qlog_is(ev->event, ev->event_len, "packet_lost")) {
+            cnx->nb_losses++;
+        }
+    }
+    else if (pico_sim_qlog_is(ev->category, ev->category_len, "transport") && ev->data != NULL) {
+        pico_sim_summary_packet_t packet = { 0 };
+
+        packet.cnx = cnx;
+        if (pico_sim_qlog_is(ev->event, ev->event_len, "packet_sent")) {
+            packet.is_sent = 1;
+        }
+        else if (!pico_sim_qlog_is(ev->event, ev->event_len, "packet_received")) {
+            packet.cnx = NULL;
+        }
+        if (packet.cnx != NULL) {
+            ret = pico_sim_qlog_members(ev->data, ev->data_len, pico_sim_summary_packet_member, &packet);
+            if (packet.has_data) {
+                cnx->last_data_time = ev->event_time;
+            }
+            if (packet.has_ecn && packet.ecn_ce > s_ctx->ecn_ce[path_id]) {
+                /* The counts are cumulative, per path */
+                cnx->nb_ce_marks += packet.ecn_ce - s_ctx->ecn_ce[path_id];
+                s_ctx->ecn_ce[path_id] = packet.ecn_ce;
+            }
+        }
+    }
+    return ret;
+}
+
+static int pico_sim_summary_compare_u64(const void* a, const void* b)
+{
+    uint64_t x = *(uint64_t const*)a;
+    uint64_t y = *(uint64_t const*)b;
+    return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+/* Nearest rank percentile of sorted samples */
+static uint64_t pico_sim_summary_percentile(pico_sim_summary_samples_t const* samples, size_t percent)
+{
+    uint64_t v = 0;
+
+    if (samples->nb > 0) {
+        size_t rank = (samples->nb * percent + 99) / 100;
+        v = samples->v[(rank > 0) ? rank - 1 : 0];
+    }
+    return v;
+}
+
+static void pico_sim_summary_metrics(pico_sim_summary_metrics_t* m, uint64_t first_time, uint64_t last_data_time,
+    pico_sim_summary_samples_t* rtt, pico_sim_summary_samples_t* queue_delay)
+{
+    uint64_t rtt_sum = 0;
+    uint64_t queue_delay_sum = 0;
+
+    if (last_data_time > first_time) {
+        m->completion_time = last_data_time - first_time;
+        /* bits per microsecond is megabits per second */
+        m->goodput_mbps = ((double)(m->bytes_sent + m->bytes_received)) * 8.0 / ((double)m->completion_time);
+    }
+    qsort(rtt->v, rtt->nb, sizeof(uint64_t), pico_sim_summary_compare_u64);
+    qsort(queue_delay->v, queue_delay->nb, sizeof(uint64_t), pico_sim_summary_compare_u64);
+    for (size_t i = 0; i < rtt->nb; i++) {
+        rtt_sum += rtt->v[i];
+    }
+    for (size_t i = 0; i < queue_delay->nb; i++) {
+        queue_delay_sum += queue_delay->v[i];
+    }
+    if (rtt->nb > 0) {
+        m->rtt_mean = ((double)rtt_sum) / ((double)rtt->nb);
+    }
+    if (queue_delay->nb > 0) {
+        m->queue_delay_mean = ((double)queue_delay_sum) / ((double)queue_delay->nb);
+    }
+    m->rtt_p50 = pico_sim_summary_percentile(rtt, 50);
+    m->rtt_p95 = pico_sim_summary_percentile(rtt, 95);
+    m->rtt_p99 = pico_sim_summary_percentile(rtt, 99);
+    m->queue_delay_p99 = pico_sim_summary_percentile(queue_delay, 99);
+}
+
+/* Jain's fairness index: (sum x)^2 / (n * sum x^2) */
+static double pico_sim_summary_jain(pico_sim_summary_metrics_t const* m, size_t nb_cnx)
+{
+    double sum = 0;
+    double sum_squares = 0;
+    double jain = 0;
+
+    for (size_t i = 0; i < nb_cnx; i++) {
+        sum += m[i].goodput_mbps;
+        sum_squares += m[i].goodput_mbps * m[i].goodput_mbps;
+    }
+    if (sum_squares > 0) {
+        jain = (sum * sum) / (((double)nb_cnx) * sum_squares);
+    }
+    return jain;
+}
+
+static void pico_sim_summary_json_string(FILE* F, char const* s)
+{
+    fputc('"', F);
+    while (*s != 0) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', F);
+        }
+        fputc(*s, F);
+        s++;
+    }
+    fputc('"', F);
+}
+
+static void pico_sim_summary_json_metrics(FILE* F, pico_sim_summary_metrics_t const* m)
+{
+    fprintf(F, "\"bytes_sent\": %llu, \"bytes_received\": %llu, \"completion_time\": %llu, \"goodput_mbps\": %.6f, ",
+        (unsigned long long)m->bytes_sent, (unsigned long long)m->bytes_received,
+        (unsigned long long)m->completion_time, m->goodput_mbps);
+    fprintf(F, "\"rtt_mean\": %.1f, \"rtt_p50\": %llu, \"rtt_p95\": %llu, \"rtt_p99\": %llu, ",
+        m->rtt_mean, (unsigned long long)m->rtt_p50, (unsigned long long)m->rtt_p95, (unsigned long long)m->rtt_p99);
+    fprintf(F, "\"queue_delay_mean\": %.1f, \"queue_delay_p99\": %llu, \"queue_delay_max\": %llu, \"nb_losses\": %llu, \"nb_ce_marks\": %llu",
+        m->queue_delay_mean, (unsigned long long)m->queue_delay_p99, (unsigned long long)m->queue_delay_max,
+        (unsigned long long)m->nb_losses, (unsigned long long)m->nb_ce_marks);
+}
+
+static void pico_sim_summary_csv_metrics(FILE* F, pico_sim_summary_metrics_t const* m, double jain)
+{
+    fprintf(F, "%llu, %llu, %llu, %.6f, %.1f, %llu, %llu, %llu, %.1f, %llu, %llu, %llu, %llu, %.6f\n",
+        (unsigned long long)m->bytes_sent, (unsigned long long)m->bytes_received,
+        (unsigned long long)m->completion_time, m->goodput_mbps,
+        m->rtt_mean, (unsigned long long)m->rtt_p50, (unsigned long long)m->rtt_p95, (unsigned long long)m->rtt_p99,
+        m->queue_delay_mean, (unsigned long long)m->queue_delay_p99, (unsigned long long)m->queue_delay_max,
+        (unsigned long long)m->nb_losses, (unsigned long long)m->nb_ce_marks, jain);
+}
+
+int pico_sim_summary_write(char const* name, pico_sim_summary_format_enum summary_format,
+    pico_sim_result_t const* result, FILE* err_fd)
+{
+    int ret = 0;
+    char summary_name[512];
+    FILE* F;
+
+    (void)snprintf(summary_name, sizeof(summary_name), "%s_summary.%s", name,
+        (summary_format == pico_sim_summary_json) ? "json" : "csv");
+    if ((F = picoquic_file_open(summary_name, "w")) == NULL) {
+        fprintf(err_fd, "Cannot create summary <%s>\n", summary_name);
+        ret = -1;
+    }
+    else {
+        if (summary_format == pico_sim_summary_json) {
+            fprintf(F, "{ \"name\": ");
+            pico_sim_summary_json_string(F, name);
+            fprintf(F, ", \"nb_connections\": %zu, \"jain_index\": %.6f,\n  \"total\": { ", result->nb_cnx, result->jain_index);
+            pico_sim_summary_json_metrics(F, &result->total);
+            fprintf(F, " },\n  \"connections\": [");
+            for (size_t i = 0; i < result->nb_cnx; i++) {
+                fprintf(F, "%s\n    { \"qlog\": ", (i == 0) ? "" : ",");
+                pico_sim_summary_json_string(F, result->qlog_names[i]);
+                fprintf(F, ", ");
+                pico_sim_summary_json_metrics(F, &result->cnx[i]);
+                fprintf(F, " }");
+            }
+            fprintf(F, "]\n}\n");
+        }
+        else {
+            fprintf(F, "connection, qlog, bytes_sent, bytes_received, completion_time, goodput_mbps, ");
+            fprintf(F, "rtt_mean, rtt_p50, rtt_p95, rtt_p99, queue_delay_mean, queue_delay_p99, queue_delay_max, ");
+            fprintf(F, "nb_losses, nb_ce_marks, jain_index\n");
+            for (size_t i = 0; i < result->nb_cnx; i++) {
+                fprintf(F, "%zu, %s, ", i, result->qlog_names[i]);
+                pico_sim_summary_csv_metrics(F, &result->cnx[i], result->jain_index);
+            }
+            fprintf(F, "all, -, ");
+            pico_sim_summary_csv_metrics(F, &result->total, result->jain_index);
+        }
+        (void)picoquic_file_close(F);
+        fprintf(err_fd, "Summary of %zu connections written to <%s>\n", result->nb_cnx, summary_name);
+    }
+    return ret;
+}
+
+/* Scan of the qlogs, each in its own slot, possibly in parallel. The
+ * time series of each qlog are also built in its own slot. */
+typedef struct st_pico_sim_summary_scan_t {
+    char** names;
+    pico_sim_summary_cnx_t* cnx;
+    pico_sim_result_t* series;
+} pico_sim_summary_scan_t;
+
+static int pico_sim_summary_scan(void* ctx, size_t item, char* message, size_t message_size)
+{
+    int ret = 0;
+    pico_sim_summary_scan_t* scan = (pico_sim_summary_scan_t*)ctx;
+    pico_sim_summary_ctx_t* s_ctx = (pico_sim_summary_ctx_t*)calloc(1, sizeof(pico_sim_summary_ctx_t));
+
+    if (s_ctx == NULL) {
+        ret = -1;
+    }
+    else {
+        s_ctx->cnx = &scan->cnx[item];
+        s_ctx->cnx->qlog_name = scan->names[item];
+        s_ctx->result = (scan->series == NULL) ? NULL : &scan->series[item];
+        s_ctx->cnx_index = item;
+        if (pico_sim_qlog_scan(scan->names[item], pico_sim_summary_event, s_ctx) != 0) {
+            (void)snprintf(message, message_size, "Cannot parse qlog <%s>", scan->names[item]);
+            ret = -1;
+        }
+        free(s_ctx);
+    }
+    return ret;
+}
+
+/* Concatenate the time series of the qlogs, in the order of the qlogs */
+static int pico_sim_summary_merge_series(pico_sim_result_t* result, pico_sim_result_t const* parts, size_t nb_parts)
+{
+    int ret = 0;
+    size_t nb_samples = 0;
+
+    for (size_t i = 0; i < nb_parts; i++) {
+        nb_samples += parts[i].nb_samples;
+    }
+    for (int c = 0; ret == 0 && nb_samples > 0 && c < pico_sim_series_nb; c++) {
+        if ((result->series[c] = (uint64_t*)malloc(nb_samples * sizeof(uint64_t))) == NULL) {
+            ret = -1;
+        }
+        else {
+            size_t n = 0;
+
+            for (size_t i = 0; i < nb_parts; i++) {
+                if (parts[i].nb_samples > 0) {
+                    memcpy(&result->series[c][n], parts[i].series[c], parts[i].nb_samples * sizeof(uint64_t));
+                    n += parts[i].nb_samples;
+                }
+            }
+        }
+    }
+    if (ret == 0) {
+        result->nb_samples = nb_samples;
+        result->nb_samples_max = nb_samples;
+    }
+    return ret;
+}
+
+int pico_sim_summary_compute(pico_sim_run_files_t const* run_files, pico_sim_result_t* result,
+    int with_series, int nb_threads, FILE* err_fd)
+{
+    int ret = 0;
+    char** names = NULL;
+    size_t nb_names = 0;
+    pico_sim_summary_scan_t scan;
+    pico_sim_summary_cnx_t* cnx = NULL;
+    pico_sim_result_t* series = NULL;
+    pico_sim_summary_metrics_t* m = NULL;
+    pico_sim_summary_metrics_t total = { 0 };
+    pico_sim_summary_samples_t total_rtt = { 0 };
+    pico_sim_summary_samples_t total_queue_delay = { 0 };
+    uint64_t total_first = UINT64_MAX;
+    uint64_t total_last = 0;
+
+    memset(result, 0, sizeof(pico_sim_result_t));
+
+    if ((ret = pico_sim_list_run_qlogs(run_files, ".server.qlog", &names, &nb_names)) == 0 && nb_names == 0) {
+        pico_sim_free_file_list(names, nb_names);
+        names = NULL;
+        ret = pico_sim_list_run_qlogs(run_files, ".qlog", &names, &nb_names);
+    }
+    if (ret != 0) {
+        fprintf(err_fd, "Cannot list the qlogs of the run\n");
+    }
+    else if ((cnx = (pico_sim_summary_cnx_t*)calloc(nb_names + 1, sizeof(pico_sim_summary_cnx_t))) == NULL ||
+        (m = (pico_sim_summary_metrics_t*)calloc(nb_names + 1, sizeof(pico_sim_summary_metrics_t))) == NULL ||
+        (result->qlog_names = (char**)calloc(nb_names + 1, sizeof(char*))) == NULL ||
+        (with_series && (series = (pico_sim_result_t*)calloc(nb_names + 1, sizeof(pico_sim_result_t))) == NULL)) {
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        scan.names = names;
+        scan.cnx = cnx;
+        scan.series = series;
+        ret = pico_sim_parallel_for("Summary", nb_names, nb_threads, pico_sim_summary_scan, &scan, err_fd);
+    }
+
+    if (ret == 0 && series != NULL) {
+        ret = pico_sim_summary_merge_series(result, series, nb_names);
+    }
+
+    if (ret == 0) {
+        /* The result keeps the names, and frees them even if the rest fails */
+        for (size_t i = 0; i < nb_names; i++) {
+            result->qlog_names[i] = names[i];
+            names[i] = NULL;
+        }
+        result->nb_cnx = nb_names;
+    }
+
+    for (size_t i = 0; ret == 0 && i < nb_names; i++) {
+        for (size_t j = 0; j < cnx[i].nb_streams; j++) {
+            m[i].bytes_sent += cnx[i].streams[j].sent;
+            m[i].bytes_received += cnx[i].streams[j].received;
+        }
+        m[i].nb_losses = cnx[i].nb_losses;
+        m[i].nb_ce_marks = cnx[i].nb_ce_marks;
+        m[i].queue_delay_max = cnx[i].queue_delay_max;
+        for (size_t j = 0; ret == 0 && j < cnx[i].rtt.nb; j++) {
+            ret = pico_sim_summary_add_sample(&total_rtt, cnx[i].rtt.v[j]);
+        }
+        for (size_t j = 0; ret == 0 && j < cnx[i].queue_delay.nb; j++) {
+            ret = pico_sim_summary_add_sample(&total_queue_delay, cnx[i].queue_delay.v[j]);
+        }
+        pico_sim_summary_metrics(&m[i], cnx[i].first_time, cnx[i].last_data_time, &cnx[i].rtt, &cnx[i].queue_delay);
+
+        total.bytes_sent += m[i].bytes_sent;
+        total.bytes_received += m[i].bytes_received;
+        total.nb_losses += m[i].nb_losses;
+        total.nb_ce_marks += m[i].nb_ce_marks;
+        if (m[i].queue_delay_max > total.queue_delay_max) {
+            total.queue_delay_max = m[i].queue_delay_max;
+        }
+        if (cnx[i].has_events && cnx[i].first_time < total_first) {
+            total_first = cnx[i].first_time;
+        }
+        if (cnx[i].last_data_time > total_last) {
+            total_last = cnx[i].last_data_time;
+        }
+    }
+
+    if (ret == 0) {
+        pico_sim_summary_metrics(&total, total_first, total_last, &total_rtt, &total_queue_delay);
+        result->cnx = m;
+        result->total = total;
+        result->jain_index = pico_sim_summary_jain(m, nb_names);
+        m = NULL;
+    }
+    else {
+        pico_sim_result_release(result);
+    }
+
+    if (cnx != NULL) {
+        for (size_t i = 0; i < nb_names; i++) {
+            if (cnx[i].streams != NULL) {
+                free(cnx[i].streams);
+            }
+            if (cnx[i].rtt.v != NULL) {
+                free(cnx[i].rtt.v);
+            }
+            if (cnx[i].queue_delay.v != NULL) {
+                free(cnx[i].queue_delay.v);
+            }
+        }
+        free(cnx);
+    }
+    if (total_rtt.v != NULL) {
+        free(total_rtt.v);
+    }
+    if (total_queue_delay.v != NULL) {
+        free(total_queue_delay.v);
+    }
+    if (m != NULL) {
+        free(m);
+    }
+    if (series != NULL) {
+        for (size_t i = 0; i < nb_names; i++) {
+            pico_sim_result_release(&series[i]);
+        }
+        free(series);
+    }
+    pico_sim_free_file_list(names, nb_names);
+
+    return ret;
+}
+
+int pico_sim_summary(pico_sim_run_files_t const* run_files, char const* name,
+    pico_sim_summary_format_enum summary_format, int nb_threads, FILE* err_fd)
+{
+    int ret = 0;
+    pico_sim_result_t result;
+
+    if ((ret = pico_sim_summary_compute(run_files, &result, 0, nb_threads, err_fd)) == 0) {
+        ret = pico_sim_summary_write(name, summary_format, &result, err_fd);
+        pico_sim_result_release(&result);
+    }
+    return ret;
+}
+
+/* Metrics of connection cnx_index, or of the whole run if cnx_index is
+ * the number of connections, in the order of the CSV columns */
+void pico_sim_summary_values(pico_sim_result_t const* result, size_t cnx_index, double* values)
+{
+    pico_sim_summary_metrics_t const* m = (cnx_index >= result->nb_cnx) ? &result->total : &result->cnx[cnx_index];
+
+    values[0] = (double)m->bytes_sent;
+    values[1] = (double)m->bytes_received;
+    values[2] = (double)m->completion_time;
+    values[3] = m->goodput_mbps;
+    values[4] = m->rtt_mean;
+    values[5] = (double)m->rtt_p50;
+    values[6] = (double)m->rtt_p95;
+    values[7] = (double)m->rtt_p99;
+    values[8] = m->queue_delay_mean;
+    values[9] = (double)m->queue_delay_p99;
+    values[10] = (double)m->queue_delay_max;
+    values[11] = (double)m->nb_losses;
+    values[12] = (double)m->nb_ce_marks;
+    values[13] = result->jain_index;
+}
+
+int pico_sim_summary_metric_id(char const* name, size_t name_len)
+{
+    int metric_id = -1;
+
+    for (size_t i = 0; i < PICO_SIM_SUMMARY_METRICS_NB; i++) {
+        if (pico_sim_qlog_is(name, name_len, pico_sim_summary_metric_names[i])) {
+            metric_id = (int)i;
+            break;
+        }
+    }
+    return metric_id;
+}
+
+static double pico_sim_summary_double(char const* value, size_t value_len)
+{
+    char buffer[64];
+
+    if (value_len >= sizeof(buffer)) {
+        value_len = sizeof(buffer) - 1;
+    }
+    memcpy(buffer, value, value_len);
+    buffer[value_len] = 0;
+    return strtod(buffer, NULL);
+}
+
+static int pico_sim_summary_json_member(void* ctx, char const* name, size_t name_len, char const* value, size_t value_len)
+{
+    int ret = 0;
+    double* values = (double*)ctx;
+    int metric_id;
+
+    if (pico_sim_qlog_is(name, name_len, "total")) {
+        ret = pico_sim_qlog_members(value, value_len, pico_sim_summary_json_member, ctx);
+    }
+    else if ((metric_id = pico_sim_summary_metric_id(name, name_len)) >= 0) {
+        values[metric_id] = pico_sim_summary_double(value, value_len);
+    }
+    return ret;
+}
+
+/* Read the metrics of the whole run from a summary file */
+int pico_sim_summary_read(char const* name, pico_sim_summary_format_enum summary_format, double* values)
+{
+    int ret = 0;
+    char summary_name[512];
+    FILE* F;
+
+    (void)snprintf(summary_name, sizeof(summary_name), "%s_summary.%s", name,
+        (summary_format == pico_sim_summary_json) ? "json" : "csv");
+    if ((F = picoquic_file_open(summary_name, "rb")) == NULL) {
+        ret = -1;
+    }
+    else if (summary_format == pico_sim_summary_json) {
+        char* text = NULL;
+        long text_len = 0;
+
+        if (fseek(F, 0, SEEK_END) != 0 || (text_len = ftell(F)) <= 0 || fseek(F, 0, SEEK_SET) != 0 ||
+            (text = (char*)malloc((size_t)text_len)) == NULL ||
+            fread(text, 1, (size_t)text_len, F) != (size_t)text_len ||
+            pico_sim_qlog_members(text, (size_t)text_len, pico_sim_summary_json_member, values) != 0) {
+            ret = -1;
+        }
+        if (text != NULL) {
+            free(text);
+        }
+        (void)picoquic_file_close(F);
+    }
+    else {
+        char line[1024];
+
+        ret = -1;
+        while (fgets(line, sizeof(line), F) != NULL) {
+            if (strncmp(line, "all,", 4) == 0) {
+                char const* x = strchr(line + 4, ',');
+
+                ret = 0;
+                for (size_t i = 0; ret == 0 && i < PICO_SIM_SUMMARY_METRICS_NB; i++) {
+                    char* end = NULL;
+
+                    if (x == NULL) {
+                        ret = -1;
+                    }
+                    else {
+                        values[i] = strtod(x + 1, &end);
+                        ret = (end == x + 1) ? -1 : 0;
+                        x = strchr(end, ',');
+                    }
+                }
+                break;
+            }
+        }
+        (void)picoquic_file_close(F);
+    }
+    return ret;
+}
+
+void pico_sim_result_release(pico_sim_result_t* result)
+{
+    if (result->qlog_names != NULL) {
+        pico_sim_free_file_list(result->qlog_names, result->nb_cnx);
+    }
+    if (result->cnx != NULL) {
+        free(result->cnx);
+    }
+    for (int i = 0; i < pico_sim_series_nb; i++) {
+        if (result->series[i] != NULL) {
+            free(result->series[i]);
+        }
+    }
+    memset(result, 0, sizeof(pico_sim_result_t));
+}
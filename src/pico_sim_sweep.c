@@ -0,0 +1,442 @@
+/* Parameter sweeps for pico_sim.
+* A spec parameter can be given as a list of values, "{v1,v2,v3}",
+* or as a numeric range, "first..last step increment". The sweep
+* keeps the text of each value, and the values are applied to a
+* copy of the parsed spec with the same parser as the spec file.
+*
+* Spec variants are named sets of parameter values, each applied on top
+* of the base spec. When the spec has both, each variant is combined with
+* each point of the cartesian product of the swept values. Each
+* combination is a separate spec, simulated from the start.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include "picoquic.h"
+#include "picoquic_ns.h"
+#include "pico_sim.h"
+
+int pico_sim_is_sweep_value(char const* value)
+{
+    size_t l = strlen(value);
+
+    return ((l >= 2 && value[0] == '{' && value[l - 1] == '}') ||
+        (isdigit((unsigned char)value[0]) && strstr(value, "..") != NULL));
+}
+
+static int pico_sim_sweep_add_value(pico_sim_sweep_dim_t* dim, char const* value, size_t l)
+{
+    int ret = 0;
+    char* v = NULL;
+
+    if (dim->nb_values >= PICO_SIM_SWEEP_VALUES_MAX) {
+        ret = -1;
+    }
+    else if (dim->nb_values >= dim->nb_values_max) {
+        /* Grow the list of values as they are added */
+        size_t new_max = (dim->nb_values_max == 0) ? 16 : 2 * dim->nb_values_max;
+        char** new_values = (char**)realloc(dim->values, sizeof(char*) * new_max);
+
+        if (new_values == NULL) {
+            ret = -1;
+        }
+        else {
+            dim->values = new_values;
+            dim->nb_values_max = new_max;
+        }
+    }
+    if (ret == 0 && (v = (char*)malloc(l + 1)) == NULL) {
+        ret = -1;
+    }
+    if (ret == 0) {
+        memcpy(v, value, l);
+        v[l] = 0;
+        dim->values[dim->nb_values++] = v;
+    }
+    return ret;
+}
+
+/* List of values: "{v1, v2, v3}" */
+static int pico_sim_sweep_parse_list(pico_sim_sweep_dim_t* dim, char const* value)
+{
+    int ret = 0;
+    char const* x = value + 1;
+
+    while (ret == 0 && *x != 0 && *x != '}') {
+        char const* start;
+        size_t l;
+
+        while (isspace((unsigned char)*x)) {
+            x++;
+        }
+        start = x;
+        while (*x != 0 && *x != ',' && *x != '}') {
+            x++;
+        }
+        l = x - start;
+        while (l > 0 && isspace((unsigned char)start[l - 1])) {
+            l--;
+        }
+        if (l == 0) {
+            ret = -1;
+        }
+        else {
+            ret = pico_sim_sweep_add_value(dim, start, l);
+        }
+        if (*x == ',') {
+            x++;
+        }
+    }
+    if (ret == 0 && (*x != '}' || x[1] != 0 || dim->nb_values == 0)) {
+        ret = -1;
+    }
+    return ret;
+}
+
+/* Range of values: "first..last" or "first..last step increment".
+ * The values are integers unless one of the numbers has decimals. */
+static int pico_sim_sweep_parse_range(pico_sim_sweep_dim_t* dim, char const* value)
+{
+    int ret = 0;
+    char first[64];
+    char last[64];
+    char step[64];
+    char const* x = value;
+    size_t l = 0;
+    int is_decimal = 0;
+
+    step[0] = '1';
+    step[1] = 0;
+    while (l < sizeof(first) - 1 && *x != 0 && !(x[0] == '.' && x[1] == '.')) {
+        first[l++] = *x++;
+    }
+    first[l] = 0;
+    if (x[0] != '.' || x[1] != '.') {
+        ret = -1;
+    }
+    else {
+        x += 2;
+        l = 0;
+        while (l < sizeof(last) - 1 && *x != 0 && !isspace((unsigned char)*x)) {
+            last[l++] = *x++;
+        }
+        last[l] = 0;
+        while (isspace((unsigned char)*x)) {
+            x++;
+        }
+        if (*x != 0) {
+            if (strncmp(x, "step", 4) != 0 || !isspace((unsigned char)x[4])) {
+                ret = -1;
+            }
+            else {
+                x += 4;
+                while (isspace((unsigned char)*x)) {
+                    x++;
+                }
+                l = 0;
+                while (l < sizeof(step) - 1 && *x != 0 && !isspace((unsigned char)*x)) {
+                    step[l++] = *x++;
+                }
+                step[l] = 0;
+                if (*x != 0 || l == 0) {
+                    ret = -1;
+                }
+            }
+        }
+    }
+    if (ret == 0) {
+        is_decimal = (strchr(first, '.') != NULL || strchr(last, '.') != NULL || strchr(step, '.') != NULL);
+    }
+    if (ret == 0 && !is_decimal) {
+        uint64_t v_first = 0;
+        uint64_t v_last = 0;
+        uint64_t v_step = 0;
+
+        if (parse_u64(&v_first, first) != 0 || parse_u64(&v_last, last) != 0 || parse_u64(&v_step, step) != 0 ||
+            v_step == 0 || v_last < v_first || (v_last - v_first) / v_step >= PICO_SIM_SWEEP_VALUES_MAX) {
+            ret = -1;
+        }
+        else {
+            for (uint64_t v = v_first; ret == 0 && v <= v_last; v += v_step) {
+                char text[32];
+                int n = snprintf(text, sizeof(text), "%llu", (unsigned long long)v);
+                ret = pico_sim_sweep_add_value(dim, text, (size_t)n);
+                if (v_last - v < v_step) {
+                    break;
+                }
+            }
+        }
+    }
+    else if (ret == 0) {
+        double d_first = 0;
+        double d_last = 0;
+        double d_step = 0;
+
+        if (parse_double(&d_first, first) != 0 || parse_double(&d_last, last) != 0 || parse_double(&d_step, step) != 0 ||
+            d_step <= 0 || d_last < d_first || (d_last - d_first) / d_step >= PICO_SIM_SWEEP_VALUES_MAX) {
+            ret = -1;
+        }
+        else {
+            /* Compute the number of values first, tolerating rounding errors */
+            size_t nb_values = (size_t)((d_last - d_first) / d_step + 1e-9) + 1;
+            for (size_t i = 0; ret == 0 && i < nb_values; i++) {
+                char text[64];
+                int n = snprintf(text, sizeof(text), "%.9f", d_first + d_step * (double)i);
+                while (n > 1 && text[n - 1] == '0' && text[n - 2] != '.') {
+                    n--;
+                }
+                ret = pico_sim_sweep_add_value(dim, text, (size_t)n);
+            }
+        }
+    }
+    return ret;
+}
+
+int pico_sim_sweep_add(pico_sim_sweep_t* sweep, int param_id, char const* param_name, char const* value)
+{
+    int ret = 0;
+    pico_sim_sweep_dim_t* dim = NULL;
+
+    for (size_t i = 0; i < sweep->nb_dims; i++) {
+        if (sweep->dims[i].param_id == param_id) {
+            fprintf(stderr, "Parameter %s is swept twice\n", param_name);
+            ret = -1;
+        }
+    }
+    if (ret == 0 && sweep->nb_dims >= PICO_SIM_SWEEP_DIM_MAX) {
+        fprintf(stderr, "Too many swept parameters, max %d\n", PICO_SIM_SWEEP_DIM_MAX);
+        ret = -1;
+    }
+    if (ret == 0) {
+        dim = &sweep->dims[sweep->nb_dims];
+        memset(dim, 0, sizeof(pico_sim_sweep_dim_t));
+        dim->param_id = param_id;
+        dim->param_name = param_name;
+        sweep->nb_dims++;
+        ret = (value[0] == '{') ? pico_sim_sweep_parse_list(dim, value) : pico_sim_sweep_parse_range(dim, value);
+        if (ret != 0) {
+            fprintf(stderr, "Cannot parse the values of %s: %s\n", param_name, value);
+        }
+    }
+    if (ret == 0) {
+        /* Check that each value is valid for the parameter */
+        for (size_t i = 0; ret == 0 && i < dim->nb_values; i++) {
+            pico_sim_spec_t test_spec = { 0 };
+            ret = parse_param_by_id(&test_spec, param_id, dim->values[i]);
+            release_spec_data(&test_spec);
+        }
+    }
+    if (ret == 0 && pico_sim_sweep_nb_points(sweep) > PICO_SIM_SWEEP_POINTS_MAX) {
+        fprintf(stderr, "Too many points in sweep, max %d\n", PICO_SIM_SWEEP_POINTS_MAX);
+        ret = -1;
+    }
+    return ret;
+}
+
+static size_t pico_sim_sweep_nb_dim_points(pico_sim_sweep_t const* sweep)
+{
+    size_t nb_points = 1;
+
+    for (size_t i = 0; i < sweep->nb_dims; i++) {
+        if (nb_points > PICO_SIM_SWEEP_POINTS_MAX) {
+            break;
+        }
+        nb_points *= sweep->dims[i].nb_values;
+    }
+    return nb_points;
+}
+
+/* The variants are the outer loop: point = variant * nb_dim_points + dim_point */
+size_t pico_sim_sweep_nb_points(pico_sim_sweep_t const* sweep)
+{
+    size_t nb_points = pico_sim_sweep_nb_dim_points(sweep);
+
+    if (sweep->nb_variants > 0 && nb_points <= PICO_SIM_SWEEP_POINTS_MAX) {
+        nb_points *= sweep->nb_variants;
+    }
+    return nb_points;
+}
+
+/* The last parameter in the spec varies fastest */
+char const* pico_sim_sweep_value(pico_sim_sweep_t const* sweep, size_t dim, size_t point)
+{
+    for (size_t i = sweep->nb_dims - 1; i > dim; i--) {
+        point /= sweep->dims[i].nb_values;
+    }
+    return sweep->dims[dim].values[point % sweep->dims[dim].nb_values];
+}
+
+pico_sim_variant_t const* pico_sim_sweep_variant(pico_sim_sweep_t const* sweep, size_t point)
+{
+    pico_sim_variant_t const* variant = NULL;
+
+    if (sweep->nb_variants > 0) {
+        variant = &sweep->variants[(point / pico_sim_sweep_nb_dim_points(sweep)) % sweep->nb_variants];
+    }
+    return variant;
+}
+
+int pico_sim_sweep_apply(pico_sim_spec_t* spec, pico_sim_sweep_t const* sweep, size_t point)
+{
+    int ret = 0;
+    pico_sim_variant_t const* variant = pico_sim_sweep_variant(sweep, point);
+
+    for (size_t i = 0; ret == 0 && i < sweep->nb_dims; i++) {
+        ret = parse_param_by_id(spec, sweep->dims[i].param_id, pico_sim_sweep_value(sweep, i, point));
+    }
+    for (size_t i = 0; ret == 0 && variant != NULL && i < variant->nb_params; i++) {
+        ret = parse_param_by_id(spec, variant->param_id[i], variant->values[i]);
+    }
+    return ret;
+}
+
+int pico_sim_sweep_is_set(pico_sim_sweep_t const* sweep)
+{
+    return (sweep->nb_dims > 0 || sweep->nb_variants > 0);
+}
+
+/* Name of the simulation of a point: "<name>_p<n>" for a sweep, "<name>_<variant>"
+ * for a variant, "<name>_<variant>_p<n>" for a point of the sweep in a variant. */
+void pico_sim_sweep_point_name(char* name, size_t name_size, char const* base_name,
+    pico_sim_sweep_t const* sweep, size_t point)
+{
+    pico_sim_variant_t const* variant = pico_sim_sweep_variant(sweep, point);
+    size_t dim_point = point % pico_sim_sweep_nb_dim_points(sweep);
+
+    if (variant != NULL && sweep->nb_dims > 0) {
+        (void)snprintf(name, name_size, "%s_%s_p%zu", base_name, variant->name, dim_point);
+    }
+    else if (variant != NULL) {
+        (void)snprintf(name, name_size, "%s_%s", base_name, variant->name);
+    }
+    else if (sweep->nb_dims > 0) {
+        (void)snprintf(name, name_size, "%s_p%zu", base_name, dim_point);
+    }
+    else {
+        (void)snprintf(name, name_size, "%s", base_name);
+    }
+}
+
+/* Variant names are part of file names, and are restricted to letters,
+ * digits, '-' and '_'. */
+int pico_sim_variant_add(pico_sim_sweep_t* sweep, char const* name)
+{
+    int ret = 0;
+    size_t l = strlen(name);
+
+    for (size_t i = 0; ret == 0 && i < l; i++) {
+        if (!isalnum((unsigned char)name[i]) && name[i] != '-' && name[i] != '_') {
+            ret = -1;
+        }
+    }
+    if (l == 0 || ret != 0) {
+        fprintf(stderr, "Invalid variant name: <%s>\n", name);
+        ret = -1;
+    }
+    for (size_t i = 0; ret == 0 && i < sweep->nb_variants; i++) {
+        if (strcmp(sweep->variants[i].name, name) == 0) {
+            fprintf(stderr, "Variant %s is defined twice\n", name);
+            ret = -1;
+        }
+    }
+    if (ret == 0 && sweep->nb_variants >= PICO_SIM_VARIANTS_MAX) {
+        fprintf(stderr, "Too many variants, max %d\n", PICO_SIM_VARIANTS_MAX);
+        ret = -1;
+    }
+    if (ret == 0 && sweep->nb_variants >= sweep->nb_variants_max) {
+        size_t new_max = (sweep->nb_variants_max == 0) ? 16 : 2 * sweep->nb_variants_max;
+        pico_sim_variant_t* new_variants = (pico_sim_variant_t*)realloc(sweep->variants,
+            new_max * sizeof(pico_sim_variant_t));
+        if (new_variants == NULL) {
+            ret = -1;
+        }
+        else {
+            sweep->variants = new_variants;
+            sweep->nb_variants_max = new_max;
+        }
+    }
+    if (ret == 0) {
+        pico_sim_variant_t* variant = &sweep->variants[sweep->nb_variants];
+
+        memset(variant, 0, sizeof(pico_sim_variant_t));
+        if ((variant->name = (char*)malloc(l + 1)) == NULL) {
+            ret = -1;
+        }
+        else {
+            memcpy(variant->name, name, l + 1);
+            sweep->nb_variants++;
+        }
+    }
+    if (ret == 0 && pico_sim_sweep_nb_points(sweep) > PICO_SIM_SWEEP_POINTS_MAX) {
+        fprintf(stderr, "Too many points in sweep, max %d\n", PICO_SIM_SWEEP_POINTS_MAX);
+        ret = -1;
+    }
+    return ret;
+}
+
+/* Add a parameter to the last variant. The swept parameters cannot be overridden. */
+int pico_sim_variant_add_param(pico_sim_sweep_t* sweep, int param_id, char const* param_name, char const* value)
+{
+    int ret = 0;
+    pico_sim_variant_t* variant = &sweep->variants[sweep->nb_variants - 1];
+    pico_sim_spec_t test_spec = { 0 };
+    size_t l = strlen(value);
+
+    for (size_t i = 0; ret == 0 && i < sweep->nb_dims; i++) {
+        if (sweep->dims[i].param_id == param_id) {
+            fprintf(stderr, "Parameter %s is swept, cannot be set in variant %s\n", param_name, variant->name);
+            ret = -1;
+        }
+    }
+    for (size_t i = 0; ret == 0 && i < variant->nb_params; i++) {
+        if (variant->param_id[i] == param_id) {
+            fprintf(stderr, "Parameter %s is set twice in variant %s\n", param_name, variant->name);
+            ret = -1;
+        }
+    }
+    if (ret == 0 && variant->nb_params >= PICO_SIM_VARIANT_PARAMS_MAX) {
+        fprintf(stderr, "Too many parameters in variant %s, max %d\n", variant->name, PICO_SIM_VARIANT_PARAMS_MAX);
+        ret = -1;
+    }
+    if (ret == 0 && (ret = parse_param_by_id(&test_spec, param_id, value)) != 0) {
+        fprintf(stderr, "Cannot parse the value of %s in variant %s: %s\n", param_name, variant->name, value);
+    }
+    release_spec_data(&test_spec);
+    if (ret == 0) {
+        if ((variant->values[variant->nb_params] = (char*)malloc(l + 1)) == NULL) {
+            ret = -1;
+        }
+        else {
+            memcpy(variant->values[variant->nb_params], value, l + 1);
+            variant->param_id[variant->nb_params] = param_id;
+            variant->param_name[variant->nb_params] = param_name;
+            variant->nb_params++;
+        }
+    }
+    return ret;
+}
+
+void pico_sim_sweep_release(pico_sim_sweep_t* sweep)
+{
+    for (size_t i = 0; i < sweep->nb_dims; i++) {
+        if (sweep->dims[i].values != NULL) {
+            for (size_t j = 0; j < sweep->dims[i].nb_values; j++) {
+                free(sweep->dims[i].values[j]);
+            }
+            free(sweep->dims[i].values);
+        }
+    }
+    for (size_t i = 0; i < sweep->nb_variants; i++) {
+        free(sweep->variants[i].name);
+        for (size_t j = 0; j < sweep->variants[i].nb_params; j++) {
+            free(sweep->variants[i].values[j]);
+        }
+    }
+    if (sweep->variants != NULL) {
+        free(sweep->variants);
+    }
+    memset(sweep, 0, sizeof(pico_sim_sweep_t));
+}
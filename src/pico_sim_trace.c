@@ -0,0 +1,192 @@
+/* Compact binary traces.
+* With "trace_format: binary", the qlog files produced by the simulation
+* are converted to a single file of fixed size records, which can be
+* mapped directly with numpy.memmap, see scripts/pico_sim_trace.py.
+* That script can also convert the records back to qlog, for use with qvis.
+*
+* All integers are little endian. The file starts with a 16 bytes header:
+*   0  magic, "PSIMTRC" and a null byte
+*   8  u32 version, 1
+*   12 u32 record size, 64
+* followed by the records:
+*   0  u64 event_time, in microseconds
+*   8  u32 connection, index of the qlog in trace_connections.csv
+*   12 u16 event_type, 1 = metrics_updated, 2 = packet_lost
+*   14 u8  path_id, capped to 255
+*   15 u8  app_limited
+*   16 u64 cwnd
+*   24 u64 bytes_in_flight
+*   32 u64 pacing_rate
+*   40 u64 smoothed_rtt
+*   48 u64 min_rtt
+*   56 u64 latest_rtt
+* The congestion control fields carry the state after the last
+* "metrics_updated" event on the path.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "picoquic.h"
+#include "picoquic_utils.h"
+#include "pico_sim.h"
+#include "pico_sim_qlog.h"
+
+#define PICO_SIM_TRACE_MAGIC "PSIMTRC"
+#define PICO_SIM_TRACE_VERSION 1
+#define PICO_SIM_TRACE_HEADER_SIZE 16
+#define PICO_SIM_TRACE_RECORD_SIZE 64
+#define PICO_SIM_TRACE_PATH_MAX 256
+
+typedef enum {
+    pico_sim_trace_metrics_updated = 1,
+    pico_sim_trace_packet_lost = 2
+} pico_sim_trace_event_enum;
+
+typedef struct st_pico_sim_trace_ctx_t {
+    FILE* F;
+    uint32_t connection;
+    uint64_t nb_records;
+    pico_sim_cc_state_t cc_state[PICO_SIM_TRACE_PATH_MAX];
+} pico_sim_trace_ctx_t;
+
+static uint8_t* pico_sim_trace_le(uint8_t* bytes, uint64_t v, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        *bytes++ = (uint8_t)(v & 0xff);
+        v >>= 8;
+    }
+    return bytes;
+}
+
+static int pico_sim_trace_event(void* ctx, pico_sim_qlog_event_t const* ev)
+{
+    int ret = 0;
+    pico_sim_trace_ctx_t* trace_ctx = (pico_sim_trace_ctx_t*)ctx;
+    uint64_t path_id = (ev->path_id < PICO_SIM_TRACE_PATH_MAX) ? ev->path_id : PICO_SIM_TRACE_PATH_MAX - 1;
+    pico_sim_cc_state_t* cc_state = &trace_ctx->cc_state[path_id];
+    pico_sim_trace_event_enum event_type;
+
+    if (pico_sim_cc_update(cc_state, ev)) {
+        event_type = pico_sim_trace_metrics_updated;
+    }
+    else if (pico_sim_qlog_is(ev->category, ev->category_len, "recovery") &&
+        pico_sim_qlog_is(ev->event, ev->event_len, "packet_lost")) {
+        event_type = pico_sim_trace_packet_lost;
+    }
+    else {
+        event_type = 0;
+    }
+
+    if (event_type != 0) {
+        uint8_t record[PICO_SIM_TRACE_RECORD_SIZE];
+        uint8_t* x = record;
+
+        x = pico_sim_trace_le(x, ev->event_time, 8);
+        x = pico_sim_trace_le(x, trace_ctx->connection, 4);
+        x = pico_sim_trace_le(x, event_type, 2);
+        x = pico_sim_trace_le(x, path_id, 1);
+        x = pico_sim_trace_le(x, (cc_state->app_limited) ? 1 : 0, 1);
+        x = pico_sim_trace_le(x, cc_state->cwnd, 8);
+        x = pico_sim_trace_le(x, cc_state->bytes_in_flight, 8);
+        x = pico_sim_trace_le(x, cc_state->pacing_rate, 8);
+        x = pico_sim_trace_le(x, cc_state->smoothed_rtt, 8);
+        x = pico_sim_trace_le(x, cc_state->min_rtt, 8);
+        (void)pico_sim_trace_le(x, cc_state->latest_rtt, 8);
+        if (fwrite(record, 1, sizeof(record), trace_ctx->F) != sizeof(record)) {
+            ret = -1;
+        }
+        else {
+            trace_ctx->nb_records++;
+        }
+    }
+    return ret;
+}
+
+int pico_sim_trace_convert(char const* qlog_dir, pico_sim_run_files_t* run_files, int remove_qlog, FILE* err_fd)
+{
+    int ret = 0;
+    char** names = NULL;
+    size_t nb_names = 0;
+    char trace_name[1024];
+    char connections_name[1024];
+    FILE* C = NULL;
+    pico_sim_trace_ctx_t* trace_ctx = NULL;
+
+    (void)snprintf(trace_name, sizeof(trace_name), "%s%s%s", qlog_dir, PICO_SIM_PATH_SEP_STR, PICO_SIM_TRACE_FILE);
+    (void)snprintf(connections_name, sizeof(connections_name), "%s%s%s", qlog_dir, PICO_SIM_PATH_SEP_STR, PICO_SIM_TRACE_CONNECTIONS);
+
+    if (pico_sim_list_run_qlogs(run_files, ".qlog", &names, &nb_names) != 0) {
+        ret = -1;
+    }
+    else if ((trace_ctx = (pico_sim_trace_ctx_t*)malloc(sizeof(pico_sim_trace_ctx_t))) == NULL) {
+        ret = -1;
+    }
+    else {
+        memset(trace_ctx, 0, sizeof(pico_sim_trace_ctx_t));
+        if ((trace_ctx->F = picoquic_file_open(trace_name, "wb")) == NULL ||
+            (C = picoquic_file_open(connections_name, "w")) == NULL) {
+            fprintf(err_fd, "Cannot create the binary trace <%s>\n", trace_name);
+            ret = -1;
+        }
+        else {
+            uint8_t header[PICO_SIM_TRACE_HEADER_SIZE];
+            uint8_t* x = header;
+
+            memcpy(x, PICO_SIM_TRACE_MAGIC, 8);
+            x = pico_sim_trace_le(x + 8, PICO_SIM_TRACE_VERSION, 4);
+            (void)pico_sim_trace_le(x, PICO_SIM_TRACE_RECORD_SIZE, 4);
+            if (fwrite(header, 1, sizeof(header), trace_ctx->F) != sizeof(header)) {
+                ret = -1;
+            }
+            fprintf(C, "connection, qlog, nb_records\n");
+        }
+    }
+
+    for (size_t i = 0; ret == 0 && i < nb_names; i++) {
+        uint64_t nb_records_before = trace_ctx->nb_records;
+
+        memset(trace_ctx->cc_state, 0, sizeof(trace_ctx->cc_state));
+        if (pico_sim_qlog_scan(names[i], pico_sim_trace_event, trace_ctx) != 0) {
+            fprintf(err_fd, "Cannot convert qlog <%s>\n", names[i]);
+            ret = -1;
+        }
+        else {
+            fprintf(C, "%u, %s, %llu\n", trace_ctx->connection, names[i],
+                (unsigned long long)(trace_ctx->nb_records - nb_records_before));
+            trace_ctx->connection++;
+            if (remove_qlog) {
+                if (remove(names[i]) != 0) {
+                    fprintf(err_fd, "Cannot remove qlog <%s>\n", names[i]);
+                }
+                else {
+                    pico_sim_run_files_remove(run_files, names[i]);
+                }
+            }
+        }
+    }
+
+    if (trace_ctx != NULL) {
+        if (trace_ctx->F != NULL) {
+            if (ret == 0) {
+                fprintf(err_fd, "Binary trace <%s>: %u connections, %llu records\n", trace_name,
+                    trace_ctx->connection, (unsigned long long)trace_ctx->nb_records);
+            }
+            (void)picoquic_file_close(trace_ctx->F);
+        }
+        free(trace_ctx);
+    }
+    if (C != NULL) {
+        (void)picoquic_file_close(C);
+    }
+    pico_sim_free_file_list(names, nb_names);
+
+    if (ret == 0 && (pico_sim_run_files_add(run_files, trace_name) != 0 ||
+        pico_sim_run_files_add(run_files, connections_name) != 0)) {
+        ret = -1;
+    }
+
+    return ret;
+}
@@ -0,0 +1,240 @@
+/* Summarize qlog files produced by picoquic.
+* Scans each qlog in a single streaming pass, without loading the
+* JSON document in memory, and writes the congestion control vectors
+* of each path to a CSV file, with the same columns as cc_state.cc_vector()
+* in scripts/qlogparse.py, preceded by the path id. Several files can be
+* processed in parallel, one process per file.
+ */
+
+#if !defined(_WINDOWS) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef _WINDOWS
+#include <windows.h>
+#include "../pico_sim_vs/pico_sim_vs/getopt.h"
+#else
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+#include "pico_sim_qlog.h"
+
+#define QLOG_SUMMARIZE_PATH_MAX 256
+
+typedef struct st_qlog_summarize_ctx_t {
+    FILE* F;
+    uint64_t nb_events;
+    uint64_t nb_cc_updates;
+    pico_sim_cc_state_t cc_state[QLOG_SUMMARIZE_PATH_MAX];
+} qlog_summarize_ctx_t;
+
+void usage()
+{
+    fprintf(stderr, "Qlog_summarize, extract congestion control data from qlogs\n\n");
+    fprintf(stderr, "Usage: qlog_summarize [options] qlog_file [qlog_file...]\n\n");
+    fprintf(stderr, "For each qlog file \"<name>.qlog\", writes \"<name>.csv\", with\n");
+    fprintf(stderr, "one row per \"metrics_updated\" event and the columns:\n");
+    fprintf(stderr, "path_id, event_time, cwnd, bytes_in_flight, pacing_rate,\n");
+    fprintf(stderr, "smoothed_rtt, min_rtt, latest_rtt, app_limited.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -o dir   Directory of the CSV files. Default: next to the qlog.\n");
+    fprintf(stderr, "  -j nb    Number of files processed in parallel. Default: 1.\n");
+    fprintf(stderr, "  -h       Print this message.\n");
+}
+
+static int qlog_summarize_event(void* ctx, pico_sim_qlog_event_t const* ev)
+{
+    int ret = 0;
+    qlog_summarize_ctx_t* s_ctx = (qlog_summarize_ctx_t*)ctx;
+    uint64_t path_id = (ev->path_id < QLOG_SUMMARIZE_PATH_MAX) ? ev->path_id : QLOG_SUMMARIZE_PATH_MAX - 1;
+    pico_sim_cc_state_t* cc_state = &s_ctx->cc_state[path_id];
+
+    s_ctx->nb_events++;
+    if (pico_sim_cc_update(cc_state, ev)) {
+        s_ctx->nb_cc_updates++;
+        if (fprintf(s_ctx->F, "%llu, %llu, %llu, %llu, %llu, %llu, %llu, %llu, %llu\n",
+            (unsigned long long)path_id,
+            (unsigned long long)cc_state->event_time,
+            (unsigned long long)cc_state->cwnd,
+            (unsigned long long)cc_state->bytes_in_flight,
+            (unsigned long long)cc_state->pacing_rate,
+            (unsigned long long)cc_state->smoothed_rtt,
+            (unsigned long long)cc_state->min_rtt,
+            (unsigned long long)cc_state->latest_rtt,
+            (unsigned long long)cc_state->app_limited) <= 0) {
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+/* The CSV file has the name of the qlog, with the suffix ".csv"
+ * instead of ".qlog", in the output directory if one is specified.
+ */
+static void qlog_summarize_csv_name(char* csv_name, size_t csv_name_size, char const* qlog_name, char const* out_dir)
+{
+    char const* base_name = qlog_name;
+    size_t base_len;
+
+    if (out_dir != NULL) {
+        for (char const* x = qlog_name; *x != 0; x++) {
+            if (*x == '/' || *x == '\\') {
+                base_name = x + 1;
+            }
+        }
+    }
+    base_len = strlen(base_name);
+    if (base_len > 5 && strcmp(base_name + base_len - 5, ".qlog") == 0) {
+        base_len -= 5;
+    }
+    if (out_dir != NULL) {
+        (void)snprintf(csv_name, csv_name_size, "%s/%.*s.csv", out_dir, (int)base_len, base_name);
+    }
+    else {
+        (void)snprintf(csv_name, csv_name_size, "%.*s.csv", (int)base_len, base_name);
+    }
+}
+
+static int qlog_summarize_file(char const* qlog_name, char const* out_dir)
+{
+    int ret = 0;
+    char csv_name[1024];
+    qlog_summarize_ctx_t* s_ctx = NULL;
+
+    qlog_summarize_csv_name(csv_name, sizeof(csv_name), qlog_name, out_dir);
+
+    if ((s_ctx = (qlog_summarize_ctx_t*)malloc(sizeof(qlog_summarize_ctx_t))) == NULL) {
+        ret = -1;
+    }
+    else {
+        memset(s_ctx, 0, sizeof(qlog_summarize_ctx_t));
+#ifdef _WINDOWS
+        if (fopen_s(&s_ctx->F, csv_name, "w") != 0) {
+            s_ctx->F = NULL;
+        }
+#else
+        s_ctx->F = fopen(csv_name, "w");
+#endif
+        if (s_ctx->F == NULL) {
+            fprintf(stderr, "Cannot create <%s>\n", csv_name);
+            ret = -1;
+        }
+        else {
+            fprintf(s_ctx->F, "path_id, event_time, cwnd, bytes_in_flight, pacing_rate, smoothed_rtt, min_rtt, latest_rtt, app_limited\n");
+            if ((ret = pico_sim_qlog_scan(qlog_name, qlog_summarize_event, s_ctx)) != 0) {
+                fprintf(stderr, "Cannot parse qlog <%s>\n", qlog_name);
+            }
+            else {
+                fprintf(stderr, "%s: %llu events, %llu cc updates, written to %s\n", qlog_name,
+                    (unsigned long long)s_ctx->nb_events, (unsigned long long)s_ctx->nb_cc_updates, csv_name);
+            }
+            if (fclose(s_ctx->F) != 0) {
+                ret = -1;
+            }
+            if (ret != 0) {
+                (void)remove(csv_name);
+            }
+        }
+        free(s_ctx);
+    }
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    int ret = 0;
+    char const* out_dir = NULL;
+    char const* option_string = "o:j:h";
+    int nb_workers = 1;
+    int nb_failed = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, option_string)) != -1) {
+        switch (opt) {
+        case 'o':
+            out_dir = optarg;
+            break;
+        case 'j':
+            if ((nb_workers = atoi(optarg)) <= 0) {
+                fprintf(stderr, "Invalid number of workers: %s\n", optarg);
+                usage();
+                exit(-1);
+            }
+            break;
+        case 'h':
+            usage();
+            exit(0);
+        default:
+            usage();
+            exit(-1);
+        }
+    }
+
+    if (optind >= argc) {
+        fprintf(stderr, "No qlog file.\n");
+        usage();
+        ret = -1;
+    }
+#ifdef _WINDOWS
+    else {
+        /* No fork on Windows: process the files one after the other. */
+        for (int i = optind; i < argc; i++) {
+            if (qlog_summarize_file(argv[i], out_dir) != 0) {
+                nb_failed++;
+            }
+        }
+    }
+#else
+    else if (nb_workers == 1 || optind + 1 == argc) {
+        for (int i = optind; i < argc; i++) {
+            if (qlog_summarize_file(argv[i], out_dir) != 0) {
+                nb_failed++;
+            }
+        }
+    }
+    else {
+        int next_file = optind;
+        int nb_running = 0;
+
+        while (next_file < argc || nb_running > 0) {
+            if (next_file < argc && nb_running < nb_workers) {
+                pid_t pid;
+
+                fflush(stderr);
+                if ((pid = fork()) < 0) {
+                    fprintf(stderr, "Cannot fork a process for <%s>\n", argv[next_file]);
+                    nb_failed++;
+                }
+                else if (pid == 0) {
+                    _exit((qlog_summarize_file(argv[next_file], out_dir) == 0) ? 0 : 1);
+                }
+                else {
+                    nb_running++;
+                }
+                next_file++;
+            }
+            else {
+                int status = 0;
+
+                if (waitpid(-1, &status, 0) <= 0) {
+                    break;
+                }
+                nb_running--;
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                    nb_failed++;
+                }
+            }
+        }
+    }
+#endif
+    if (nb_failed > 0) {
+        fprintf(stderr, "%d qlog files could not be summarized.\n", nb_failed);
+        ret = -1;
+    }
+    return ret;
+}